@@ -0,0 +1,192 @@
+#include "Broadphase.h"
+#include "FastMath.h"
+#include <algorithm>
+
+// Slack added to every bound, so contact pushes and a tick's acceleration
+// can't carry a car past a partner the grid didn't pair it with
+const float BOUNDS_MARGIN = 8.0f;
+
+Broadphase::Broadphase(float cellSize)
+{
+    mCellSize = cellSize;
+    mInvCellSize = 1.0f / cellSize;
+}
+
+int Broadphase::add(Car *car)
+{
+    int index = (int) mCars.size();
+
+    mCars.push_back(car);
+    mBounds.push_back(CarBounds());
+
+    // a car covers about two cells, so two buckets per car keeps most
+    // buckets down to one cell
+    unsigned int buckets = 16;
+    while (buckets < mCars.size() * 2) buckets *= 2;
+    mBucketMask = buckets - 1;
+    mBucketStart.assign(buckets + 1, 0);
+
+    return index;
+}
+
+void Broadphase::clear()
+{
+    mCars.clear();
+    mBounds.clear();
+    mBucketStart.clear();
+    mEntries.clear();
+    mPairs.clear();
+    mBucketMask = 0;
+}
+
+unsigned int Broadphase::bucketOf(int col, int row) const
+{
+    return ((unsigned int) col * 73856093u ^ (unsigned int) row * 19349663u) & mBucketMask;
+}
+
+void Broadphase::computeBounds(float dt, const float *carDt)
+{
+    for (size_t i = 0; i < mCars.size(); i++) {
+        if (carDt != nullptr) dt = carDt[i];
+        OrientedBox box = mCars[i]->getBox();
+        Vector2 vel = mCars[i]->getVelocity();
+        CarBounds &bounds = mBounds[i];
+
+        // extent of the rotated box along each world axis
+        float ax = std::fabs(box.axis.x);
+        float ay = std::fabs(box.axis.y);
+        float extentX = ax * box.half.x + ay * box.half.y;
+        float extentY = ay * box.half.x + ax * box.half.y;
+
+        // the velocity can still change during the step, so allow double
+        // the current travel in every direction
+        float reachX = std::fabs(vel.x) * dt * 2.0f + BOUNDS_MARGIN;
+        float reachY = std::fabs(vel.y) * dt * 2.0f + BOUNDS_MARGIN;
+
+        bounds.minX = box.centre.x - extentX - reachX;
+        bounds.maxX = box.centre.x + extentX + reachX;
+        bounds.minY = box.centre.y - extentY - reachY;
+        bounds.maxY = box.centre.y + extentY + reachY;
+
+        bounds.col0 = (int) fastFloor(bounds.minX * mInvCellSize);
+        bounds.col1 = (int) fastFloor(bounds.maxX * mInvCellSize);
+        bounds.row0 = (int) fastFloor(bounds.minY * mInvCellSize);
+        bounds.row1 = (int) fastFloor(bounds.maxY * mInvCellSize);
+    }
+}
+
+// Counting sort of every (car, cell) into its bucket
+void Broadphase::fillBuckets()
+{
+    std::fill(mBucketStart.begin(), mBucketStart.end(), 0);
+
+    int total = 0;
+    for (const CarBounds &bounds : mBounds) {
+        for (int row = bounds.row0; row <= bounds.row1; row++)
+            for (int col = bounds.col0; col <= bounds.col1; col++)
+                mBucketStart[bucketOf(col, row)]++;
+        total += (bounds.row1 - bounds.row0 + 1) * (bounds.col1 - bounds.col0 + 1);
+    }
+
+    // running totals leave each bucket's end in its slot, and filling
+    // counts them back down to its start
+    for (size_t b = 1; b + 1 < mBucketStart.size(); b++)
+        mBucketStart[b] += mBucketStart[b - 1];
+    mBucketStart.back() = total;
+
+    mEntries.resize(total);
+
+    // back to front, so each bucket lists cars in index order
+    for (int i = (int) mBounds.size() - 1; i >= 0; i--) {
+        const CarBounds &bounds = mBounds[i];
+        for (int row = bounds.row1; row >= bounds.row0; row--) {
+            for (int col = bounds.col1; col >= bounds.col0; col--) {
+                CellEntry entry = { i, col, row };
+                mEntries[--mBucketStart[bucketOf(col, row)]] = entry;
+            }
+        }
+    }
+}
+
+void Broadphase::update(float dt)
+{
+    computeBounds(dt, nullptr);
+    findPairs();
+}
+
+void Broadphase::update(const float *carDt)
+{
+    computeBounds(0.0f, carDt);
+    findPairs();
+}
+
+void Broadphase::findPairs()
+{
+    fillBuckets();
+
+    mPairs.clear();
+
+    for (size_t b = 0; b + 1 < mBucketStart.size(); b++) {
+        int end = mBucketStart[b + 1];
+
+        for (int i = mBucketStart[b]; i < end; i++) {
+            const CellEntry &entryA = mEntries[i];
+            const CarBounds &boundsA = mBounds[entryA.car];
+
+            for (int j = i + 1; j < end; j++) {
+                const CellEntry &entryB = mEntries[j];
+
+                // another cell that hashed into the same bucket
+                if (entryB.col != entryA.col || entryB.row != entryA.row) continue;
+
+                const CarBounds &boundsB = mBounds[entryB.car];
+                if (boundsB.minX > boundsA.maxX || boundsA.minX > boundsB.maxX ||
+                    boundsB.minY > boundsA.maxY || boundsA.minY > boundsB.maxY) continue;
+
+                // only the first cell the two share reports the pair
+                int firstCol = boundsA.col0 > boundsB.col0 ? boundsA.col0 : boundsB.col0;
+                int firstRow = boundsA.row0 > boundsB.row0 ? boundsA.row0 : boundsB.row0;
+                if (entryA.col != firstCol || entryA.row != firstRow) continue;
+
+                int a = entryA.car;
+                int c = entryB.car;
+                CandidatePair pair = { a < c ? a : c, a < c ? c : a };
+                mPairs.push_back(pair);
+            }
+        }
+    }
+}
+
+void Broadphase::query(Vector2 min, Vector2 max, std::vector<int> *out) const
+{
+    out->clear();
+    if (mBucketMask == 0) return;
+
+    int col0 = (int) fastFloor(min.x * mInvCellSize);
+    int col1 = (int) fastFloor(max.x * mInvCellSize);
+    int row0 = (int) fastFloor(min.y * mInvCellSize);
+    int row1 = (int) fastFloor(max.y * mInvCellSize);
+
+    for (int row = row0; row <= row1; row++) {
+        for (int col = col0; col <= col1; col++) {
+            unsigned int b = bucketOf(col, row);
+
+            for (int i = mBucketStart[b]; i < mBucketStart[b + 1]; i++) {
+                const CellEntry &entry = mEntries[i];
+                if (entry.col != col || entry.row != row) continue;
+
+                const CarBounds &bounds = mBounds[entry.car];
+                if (bounds.minX > max.x || min.x > bounds.maxX ||
+                    bounds.minY > max.y || min.y > bounds.maxY) continue;
+
+                // a car covering several of the cells is reported from
+                // the first
+                int firstCol = bounds.col0 > col0 ? bounds.col0 : col0;
+                int firstRow = bounds.row0 > row0 ? bounds.row0 : row0;
+                if (col != firstCol || row != firstRow) continue;
+
+                out->push_back(entry.car);
+            }
+        }
+    }
+}
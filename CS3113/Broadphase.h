@@ -0,0 +1,81 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include "car.h"
+
+/*
+    Uniform grid broadphase for car-to-car contact, with cells the size of
+    a map tile. Cars are registered once; update() then runs once per tick,
+    before any car moves:
+
+        1. each car's box gets a world bounding box, grown by how far the
+           car can travel in its step, and the range of cells it covers
+           (one to four for a car on a tile-sized grid)
+        2. a counting sort drops every (car, cell) into a hashed bucket
+        3. cars sharing a cell whose bounds overlap become a pair. A pair
+           sharing several cells is only kept in the first of them
+
+    RaceWorld runs the oriented box test on those pairs only, and query()
+    looks up the cars near any box through the same cells. The work grows
+    with the number of cars, not its square, whatever shape the field is.
+    All storage is kept between ticks, so a tick allocates nothing once
+    the field has settled.
+*/
+
+struct CandidatePair {
+    int a, b;   // indices as returned by add(), a < b
+};
+
+// a car's world bounds this tick and the cells they cover
+struct CarBounds {
+    float minX, maxX, minY, maxY;
+    int col0, col1, row0, row1;
+};
+
+struct CellEntry {
+    int car;
+    int col, row;
+};
+
+class Broadphase {
+private:
+    float mCellSize;
+    float mInvCellSize;
+
+    std::vector<Car*> mCars;
+    std::vector<CarBounds> mBounds;
+
+    // entries grouped by bucket: bucket b holds
+    // mEntries[mBucketStart[b]] .. mEntries[mBucketStart[b + 1] - 1]
+    std::vector<int> mBucketStart;
+    std::vector<CellEntry> mEntries;
+    unsigned int mBucketMask = 0;
+
+    std::vector<CandidatePair> mPairs;
+
+    void computeBounds(float dt, const float *carDt);
+    void fillBuckets();
+    void findPairs();
+    unsigned int bucketOf(int col, int row) const;
+
+public:
+    explicit Broadphase(float cellSize = 450.0f);
+
+    // index of the car in pairs and queries
+    int add(Car *car);
+    void clear();
+
+    // Every car stepping dt, or each by its own carDt[index]
+    void update(float dt);
+    void update(const float *carDt);
+
+    // Every car whose bounds this tick overlap the box, each once, in out
+    void query(Vector2 min, Vector2 max, std::vector<int> *out) const;
+
+    int getCount() const { return (int) mCars.size(); }
+    Car* getCar(int index) const { return mCars[index]; }
+    const CarBounds& getBounds(int index) const { return mBounds[index]; }
+    const std::vector<CandidatePair>& getPairs() const { return mPairs; }
+};
+
+#endif // BROADPHASE_H
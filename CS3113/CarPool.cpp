@@ -0,0 +1,310 @@
+#include "CarPool.h"
+#include "FastMath.h"
+
+int CarPool::paddedCount() const {
+    return (mCount + UGP_SIMD_WIDTH - 1) / UGP_SIMD_WIDTH * UGP_SIMD_WIDTH;
+}
+
+void CarPool::reserve(int count) {
+    int padded = (count + UGP_SIMD_WIDTH - 1) / UGP_SIMD_WIDTH * UGP_SIMD_WIDTH;
+
+    std::vector<float>* arrays[] = {
+        &mPosX, &mPosY, &mVelX, &mVelY, &mAngle, &mSteer, &mSpeed,
+        &mHeadX, &mHeadY, &mWheelX, &mWheelY, &mGripScale,
+        &mInvMass, &mAccel, &mStaticLoadFront, &mStaticLoadRear, &mFrontShare, &mRearShare,
+        &mDragCoeff, &mRollingCoeff, &mTireMu, &mFrontAero, &mRearAero, &mTurnRadius
+    };
+    for (std::vector<float>* array : arrays) array->reserve(padded);
+    mTireIndex.reserve(count);
+}
+
+int CarPool::add(Vector2 position, float angle, const CarProfile &profile) {
+    int index = mCount++;
+    int padded = paddedCount();
+
+    // padding lanes get a harmless parked car so the kernel never
+    // divides by zero past the end of the field
+    std::vector<float>* zeroed[] = {
+        &mPosX, &mPosY, &mVelX, &mVelY, &mAngle, &mSteer, &mSpeed,
+        &mHeadX, &mHeadY, &mWheelX, &mWheelY,
+        &mAccel, &mStaticLoadFront, &mStaticLoadRear, &mFrontShare, &mRearShare,
+        &mDragCoeff, &mRollingCoeff, &mTireMu, &mFrontAero, &mRearAero
+    };
+    for (std::vector<float>* array : zeroed) array->resize(padded, 0.0f);
+    mGripScale.resize(padded, 1.0f);
+    mInvMass.resize(padded, 1.0f);
+    mTurnRadius.resize(padded, 1.0f);
+
+    mPosX[index]  = position.x;
+    mPosY[index]  = position.y;
+    mAngle[index] = angle;
+
+    DerivedProfile d = deriveProfile(profile);
+    mInvMass[index]         = d.invMass;
+    mAccel[index]           = d.accel;
+    mStaticLoadFront[index] = d.staticLoadFront;
+    mStaticLoadRear[index]  = d.staticLoadRear;
+    mFrontShare[index]      = d.frontShare;
+    mRearShare[index]       = d.rearShare;
+    mDragCoeff[index]       = d.dragCoeff;
+    mRollingCoeff[index]    = d.rollingCoeff;
+    mTireMu[index]          = d.tireMu;
+    mFrontAero[index]       = d.frontAero;
+    mRearAero[index]        = d.rearAero;
+    mTurnRadius[index]      = d.turnRadius;
+
+    int table = 0;
+    while (table < (int) mTireTables.size() && !mTireTables[table].builtFor(profile))
+        table++;
+    if (table == (int) mTireTables.size()) {
+        mTireTables.push_back(TireTable());
+        mTireTables.back().build(profile);
+
+        mCurveNearSlope = std::fmin(mCurveNearSlope, mTireTables.back().getNearSlopeBound());
+        mCurveNear  = std::fmin(mCurveNear, mTireTables.back().getNear());
+        mCurveSlope = std::fmin(mCurveSlope, mTireTables.back().getSlopeBound());
+        mCurveKnee  = std::fmin(mCurveKnee, mTireTables.back().getKnee());
+        mCurveFloor = std::fmin(mCurveFloor, mTireTables.back().getFloorBound());
+    }
+    mTireIndex.push_back(table);
+
+    return index;
+}
+
+// Everything goes, tables and curve bounds too, so a car added after
+// this starts from its own profile and nothing of the last field's
+void CarPool::clear() {
+    std::vector<float>* arrays[] = {
+        &mPosX, &mPosY, &mVelX, &mVelY, &mAngle, &mSteer, &mSpeed,
+        &mHeadX, &mHeadY, &mWheelX, &mWheelY, &mGripScale,
+        &mInvMass, &mAccel, &mStaticLoadFront, &mStaticLoadRear, &mFrontShare, &mRearShare,
+        &mDragCoeff, &mRollingCoeff, &mTireMu, &mFrontAero, &mRearAero, &mTurnRadius
+    };
+    for (std::vector<float>* array : arrays) array->clear();
+
+    mCount = 0;
+    mTireIndex.clear();
+    mTireTables.clear();
+    mCurveNearSlope = 1e30f;
+    mCurveNear  = 1e30f;
+    mCurveSlope = 1e30f;
+    mCurveKnee  = 1e30f;
+    mCurveFloor = 1e30f;
+}
+
+void CarPool::accelerate(int index, float dt) {
+    float s, c;
+    simSinCos(mAngle[index] * DEG2RAD, &s, &c);
+
+    mVelX[index] += c * mAccel[index] * dt;
+    mVelY[index] += s * mAccel[index] * dt;
+}
+
+void CarPool::computeHeadings() {
+    const FloatLanes toRad = lanesSet(DEG2RAD);
+
+    int padded = paddedCount();
+    for (int i = 0; i < padded; i += UGP_SIMD_WIDTH) {
+        FloatLanes rad = lanesLoad(&mAngle[i]) * toRad;
+        FloatLanes wheelRad = rad + lanesLoad(&mSteer[i]) * toRad;
+
+        FloatLanes s, c;
+        lanesSimSinCos(rad, &s, &c);
+        lanesStore(&mHeadX[i], c);
+        lanesStore(&mHeadY[i], s);
+
+        lanesSimSinCos(wheelRad, &s, &c);
+        lanesStore(&mWheelX[i], c);
+        lanesStore(&mWheelY[i], s);
+    }
+}
+
+void CarPool::step(float dt) {
+    computeHeadings();
+
+    const FloatLanes zero      = lanesSet(0.0f);
+    const FloatLanes one       = lanesSet(1.0f);
+    const FloatLanes dtLanes   = lanesSet(dt);
+    const FloatLanes gripWindow = lanesSet(dt * 5.0f);
+    const FloatLanes damping   = lanesSet(0.998f);
+    const FloatLanes stiffness = lanesSet(0.15f);
+    const FloatLanes minSpeed  = lanesSet(0.1f);
+    const FloatLanes curveNearSlope = lanesSet(mCurveNearSlope);
+    const FloatLanes curveNear  = lanesSet(mCurveNear);
+    const FloatLanes curveSlope = lanesSet(mCurveSlope);
+    const FloatLanes curveKnee  = lanesSet(mCurveKnee);
+    const FloatLanes curveFloor = lanesSet(mCurveFloor);
+
+    int padded = paddedCount();
+    for (int i = 0; i < padded; i += UGP_SIMD_WIDTH) {
+        FloatLanes vx = lanesLoad(&mVelX[i]);
+        FloatLanes vy = lanesLoad(&mVelY[i]);
+
+        FloatLanes invMass     = lanesLoad(&mInvMass[i]);
+        FloatLanes staticFront = lanesLoad(&mStaticLoadFront[i]);
+        FloatLanes staticRear  = lanesLoad(&mStaticLoadRear[i]);
+        FloatLanes mu          = lanesLoad(&mTireMu[i]);
+
+        // updateGrip
+        FloatLanes speed   = lanesSqrt(vx * vx + vy * vy);
+        FloatLanes speedSq = speed * speed;
+
+        FloatLanes loadFront = staticFront + lanesLoad(&mFrontAero[i]) * speedSq;
+        FloatLanes loadRear  = staticRear + lanesLoad(&mRearAero[i]) * speedSq;
+
+        FloatLanes frontGrip = mu * loadFront * lanesLoad(&mGripScale[i]);
+        FloatLanes rearGrip  = mu * loadRear;
+
+        // applyFriction
+        vx = vx * damping;
+        vy = vy * damping;
+
+        FloatLanes headX = lanesLoad(&mHeadX[i]);
+        FloatLanes headY = lanesLoad(&mHeadY[i]);
+        FloatLanes latX  = -headY;
+        FloatLanes latY  = headX;
+
+        FloatLanes frontLatX = -lanesLoad(&mWheelY[i]);
+        FloatLanes frontLatY = lanesLoad(&mWheelX[i]);
+
+        FloatLanes rearSlip  = vx * latX + vy * latY;
+        FloatLanes frontSlip = vx * frontLatX + vy * frontLatY;
+
+        FloatLanes frontForce = -frontSlip * stiffness;
+        FloatLanes rearForce  = -rearSlip * stiffness;
+
+        FloatLanes frontMax = frontGrip * invMass * gripWindow;
+        FloatLanes rearMax  = rearGrip * invMass * gripWindow;
+
+        // tyre curve at this slip angle and load, gathered only when some
+        // lane could be near its limit
+        // (TireTable::belowCurve for every lane and both axles)
+        // As the bounds are the lowest over several tables, past one
+        // table's knee isn't past all of them: the floor is only trusted
+        // with the slope bound holding as well.
+        FloatLanes stiffSpeed = speed * stiffness;
+        FloatLanes nearForce  = stiffSpeed * curveNear;
+        FloatLanes kneeForce  = stiffSpeed * curveKnee;
+        FloatLanes frontAbs   = lanesAbs(frontForce);
+        FloatLanes rearAbs    = lanesAbs(rearForce);
+        LaneMask frontSafe = ((nearForce >= frontAbs) & (frontMax * curveNearSlope >= stiffSpeed)) |
+                             ((frontMax * curveSlope >= stiffSpeed) &
+                              ((kneeForce >= frontAbs) | (frontMax * curveFloor >= frontAbs)));
+        LaneMask rearSafe  = ((nearForce >= rearAbs) & (rearMax * curveNearSlope >= stiffSpeed)) |
+                             ((rearMax * curveSlope >= stiffSpeed) &
+                              ((kneeForce >= rearAbs) | (rearMax * curveFloor >= rearAbs)));
+        LaneMask safe = frontSafe & rearSafe;
+
+        if (!lanesAll(safe)) {
+            FloatLanes safeSpeed = lanesMax(speed, minSpeed);
+
+            FloatLanes frontCurve, rearCurve;
+            lookupTires(i, lanesAbs(frontSlip) / safeSpeed, loadFront / (loadFront + staticFront),
+                        lanesAbs(rearSlip) / safeSpeed, loadRear / (loadRear + staticRear),
+                        &frontCurve, &rearCurve);
+
+            frontMax = frontMax * frontCurve;
+            rearMax  = rearMax * rearCurve;
+        }
+
+        frontForce = lanesClamp(frontForce, frontMax) * lanesLoad(&mFrontShare[i]);
+        rearForce  = lanesClamp(rearForce, rearMax) * lanesLoad(&mRearShare[i]);
+
+        LaneMask moving = speed >= minSpeed;
+        frontForce = lanesSelect(moving, frontForce, zero);
+        rearForce  = lanesSelect(moving, rearForce, zero);
+
+        vx = vx + frontLatX * frontForce + latX * rearForce;
+        vy = vy + frontLatY * frontForce + latY * rearForce;
+
+        // applyDrag
+        speed = lanesSqrt(vx * vx + vy * vy);
+
+        FloatLanes decel = (lanesLoad(&mDragCoeff[i]) * speed * speed +
+                            lanesLoad(&mRollingCoeff[i]) * speed) * invMass;
+        FloatLanes newSpeed = lanesMax(speed - decel * dtLanes, zero);
+        FloatLanes scale = lanesSelect(speed > zero,
+                                       newSpeed / lanesMax(speed, minSpeed * minSpeed),
+                                       one);
+        vx = vx * scale;
+        vy = vy * scale;
+
+        // integrate position
+        lanesStore(&mPosX[i], lanesLoad(&mPosX[i]) + vx * dtLanes);
+        lanesStore(&mPosY[i], lanesLoad(&mPosY[i]) + vy * dtLanes);
+        lanesStore(&mVelX[i], vx);
+        lanesStore(&mVelY[i], vy);
+        lanesStore(&mSpeed[i], lanesSqrt(vx * vx + vy * vy));
+    }
+
+    applySteering(dt);
+}
+
+// Table lookups can't be done across lanes without a gather, so each lane
+// looks up its own. Padding lanes get 0, their forces are masked anyway.
+void CarPool::lookupTires(int first, FloatLanes frontSin, FloatLanes frontLoad,
+                          FloatLanes rearSin, FloatLanes rearLoad,
+                          FloatLanes *frontCurve, FloatLanes *rearCurve) const {
+    float fs[UGP_SIMD_WIDTH], fl[UGP_SIMD_WIDTH], rs[UGP_SIMD_WIDTH], rl[UGP_SIMD_WIDTH];
+    lanesStore(fs, frontSin);
+    lanesStore(fl, frontLoad);
+    lanesStore(rs, rearSin);
+    lanesStore(rl, rearLoad);
+
+    float front[UGP_SIMD_WIDTH], rear[UGP_SIMD_WIDTH];
+    for (int lane = 0; lane < UGP_SIMD_WIDTH; lane++) {
+        int car = first + lane;
+        if (car >= mCount) {
+            front[lane] = 0.0f;
+            rear[lane]  = 0.0f;
+            continue;
+        }
+        const TireTable &table = mTireTables[mTireIndex[car]];
+        front[lane] = table.lookup(fs[lane], fl[lane]);
+        rear[lane]  = table.lookup(rs[lane], rl[lane]);
+    }
+
+    *frontCurve = lanesLoad(front);
+    *rearCurve  = lanesLoad(rear);
+}
+
+// needs a sin per turning car, so it stays scalar after the kernel
+void CarPool::applySteering(float dt) {
+    for (int i = 0; i < mCount; i++) {
+        float &steer = mSteer[i];
+
+        if (steer > mMaxSteer)  steer = mMaxSteer;
+        if (steer < -mMaxSteer) steer = -mMaxSteer;
+
+        if (steer > 0)      steer -= mSteerReturnSpeed * dt;
+        else if (steer < 0) steer += mSteerReturnSpeed * dt;
+
+        if (std::fabs(steer) < 0.2f)
+            steer = 0;
+
+        if (mSpeed[i] < 0.1f) continue;
+
+        float steerRad = steer * DEG2RAD;
+        if (std::fabs(steerRad) > 0.01f) {
+            float s, c;
+            simSinCos(steerRad, &s, &c);
+
+            // wrapped, as Car wraps its heading, to keep the trig inside
+            // FastMath's accurate range however long the race
+            float angVel = (mSpeed[i] * s) / mTurnRadius[i];
+            mAngle[i] = wrapDegrees(mAngle[i] + angVel * RAD2DEG * dt);
+        }
+    }
+}
+
+uint64_t CarPool::hashState(uint64_t h) const {
+    for (int i = 0; i < mCount; i++) {
+        h = hashFloat(h, mPosX[i]);
+        h = hashFloat(h, mPosY[i]);
+        h = hashFloat(h, mVelX[i]);
+        h = hashFloat(h, mVelY[i]);
+        h = hashFloat(h, mAngle[i]);
+        h = hashFloat(h, mSteer[i]);
+    }
+    return h;
+}
@@ -0,0 +1,93 @@
+#ifndef CARPOOL_H
+#define CARPOOL_H
+
+#include "car.h"
+#include "Simd.h"
+
+/*
+    Structure-of-arrays car field for large grids (100+ cars). Each piece of
+    state lives in its own contiguous array so step() can run grip,
+    friction, drag and integration for UGP_SIMD_WIDTH cars at a time.
+
+    Follows the same model as Car::update without map or car-to-car
+    contact; those stay with Car for the handful of cars on a track. Tyre
+    curve lookups are gathered lane by lane, as each car may use a
+    different profile's table, and skipped for a block of lanes when none
+    of them can be near the limit.
+    Pool cars are AI driven, so steering is set each tick and springs
+    back towards centre exactly as it does for an AI Car. The sums go in
+    a different order than Car's, so the two drift apart by rounding: up
+    to about 0.03 units over 600 ticks, checked by ugp_bench pool.
+*/
+class CarPool {
+private:
+    int mCount = 0;
+
+    // kinematic state
+    std::vector<float> mPosX, mPosY;
+    std::vector<float> mVelX, mVelY;
+    std::vector<float> mAngle;      // degrees, like Car
+    std::vector<float> mSteer;      // degrees
+    std::vector<float> mSpeed;
+
+    // per-tick heading and front wheel basis, filled before the kernel
+    std::vector<float> mHeadX, mHeadY;
+    std::vector<float> mWheelX, mWheelY;
+
+    // surface grip multiplier, 1 on tarmac
+    std::vector<float> mGripScale;
+
+    // DerivedProfile fields, as Car reads them
+    std::vector<float> mInvMass;
+    std::vector<float> mAccel;
+    std::vector<float> mStaticLoadFront, mStaticLoadRear;
+    std::vector<float> mFrontShare, mRearShare;
+    std::vector<float> mDragCoeff;
+    std::vector<float> mRollingCoeff;
+    std::vector<float> mTireMu;
+    std::vector<float> mFrontAero;
+    std::vector<float> mRearAero;
+    std::vector<float> mTurnRadius;
+
+    // one tyre table per distinct profile, indexed per car
+    std::vector<TireTable> mTireTables;
+    std::vector<int> mTireIndex;
+    float mCurveNearSlope = 1e30f;  // lower bounds over every table
+    float mCurveNear  = 1e30f;
+    float mCurveSlope = 1e30f;
+    float mCurveKnee  = 1e30f;
+    float mCurveFloor = 1e30f;
+
+    float mMaxSteer = 20.0f;
+    float mSteerReturnSpeed = 20.0f;
+
+    int paddedCount() const;
+    void computeHeadings();
+    void applySteering(float dt);
+    void lookupTires(int first, FloatLanes frontSin, FloatLanes frontLoad,
+                     FloatLanes rearSin, FloatLanes rearLoad,
+                     FloatLanes *frontCurve, FloatLanes *rearCurve) const;
+
+public:
+    CarPool() {}
+
+    void reserve(int count);
+    int  add(Vector2 position, float angle, const CarProfile &profile);
+    void clear();
+
+    void step(float dt);
+
+    void accelerate(int index, float dt);
+    void setSteerAngle(int index, float angle) { mSteer[index] = angle; }
+    void setGripScale(int index, float scale)  { mGripScale[index] = scale; }
+
+    int     size()                const { return mCount; }
+    Vector2 getPosition(int index) const { return { mPosX[index], mPosY[index] }; }
+    Vector2 getVelocity(int index) const { return { mVelX[index], mVelY[index] }; }
+    float   getAngle(int index)    const { return mAngle[index]; }
+    float   getSpeed(int index)    const { return mSpeed[index]; }
+
+    uint64_t hashState(uint64_t h) const;
+};
+
+#endif
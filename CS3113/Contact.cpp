@@ -0,0 +1,106 @@
+#include "Contact.h"
+
+bool boxesOverlap(const OrientedBox &a, const OrientedBox &b, Contact *contact)
+{
+    float dx = b.centre.x - a.centre.x;
+    float dy = b.centre.y - a.centre.y;
+
+    float c = std::fabs(a.axis.x * b.axis.x + a.axis.y * b.axis.y);
+    float s = std::fabs(a.axis.x * b.axis.y - a.axis.y * b.axis.x);
+
+    // the four axes in the same order as lanesBoxesOverlap
+    Vector2 axes[4] = {
+        a.axis, { -a.axis.y, a.axis.x },
+        b.axis, { -b.axis.y, b.axis.x }
+    };
+    float radii[4] = {
+        a.half.x + b.half.x * c + b.half.y * s,
+        a.half.y + b.half.x * s + b.half.y * c,
+        b.half.x + a.half.x * c + a.half.y * s,
+        b.half.y + a.half.x * s + a.half.y * c
+    };
+
+    float best = 0.0f;
+    float bestDist = 0.0f;
+    int bestAxis = -1;
+
+    for (int i = 0; i < 4; i++) {
+        float dist = dx * axes[i].x + dy * axes[i].y;
+        float overlap = radii[i] - std::fabs(dist);
+
+        // separated along this axis
+        if (overlap <= 0.0f) return false;
+
+        if (bestAxis < 0 || overlap < best) {
+            best = overlap;
+            bestDist = dist;
+            bestAxis = i;
+        }
+    }
+
+    if (contact != nullptr) {
+        float sign = bestDist < 0.0f ? -1.0f : 1.0f;
+        contact->normal = { axes[bestAxis].x * sign, axes[bestAxis].y * sign };
+        contact->depth = best;
+    }
+    return true;
+}
+
+// one float per lane from each box's fields, without a round trip
+// through memory
+static void loadBoxLanes(const OrientedBox *boxes, BoxLanes *lanes)
+{
+    const int stride = sizeof(OrientedBox) / sizeof(float);
+    const float *p = &boxes[0].centre.x;
+
+    lanes->cx = lanesGather(p + 0, stride);
+    lanes->cy = lanesGather(p + 1, stride);
+    lanes->ax = lanesGather(p + 2, stride);
+    lanes->ay = lanesGather(p + 3, stride);
+    lanes->hx = lanesGather(p + 4, stride);
+    lanes->hy = lanesGather(p + 5, stride);
+}
+
+int findContacts(const OrientedBox *a, const OrientedBox *b, int count,
+                 Contact *contacts)
+{
+    int touching = 0;
+
+    for (int i = 0; i < count; i += UGP_SIMD_WIDTH) {
+        int n = count - i < UGP_SIMD_WIDTH ? count - i : UGP_SIMD_WIDTH;
+        const OrientedBox *blockA = a + i;
+        const OrientedBox *blockB = b + i;
+
+        // a short last block is padded with zero-sized boxes, which never
+        // touch
+        OrientedBox padA[UGP_SIMD_WIDTH], padB[UGP_SIMD_WIDTH];
+        if (n < UGP_SIMD_WIDTH) {
+            for (int k = 0; k < UGP_SIMD_WIDTH; k++) {
+                padA[k] = k < n ? a[i + k] : OrientedBox{ { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 0.0f } };
+                padB[k] = k < n ? b[i + k] : padA[k];
+            }
+            blockA = padA;
+            blockB = padB;
+        }
+
+        BoxLanes laneA, laneB;
+        loadBoxLanes(blockA, &laneA);
+        loadBoxLanes(blockB, &laneB);
+
+        FloatLanes nx, ny, depth;
+        lanesBoxesOverlap(laneA, laneB, &nx, &ny, &depth);
+
+        float outX[UGP_SIMD_WIDTH], outY[UGP_SIMD_WIDTH], outDepth[UGP_SIMD_WIDTH];
+        lanesStore(outX, nx);
+        lanesStore(outY, ny);
+        lanesStore(outDepth, depth);
+
+        for (int k = 0; k < n; k++) {
+            bool hit = outDepth[k] > 0.0f;
+            contacts[i + k].normal = { outX[k], outY[k] };
+            contacts[i + k].depth  = hit ? outDepth[k] : 0.0f;
+            touching += hit;
+        }
+    }
+    return touching;
+}
@@ -0,0 +1,108 @@
+#ifndef CONTACT_H
+#define CONTACT_H
+
+#include "SimCommon.h"
+#include "Simd.h"
+
+/*
+    Oriented box narrowphase for car-to-car contact: a separating axis test
+    over the four face normals of two rectangles. The boxes touch when
+    their projections overlap on all four axes, and the axis with the
+    least overlap gives the contact normal and the penetration depth.
+
+    boxesOverlap() tests one pair. lanesBoxesOverlap() runs the same test
+    on UGP_SIMD_WIDTH pairs at once, branch-free, and findContacts() feeds
+    an array of pairs through it a block of lanes at a time.
+*/
+
+struct OrientedBox {
+    Vector2 centre;
+    Vector2 axis;       // unit local x, local y is axis rotated +90 degrees
+    Vector2 half;       // half extents along local x and y
+};
+
+struct Contact {
+    Vector2 normal;     // unit, from a towards b
+    float depth;        // > 0 when the boxes overlap, 0 when apart
+};
+
+// What a contact does to one of the two bodies
+struct ContactDelta {
+    Vector2 push;       // position change
+    Vector2 impulse;    // velocity change
+};
+
+bool boxesOverlap(const OrientedBox &a, const OrientedBox &b, Contact *contact);
+
+// contacts[k] for each pair (a[k], b[k]); returns how many touch
+int findContacts(const OrientedBox *a, const OrientedBox *b, int count,
+                 Contact *contacts);
+
+/*
+    ----------- Lanes -----------
+*/
+
+struct BoxLanes {
+    FloatLanes cx, cy;
+    FloatLanes ax, ay;
+    FloatLanes hx, hy;
+};
+
+// Lane k tests pair (a_k, b_k). Normal and depth are only meaningful in
+// lanes where the returned mask is set.
+inline LaneMask lanesBoxesOverlap(const BoxLanes &a, const BoxLanes &b,
+                                  FloatLanes *nx, FloatLanes *ny, FloatLanes *depth)
+{
+    const FloatLanes zero = lanesSet(0.0f);
+
+    FloatLanes dx = b.cx - a.cx;
+    FloatLanes dy = b.cy - a.cy;
+
+    // |cos| and |sin| of the angle between the boxes cover every
+    // cross-projection of one box's axes onto the other's
+    FloatLanes c = lanesAbs(a.ax * b.ax + a.ay * b.ay);
+    FloatLanes s = lanesAbs(a.ax * b.ay - a.ay * b.ax);
+
+    // signed centre distance along a.x, a.y, b.x, b.y
+    FloatLanes d0 = dx * a.ax + dy * a.ay;
+    FloatLanes d1 = dy * a.ax - dx * a.ay;
+    FloatLanes d2 = dx * b.ax + dy * b.ay;
+    FloatLanes d3 = dy * b.ax - dx * b.ay;
+
+    FloatLanes o0 = a.hx + b.hx * c + b.hy * s - lanesAbs(d0);
+    FloatLanes o1 = a.hy + b.hx * s + b.hy * c - lanesAbs(d1);
+    FloatLanes o2 = b.hx + a.hx * c + a.hy * s - lanesAbs(d2);
+    FloatLanes o3 = b.hy + a.hx * s + a.hy * c - lanesAbs(d3);
+
+    // least overlap wins, ties go to the earlier axis
+    FloatLanes best = o0;
+    FloatLanes bx = a.ax, by = a.ay, bd = d0;
+
+    LaneMask pick = o1 < best;
+    best = lanesSelect(pick, o1, best);
+    bx = lanesSelect(pick, -a.ay, bx);
+    by = lanesSelect(pick, a.ax, by);
+    bd = lanesSelect(pick, d1, bd);
+
+    pick = o2 < best;
+    best = lanesSelect(pick, o2, best);
+    bx = lanesSelect(pick, b.ax, bx);
+    by = lanesSelect(pick, b.ay, by);
+    bd = lanesSelect(pick, d2, bd);
+
+    pick = o3 < best;
+    best = lanesSelect(pick, o3, best);
+    bx = lanesSelect(pick, -b.ay, bx);
+    by = lanesSelect(pick, b.ax, by);
+    bd = lanesSelect(pick, d3, bd);
+
+    // face the normal from a to b
+    LaneMask flip = bd < zero;
+    *nx = lanesSelect(flip, -bx, bx);
+    *ny = lanesSelect(flip, -by, by);
+    *depth = best;
+
+    return best > zero;
+}
+
+#endif // CONTACT_H
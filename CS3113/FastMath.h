@@ -0,0 +1,260 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+/*
+    Bounded-error approximations for the physics and AI hot paths, each as
+    a scalar function and a FloatLanes (4/8-wide) version.
+
+        sincos  quadrant reduction + degree 7/8 polynomials
+                |error| < 2e-6 for |x| < 40 rad
+        atan2   octant reduction + degree 11 odd polynomial
+                |error| < 2e-6 rad
+        rsqrt   hardware estimate + one Newton step
+                relative error < 3e-7
+
+    Angle wrapping is branch-free in both modes.
+
+    The sim* wrappers are what physics and AI call. They use the standard
+    library unless the build defines UGP_FAST_MATH (make FAST_MATH=1) or
+    UGP_DETERMINISTIC (make DETERMINISTIC=1). simSin, simAtan and simAsin,
+    for tables built once, leave libm only in deterministic builds.
+
+    Deterministic builds take the polynomial trig above, since libm sin/cos
+    differ between platforms, but keep the IEEE sqrt: rsqrt estimates
+    differ between CPU vendors. Everything left is + - * / and sqrt, which
+    IEEE 754 rounds exactly, so with contraction into FMA turned off (the
+    makefile does this) results match bit for bit at any -O level and on
+    any machine.
+
+    Lap time tolerance: a fast build must reproduce the exact build's
+    ugp_bench race best laps to within one tick (1/60 s).
+    `make check-fast-math` builds both and fails if one doesn't.
+*/
+
+#include "Simd.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+    #include <xmmintrin.h>
+#endif
+
+const float FM_PI        = 3.14159265358979323846f;
+const float FM_TWO_PI    = 6.28318530717958647692f;
+const float FM_HALF_PI   = 1.57079632679489661923f;
+const float FM_TWO_OVER_PI = 0.63661977236758134308f;
+
+// pi/2 split in two so x - j*pi/2 stays accurate for large j
+const float FM_PIO2_HI = 1.57079625129699707031f;
+const float FM_PIO2_LO = 7.54978995489188216e-8f;
+
+// minimax sin/cos on [-pi/4, pi/4]
+const float FM_SIN_1 = -1.6666654611e-1f;
+const float FM_SIN_2 =  8.3321608736e-3f;
+const float FM_SIN_3 = -1.9515295891e-4f;
+const float FM_COS_1 =  4.166664568298827e-2f;
+const float FM_COS_2 = -1.388731625493765e-3f;
+const float FM_COS_3 =  2.443315711809948e-5f;
+
+// atan on [0, 1]
+const float FM_ATAN_0 =  0.99997726f;
+const float FM_ATAN_1 = -0.33262347f;
+const float FM_ATAN_2 =  0.19354346f;
+const float FM_ATAN_3 = -0.11643287f;
+const float FM_ATAN_4 =  0.05265332f;
+const float FM_ATAN_5 = -0.01172120f;
+
+/*
+    ----------- Scalar -----------
+*/
+
+// floor through an int conversion, std::floor is a libm call without SSE4.1
+inline float fastFloor(float x)
+{
+    int i = (int) x;
+    return (float) (i - (x < (float) i));
+}
+
+inline void fastSinCos(float x, float *s, float *c)
+{
+    float j = fastFloor(x * FM_TWO_OVER_PI + 0.5f);
+    float y = x - j * FM_PIO2_HI - j * FM_PIO2_LO;
+    float z = y * y;
+
+    float ps = y + y * z * (FM_SIN_1 + z * (FM_SIN_2 + z * FM_SIN_3));
+    float pc = 1.0f - 0.5f * z + z * z * (FM_COS_1 + z * (FM_COS_2 + z * FM_COS_3));
+
+    // quadrant picks which polynomial is sin and which signs flip
+    int q = (int) j & 3;
+    float sv = (q & 1) ? pc : ps;
+    float cv = (q & 1) ? ps : pc;
+
+    *s = (q & 2) ? -sv : sv;
+    *c = ((q + 1) & 2) ? -cv : cv;
+}
+
+inline float fastAtan2(float y, float x)
+{
+    float ax = std::fabs(x);
+    float ay = std::fabs(y);
+    float hi = ax > ay ? ax : ay;
+    float lo = ax > ay ? ay : ax;
+
+    if (hi == 0.0f) return 0.0f;
+
+    float a = lo / hi;
+    float s = a * a;
+    float r = a * (FM_ATAN_0 + s * (FM_ATAN_1 + s * (FM_ATAN_2 +
+              s * (FM_ATAN_3 + s * (FM_ATAN_4 + s * FM_ATAN_5)))));
+
+    if (ay > ax)   r = FM_HALF_PI - r;
+    if (x < 0.0f)  r = FM_PI - r;
+    return y < 0.0f ? -r : r;
+}
+
+inline float fastRsqrt(float x)
+{
+#if defined(__SSE__) || defined(_M_X64)
+    float r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+    // bit-level first guess, needs a second Newton step to match
+    union { float f; unsigned int i; } bits = { x };
+    bits.i = 0x5f375a86u - (bits.i >> 1);
+    float r = bits.f;
+    r = r * (1.5f - 0.5f * x * r * r);
+#endif
+    return r * (1.5f - 0.5f * x * r * r);
+}
+
+// [-pi, pi)
+inline float wrapRadians(float a)
+{
+    return a - FM_TWO_PI * fastFloor(a * (1.0f / FM_TWO_PI) + 0.5f);
+}
+
+// [-180, 180)
+inline float wrapDegrees(float a)
+{
+    return a - 360.0f * fastFloor(a * (1.0f / 360.0f) + 0.5f);
+}
+
+/*
+    ----------- Lanes -----------
+*/
+
+inline void lanesSinCos(FloatLanes x, FloatLanes *s, FloatLanes *c)
+{
+    const FloatLanes one = lanesSet(1.0f);
+
+    FloatLanes j = lanesFloor(x * lanesSet(FM_TWO_OVER_PI) + lanesSet(0.5f));
+    FloatLanes y = x - j * lanesSet(FM_PIO2_HI) - j * lanesSet(FM_PIO2_LO);
+    FloatLanes z = y * y;
+
+    FloatLanes ps = y + y * z * (lanesSet(FM_SIN_1) + z * (lanesSet(FM_SIN_2) +
+                    z * lanesSet(FM_SIN_3)));
+    FloatLanes pc = one - lanesSet(0.5f) * z + z * z * (lanesSet(FM_COS_1) +
+                    z * (lanesSet(FM_COS_2) + z * lanesSet(FM_COS_3)));
+
+    // quadrant 0..3 kept as a float so it never leaves the float registers
+    FloatLanes q = j - lanesSet(4.0f) * lanesFloor(j * lanesSet(0.25f));
+    LaneMask q1 = q == one;
+    LaneMask q2 = q == lanesSet(2.0f);
+    LaneMask q3 = q == lanesSet(3.0f);
+
+    LaneMask swap = q1 | q3;
+    FloatLanes sv = lanesSelect(swap, pc, ps);
+    FloatLanes cv = lanesSelect(swap, ps, pc);
+
+    *s = lanesSelect(q2 | q3, -sv, sv);
+    *c = lanesSelect(q1 | q2, -cv, cv);
+}
+
+inline FloatLanes lanesAtan2(FloatLanes y, FloatLanes x)
+{
+    const FloatLanes zero = lanesSet(0.0f);
+
+    FloatLanes ax = lanesAbs(x);
+    FloatLanes ay = lanesAbs(y);
+    FloatLanes hi = lanesMax(ax, ay);
+    FloatLanes lo = lanesMin(ax, ay);
+
+    // 0/0 lands on 0 like the scalar version
+    FloatLanes a = lanesSelect(hi > zero, lo / lanesMax(hi, lanesSet(1e-30f)), zero);
+    FloatLanes s = a * a;
+    FloatLanes r = a * (lanesSet(FM_ATAN_0) + s * (lanesSet(FM_ATAN_1) +
+                   s * (lanesSet(FM_ATAN_2) + s * (lanesSet(FM_ATAN_3) +
+                   s * (lanesSet(FM_ATAN_4) + s * lanesSet(FM_ATAN_5))))));
+
+    r = lanesSelect(ay > ax, lanesSet(FM_HALF_PI) - r, r);
+    r = lanesSelect(x < zero, lanesSet(FM_PI) - r, r);
+    return lanesSelect(y < zero, -r, r);
+}
+
+inline FloatLanes lanesRsqrt(FloatLanes x)
+{
+    FloatLanes r = lanesRsqrtEstimate(x);
+    return r * (lanesSet(1.5f) - lanesSet(0.5f) * x * r * r);
+}
+
+inline FloatLanes lanesWrapRadians(FloatLanes a)
+{
+    return a - lanesSet(FM_TWO_PI) *
+           lanesFloor(a * lanesSet(1.0f / FM_TWO_PI) + lanesSet(0.5f));
+}
+
+/*
+    ----------- Build-time switch -----------
+*/
+
+#if defined(UGP_DETERMINISTIC)
+
+inline void  simSinCos(float x, float *s, float *c) { fastSinCos(x, s, c); }
+inline float simAtan2(float y, float x)             { return fastAtan2(y, x); }
+inline float simSqrt(float x)                       { return std::sqrt(x); }
+
+inline void lanesSimSinCos(FloatLanes x, FloatLanes *s, FloatLanes *c)
+    { lanesSinCos(x, s, c); }
+
+#elif defined(UGP_FAST_MATH)
+
+inline void  simSinCos(float x, float *s, float *c) { fastSinCos(x, s, c); }
+inline float simAtan2(float y, float x)             { return fastAtan2(y, x); }
+inline float simSqrt(float x) { return x > 0.0f ? x * fastRsqrt(x) : 0.0f; }
+
+inline void lanesSimSinCos(FloatLanes x, FloatLanes *s, FloatLanes *c)
+    { lanesSinCos(x, s, c); }
+
+#else
+
+inline void  simSinCos(float x, float *s, float *c) { *s = std::sin(x); *c = std::cos(x); }
+inline float simAtan2(float y, float x)             { return std::atan2(y, x); }
+inline float simSqrt(float x)                       { return std::sqrt(x); }
+
+// exact mode goes lane by lane through libm
+inline void lanesSimSinCos(FloatLanes x, FloatLanes *s, FloatLanes *c)
+{
+    float in[UGP_SIMD_WIDTH], sOut[UGP_SIMD_WIDTH], cOut[UGP_SIMD_WIDTH];
+    lanesStore(in, x);
+    for (int i = 0; i < UGP_SIMD_WIDTH; i++) simSinCos(in[i], &sOut[i], &cOut[i]);
+    *s = lanesLoad(sOut);
+    *c = lanesLoad(cOut);
+}
+
+#endif
+
+// For building tables once rather than every tick, so only a
+// deterministic build needs them off libm: the tables have to come out
+// the same on every machine too
+#if defined(UGP_DETERMINISTIC)
+
+inline float simSin(float x)  { float s, c; fastSinCos(x, &s, &c); return s; }
+inline float simAtan(float x) { return fastAtan2(x, 1.0f); }
+inline float simAsin(float x) { return fastAtan2(x, std::sqrt(std::fmax(0.0f, 1.0f - x * x))); }
+
+#else
+
+inline float simSin(float x)  { return std::sin(x); }
+inline float simAtan(float x) { return std::atan(x); }
+inline float simAsin(float x) { return std::asin(x); }
+
+#endif
+
+#endif // FASTMATH_H
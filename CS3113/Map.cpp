@@ -1,15 +1,13 @@
 #include "Map.h"
+#include <algorithm>
 
 Map::Map(int mapColumns, int mapRows, unsigned int *levelData,
-         const char *textureFilePath, float tileSize, int textureColumns,
-         int textureRows, Vector2 origin) : 
-         mMapColumns {mapColumns}, mMapRows {mapRows}, 
-         mTextureAtlas { LoadTexture(textureFilePath) },
-         mLevelData {levelData }, mTileSize {tileSize}, 
-         mTextureColumns {textureColumns}, mTextureRows {textureRows},
+         float tileSize, Vector2 origin) :
+         mMapColumns {mapColumns}, mMapRows {mapRows},
+         mLevelData {levelData }, mTileSize {tileSize},
          mOrigin {origin} { build(); }
 
-Map::~Map() { UnloadTexture(mTextureAtlas); }
+Map::~Map() {}
 
 void Map::build()
 {
@@ -19,123 +17,295 @@ void Map::build()
     mTopBoundary    = mOrigin.y - (mMapRows * mTileSize) / 2.0f;
     mBottomBoundary = mOrigin.y + (mMapRows * mTileSize) / 2.0f;
 
-    // Precompute texture areas for each tile
-    for (int row = 0; row < mTextureRows; row++)
+    for (int i = 0; i < mMapRows * mMapColumns; i++)
+        growTileTraits(mLevelData[i]);
+
+    buildCollisionGrid();
+    buildSurfaceGrid();
+    buildTileIndex();
+    buildEdgeField();
+}
+
+// Adds table entries up to tileID, each as the ID means before any object
+// is registered on it
+void Map::growTileTraits(unsigned int tileID)
+{
+    while (mTileTraits.size() <= tileID)
     {
-        for (int col = 0; col < mTextureColumns; col++)
+        unsigned int id = (unsigned int) mTileTraits.size();
+        TileTraits traits = { 0, SURFACE_GRASS, -1 };
+
+        if (id != TILE_GRASS)
         {
-            Rectangle textureArea = {
-                (float) col * (mTextureAtlas.width / mTextureColumns),
-                (float) row * (mTextureAtlas.height / mTextureRows),
-                (float) mTextureAtlas.width / mTextureColumns,
-                (float) mTextureAtlas.height / mTextureRows
-            };
-
-            mTextureAreas.push_back(textureArea);
+            traits.flags |= TILE_DRIVABLE;
+            traits.surface = SURFACE_ASPHALT;
         }
+        if (id == START_LINE_TOP_TILE || id == START_LINE_BOTTOM_TILE)
+            traits.flags |= TILE_START_LINE;
+
+        mTileTraits.push_back(traits);
     }
 }
 
-void Map::render()
+// Files each object box under the cells it covers, in two passes over the
+// boxes: count per cell, then fill. Boxes hanging off the map go in the
+// edge cells, which getCellRange never goes past
+void Map::buildCollisionGrid()
 {
-    // Draw each tile in the map
+    mSolidBoxes.clear();
     for (int row = 0; row < mMapRows; row++)
     {
-        // Draw each column in the row
         for (int col = 0; col < mMapColumns; col++)
         {
-            // Get the tile index at the current row and column
-            int tile = mLevelData[row * mMapColumns + col];
-
-            // If the tile index is 0, we do not draw anything
-            if (tile == 0) continue;
-            if (mMultiTileObjects.count(tile)) continue;
-
-            Rectangle destinationArea = {
-                mLeftBoundary + col * mTileSize,
-                mTopBoundary  + row * mTileSize, // y-axis is inverted
-                mTileSize,
-                mTileSize
-            };
-
-            // Draw the tile
-            DrawTexturePro(
-                mTextureAtlas,
-                mTextureAreas[tile - 1], // -1 because tile indices start at 1
-                destinationArea,
-                {0.0f, 0.0f}, // origin
-                0.0f,         // rotation
-                WHITE         // tint
-            );
+            SolidBox box;
+            if (getObjectBox(col, row, &box)) mSolidBoxes.push_back(box);
         }
     }
 
-    for (int row = 0; row < mMapRows; row++)
+    int cellCount = mMapColumns * mMapRows;
+    mCellStart.assign(cellCount + 1, 0);
+
+    for (const SolidBox &box : mSolidBoxes)
     {
-        for (int col = 0; col < mMapColumns; col++)
+        int colMin, rowMin, colMax, rowMax;
+        getCellRange({ box.left, box.top }, { box.right, box.bottom },
+                     &colMin, &rowMin, &colMax, &rowMax);
+        for (int row = rowMin; row <= rowMax; row++)
+            for (int col = colMin; col <= colMax; col++)
+                mCellStart[row * mMapColumns + col + 1]++;
+    }
+    for (int c = 0; c < cellCount; c++) mCellStart[c + 1] += mCellStart[c];
+
+    std::vector<int> next(mCellStart.begin(), mCellStart.end() - 1);
+    mCellBoxes.resize(mCellStart[cellCount]);
+
+    for (int b = 0; b < (int) mSolidBoxes.size(); b++)
+    {
+        const SolidBox &box = mSolidBoxes[b];
+        int colMin, rowMin, colMax, rowMax;
+        getCellRange({ box.left, box.top }, { box.right, box.bottom },
+                     &colMin, &rowMin, &colMax, &rowMax);
+        for (int row = rowMin; row <= rowMax; row++)
+            for (int col = colMin; col <= colMax; col++)
+                mCellBoxes[next[row * mMapColumns + col]++] = b;
+    }
+}
+
+// Each cell's tile surface, then the patches over the top
+void Map::buildSurfaceGrid()
+{
+    int cellCount = mMapColumns * mMapRows;
+    mSurfaceGrid.resize(cellCount);
+
+    for (int c = 0; c < cellCount; c++)
+        mSurfaceGrid[c] = mTileTraits[mLevelData[c]].surface;
+
+    for (const SurfacePatch &patch : mSurfacePatches)
+        mSurfaceGrid[patch.cell] = patch.surface;
+}
+
+// Counting sort of the cells by tile ID. Filling in cell order leaves
+// each tile's cells ascending
+void Map::buildTileIndex()
+{
+    int cellCount = mMapColumns * mMapRows;
+    int idCount = (int) mTileTraits.size();
+    mTileStart.assign(idCount + 1, 0);
+
+    for (int c = 0; c < cellCount; c++) mTileStart[mLevelData[c] + 1]++;
+    for (int t = 0; t < idCount; t++) mTileStart[t + 1] += mTileStart[t];
+
+    std::vector<int> next(mTileStart.begin(), mTileStart.end() - 1);
+    mTileCells.resize(cellCount);
+    for (int c = 0; c < cellCount; c++) mTileCells[next[mLevelData[c]]++] = c;
+}
+
+// The cell's surface patch if it has one, else its tile's
+void Map::updateSurfaceCell(int cell)
+{
+    mSurfaceGrid[cell] = mTileTraits[mLevelData[cell]].surface;
+    for (const SurfacePatch &patch : mSurfacePatches)
+        if (patch.cell == cell) mSurfaceGrid[cell] = patch.surface;
+}
+
+// Moves a cell from one tile's range of the index to another's, shifting
+// only the entries between the two
+void Map::moveTileCell(int cell, unsigned int from, unsigned int to)
+{
+    // IDs new since the last build start out empty, at the end
+    if (mTileStart.size() < mTileTraits.size() + 1)
+        mTileStart.resize(mTileTraits.size() + 1, mTileStart.back());
+    if (from == to) return;
+
+    std::vector<int>::iterator cells = mTileCells.begin();
+    std::vector<int>::iterator at = std::lower_bound(cells + mTileStart[from],
+                                                     cells + mTileStart[from + 1], cell);
+    std::vector<int>::iterator into = std::lower_bound(cells + mTileStart[to],
+                                                       cells + mTileStart[to + 1], cell);
+    if (from < to)
+    {
+        std::rotate(at, at + 1, into);
+        for (unsigned int t = from + 1; t <= to; t++) mTileStart[t]--;
+    }
+    else
+    {
+        std::rotate(into, at, at + 1);
+        for (unsigned int t = to + 1; t <= from; t++) mTileStart[t]++;
+    }
+}
+
+void Map::setTileType(int index, int tileType)
+{
+    unsigned int from = mLevelData[index];
+    unsigned int to = (unsigned int) tileType;
+    growTileTraits(to);
+
+    TileTraits before = mTileTraits[from];
+    TileTraits after  = mTileTraits[to];
+    mLevelData[index] = to;
+
+    updateSurfaceCell(index);
+    moveTileCell(index, from, to);
+
+    if ((before.flags | after.flags) & TILE_OBJECT) buildCollisionGrid();
+
+    if ((before.flags ^ after.flags) & TILE_DRIVABLE)
+    {
+        int x = (index % mMapColumns) * EDGE_FIELD_SAMPLES;
+        int y = (index / mMapColumns) * EDGE_FIELD_SAMPLES;
+        updateEdgeField(x, y, x + EDGE_FIELD_SAMPLES, y + EDGE_FIELD_SAMPLES);
+    }
+}
+
+// Stands in for infinity in the distance transforms
+static const float EDGE_FAR = 1e20f;
+
+// How many samples a change to the drivable area can move the field: a
+// byte holds 127 eighths of a step, under 16.375 steps once the half
+// step to the edge is added, so samples further off stay saturated
+static const int EDGE_FIELD_REACH = 17;
+
+// Where the parabolas rooted at samples p and q cross
+static float parabolaMeet(const float *f, int p, int q)
+{
+    return ((f[q] + q * q) - (f[p] + p * p)) / (2.0f * (q - p));
+}
+
+// Squared distance from each of n samples to the nearest feature along one
+// line, in place: f holds 0 at features and EDGE_FAR elsewhere. The lower
+// envelope of parabolas of Felzenszwalb and Huttenlocher, linear in n.
+// v, z and d are scratch of n, n + 1 and n
+static void distanceTransform1D(float *f, int n, int *v, float *z, float *d)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -EDGE_FAR;
+    z[1] = EDGE_FAR;
+
+    // EDGE_FAR is big enough that no meeting point falls below z[0]
+    for (int q = 1; q < n; q++)
+    {
+        float s = parabolaMeet(f, v[k], q);
+        while (s <= z[k])
         {
-            int tile = mLevelData[row * mMapColumns + col];
+            k--;
+            s = parabolaMeet(f, v[k], q);
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = EDGE_FAR;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; q++)
+    {
+        while (z[k + 1] < q) k++;
+        float dq = (float) (q - v[k]);
+        d[q] = dq * dq + f[v[k]];
+    }
+    for (int q = 0; q < n; q++) f[q] = d[q];
+}
 
-            if (!mMultiTileObjects.count(tile))
-                continue;
+// Squared distance transform of a w by h grid, rows then columns
+static void distanceTransform2D(std::vector<float> &grid, int w, int h)
+{
+    int n = std::max(w, h);
+    std::vector<float> line(n), z(n + 1), d(n);
+    std::vector<int> v(n);
 
-            MultiTileObject &obj = mMultiTileObjects[tile];
+    for (int y = 0; y < h; y++)
+        distanceTransform1D(&grid[y * w], w, v.data(), z.data(), d.data());
 
-            // Position of TOP-LEFT in world space
-            float px = mLeftBoundary + col * mTileSize + obj.offset.x;
-            float py = mTopBoundary  + row * mTileSize + obj.offset.y;
+    for (int x = 0; x < w; x++)
+    {
+        for (int y = 0; y < h; y++) line[y] = grid[y * w + x];
+        distanceTransform1D(line.data(), h, v.data(), z.data(), d.data());
+        for (int y = 0; y < h; y++) grid[y * w + x] = line[y];
+    }
+}
 
-            // World size of the object (what matters)
-            float worldW = obj.widthTiles  * mTileSize;
-            float worldH = obj.heightTiles * mTileSize;
+void Map::buildEdgeField()
+{
+    mEdgeColumns = mMapColumns * EDGE_FIELD_SAMPLES;
+    mEdgeRows    = mMapRows * EDGE_FIELD_SAMPLES;
+    mEdgeStep    = mTileSize / EDGE_FIELD_SAMPLES;
+    mEdgeUnit    = mEdgeStep / 8.0f;
 
-            Rectangle src = {
-                0,
-                0,
-                (float)obj.texture.width,
-                (float)obj.texture.height
-            };
+    mEdgeField.resize(mEdgeColumns * mEdgeRows);
+    updateEdgeField(0, 0, mEdgeColumns, mEdgeRows);
+}
 
-            // Calculate origin point based on rotation so that top-left
-            // of rotated sprite ends up at (px, py)
-            Vector2 origin;
+// After the drivable area changed within samples [x0, x1) x [y0, y1):
+// exact distances, for every sample within EDGE_FIELD_REACH of those, to
+// the nearest sample of the other kind. Only samples another
+// EDGE_FIELD_REACH out can be that near, so the transforms run on that
+// window, padded where it meets the map's border with a ring of
+// off-track samples so the map's own edge is an edge too. The edge
+// itself lies halfway between the two kinds, half a step nearer than
+// either
+void Map::updateEdgeField(int x0, int y0, int x1, int y1)
+{
+    x0 = std::max(0, x0 - EDGE_FIELD_REACH);
+    y0 = std::max(0, y0 - EDGE_FIELD_REACH);
+    x1 = std::min(mEdgeColumns, x1 + EDGE_FIELD_REACH);
+    y1 = std::min(mEdgeRows, y1 + EDGE_FIELD_REACH);
+
+    int left   = std::max(-1, x0 - EDGE_FIELD_REACH);
+    int top    = std::max(-1, y0 - EDGE_FIELD_REACH);
+    int right  = std::min(mEdgeColumns + 1, x1 + EDGE_FIELD_REACH);
+    int bottom = std::min(mEdgeRows + 1, y1 + EDGE_FIELD_REACH);
+
+    int w = right - left;
+    int h = bottom - top;
+    std::vector<unsigned char> drivable(w * h, 0);
+    for (int y = std::max(0, top); y < std::min(mEdgeRows, bottom); y++)
+    {
+        const unsigned int *tiles = mLevelData + (y / EDGE_FIELD_SAMPLES) * mMapColumns;
+        for (int x = std::max(0, left); x < std::min(mEdgeColumns, right); x++)
+            drivable[(y - top) * w + x - left] =
+                (mTileTraits[tiles[x / EDGE_FIELD_SAMPLES]].flags & TILE_DRIVABLE) != 0;
+    }
 
-            if (fabs(obj.rotation) < 0.1f) {
-                // 0 degrees: top-left stays top-left
-                origin = { 0.0f, 0.0f };
-            }
-            else if (fabs(obj.rotation - 90.0f) < 0.1f) {
-                // 90 degrees: top-left becomes bottom-left
-                origin = { 0.0f, worldH };
-            }
-            else if (fabs(obj.rotation - 180.0f) < 0.1f) {
-                // 180 degrees: top-left becomes bottom-right
-                origin = { worldW, worldH };
-            }
-            else if (fabs(obj.rotation - 270.0f) < 0.1f || fabs(obj.rotation + 90.0f) < 0.1f) {
-                // 270 degrees: top-left becomes top-right
-                origin = { worldW, 0.0f };
-            }
-            else {
-                // General case for arbitrary rotations
-                origin = { 0.0f, 0.0f };
-            }
+    // to the nearest off-track sample, and to the nearest on-track one
+    std::vector<float> toOff(w * h), toOn(w * h);
+    for (int i = 0; i < w * h; i++)
+    {
+        toOff[i] = drivable[i] ? EDGE_FAR : 0.0f;
+        toOn[i]  = drivable[i] ? 0.0f : EDGE_FAR;
+    }
+    distanceTransform2D(toOff, w, h);
+    distanceTransform2D(toOn, w, h);
 
-            Rectangle dst = {
-                px,
-                py,
-                worldW,
-                worldH
-            };
-
-            DrawTexturePro(
-                obj.texture,
-                src,
-                dst,
-                origin,
-                obj.rotation,
-                WHITE
-            );
+    for (int y = y0; y < y1; y++)
+    {
+        for (int x = x0; x < x1; x++)
+        {
+            int i = (y - top) * w + x - left;
+            float steps = drivable[i] ? std::sqrt(toOff[i]) - 0.5f
+                                      : 0.5f - std::sqrt(toOn[i]);
+            float units = std::round(steps * mEdgeStep / mEdgeUnit);
+            mEdgeField[y * mEdgeColumns + x] = (signed char) std::max(-127.0f, std::min(127.0f, units));
         }
     }
 }
@@ -156,68 +326,192 @@ bool Map::isSolidTileAt(Vector2 position, float *xOverlap, float *yOverlap)
         tileYIndex < 0 || tileYIndex >= mMapRows)
         return false;
 
-    // Check tiles for multi-tile objects
-    for (int dy = -2; dy <= 2; dy++)
+    // First box in the probe's cell that contains it
+    int cell = tileYIndex * mMapColumns + tileXIndex;
+    for (int k = mCellStart[cell]; k < mCellStart[cell + 1]; k++)
     {
-        for (int dx = -2; dx <= 2; dx++)
+        const SolidBox &box = mSolidBoxes[mCellBoxes[k]];
+
+        float distX = fabs(position.x - box.centreX);
+        float distY = fabs(position.y - box.centreY);
+
+        if (distX < box.halfWidth && distY < box.halfHeight)
         {
-            int checkCol = tileXIndex + dx;
-            int checkRow = tileYIndex + dy;
+            *xOverlap = box.halfWidth - distX;
+            *yOverlap = box.halfHeight - distY;
+            return true;
+        }
+    }
+    // no collision found
+    return false;
+}
 
-            if (checkCol < 0 || checkCol >= mMapColumns ||
-                checkRow < 0 || checkRow >= mMapRows)
-                continue;
+// World-space collision box of the object anchored at (col, row), if any
+bool Map::getObjectBox(int col, int row, SolidBox *box) const
+{
+    const TileTraits &traits = mTileTraits[mLevelData[row * mMapColumns + col]];
+    if (traits.object < 0) return false;
 
-            int tile = mLevelData[checkRow * mMapColumns + checkCol];
+    const MultiTileObject &obj = mObjects[traits.object];
 
-            if (!mMultiTileObjects.count(tile))
-                continue;
+    // get dimensions
+    float objWidth  = obj.widthTiles * mTileSize;
+    float objHeight = obj.heightTiles * mTileSize;
 
-            MultiTileObject &obj = mMultiTileObjects[tile];
+    // swap dimensions for rotations
+    if (fabs(obj.rotation - 90.0f) < 0.1f || fabs(obj.rotation - 270.0f) < 0.1f || fabs(obj.rotation + 90.0f) < 0.1f)
+    {
+        float swap = objWidth;
+        objWidth  = objHeight;
+        objHeight = swap;
+    }
 
-            // get dimensions
-            float baseWidth = obj.widthTiles * mTileSize;
-            float baseHeight = obj.heightTiles * mTileSize;
+    // top-left of rotated object
+    box->left   = mLeftBoundary + col * mTileSize + obj.offset.x;
+    box->top    = mTopBoundary + row * mTileSize + obj.offset.y;
+    box->right  = box->left + objWidth;
+    box->bottom = box->top + objHeight;
+
+    box->halfWidth  = objWidth / 2.0f;
+    box->halfHeight = objHeight / 2.0f;
+    box->centreX    = box->left + objWidth / 2.0f;
+    box->centreY    = box->top + objHeight / 2.0f;
+    return true;
+}
 
-            // swap dimensions for rotations
-            float objWidth = baseWidth;
-            float objHeight = baseHeight;
+// Cells [min, max] covers, clamped onto the map so that an area past the
+// edge still reads the edge cells
+void Map::getCellRange(Vector2 min, Vector2 max, int *colMin, int *rowMin,
+                       int *colMax, int *rowMax) const
+{
+    *colMin = (int) floor((min.x - mLeftBoundary) / mTileSize);
+    *rowMin = (int) floor((min.y - mTopBoundary) / mTileSize);
+    *colMax = (int) floor((max.x - mLeftBoundary) / mTileSize);
+    *rowMax = (int) floor((max.y - mTopBoundary) / mTileSize);
+
+    *colMin = std::max(0, std::min(*colMin, mMapColumns - 1));
+    *rowMin = std::max(0, std::min(*rowMin, mMapRows - 1));
+    *colMax = std::max(0, std::min(*colMax, mMapColumns - 1));
+    *rowMax = std::max(0, std::min(*rowMax, mMapRows - 1));
+}
 
-            if (fabs(obj.rotation - 90.0f) < 0.1f || fabs(obj.rotation - 270.0f) < 0.1f || fabs(obj.rotation + 90.0f) < 0.1f)
+// Whether any object box overlaps the area [min, max]
+bool Map::touchesSolid(Vector2 min, Vector2 max) const
+{
+    int colMin, rowMin, colMax, rowMax;
+    getCellRange(min, max, &colMin, &rowMin, &colMax, &rowMax);
+
+    for (int row = rowMin; row <= rowMax; row++)
+    {
+        for (int col = colMin; col <= colMax; col++)
+        {
+            int cell = row * mMapColumns + col;
+            for (int k = mCellStart[cell]; k < mCellStart[cell + 1]; k++)
             {
-                objWidth = baseHeight;
-                objHeight = baseWidth;
+                const SolidBox &box = mSolidBoxes[mCellBoxes[k]];
+                if (box.left < max.x && box.right > min.x && box.top < max.y && box.bottom > min.y)
+                    return true;
             }
+        }
+    }
+    return false;
+}
 
-            // Calculate collision box position (top-left of rotated object)
-            float objLeft = mLeftBoundary + checkCol * mTileSize + obj.offset.x;
-            float objTop = mTopBoundary + checkRow * mTileSize + obj.offset.y;
+// Slides the box along x from center.x to toX. If it would enter an object
+// box on the way, returns true with hitX set to where it first touches.
+// Boxes the car already overlaps are left to the probes in isSolidTileAt.
+// A box spanning several cells is met once per cell, which only repeats
+// the same contact.
+bool Map::sweepSolidX(Vector2 center, Vector2 halfSize, float toX, float *hitX) const
+{
+    float dx = toX - center.x;
+    if (dx == 0.0f) return false;
 
-            float objCenterX = objLeft + objWidth / 2.0f;
-            float objCenterY = objTop + objHeight / 2.0f;
+    Vector2 min = { std::fmin(center.x, toX) - halfSize.x, center.y - halfSize.y };
+    Vector2 max = { std::fmax(center.x, toX) + halfSize.x, center.y + halfSize.y };
 
-            // Check if position is inside this object's bounding box
-            float halfWidth = objWidth / 2.0f;
-            float halfHeight = objHeight / 2.0f;
+    int colMin, rowMin, colMax, rowMax;
+    getCellRange(min, max, &colMin, &rowMin, &colMax, &rowMax);
 
-            float distX = fabs(position.x - objCenterX);
-            float distY = fabs(position.y - objCenterY);
+    bool hit = false;
+    *hitX = toX;
 
-            if (distX < halfWidth && distY < halfHeight)
+    for (int row = rowMin; row <= rowMax; row++)
+    {
+        for (int col = colMin; col <= colMax; col++)
+        {
+            int cell = row * mMapColumns + col;
+            for (int k = mCellStart[cell]; k < mCellStart[cell + 1]; k++)
             {
-                *xOverlap = halfWidth - distX;
-                *yOverlap = halfHeight - distY;
-                return true;
+                const SolidBox &box = mSolidBoxes[mCellBoxes[k]];
+
+                // must share some of the box's height to be hit at all
+                if (box.top >= max.y || box.bottom <= min.y) continue;
+
+                if (dx > 0.0f && center.x + halfSize.x <= box.left && toX + halfSize.x > box.left)
+                {
+                    float contact = box.left - halfSize.x;
+                    if (contact < *hitX) *hitX = contact;
+                    hit = true;
+                }
+                else if (dx < 0.0f && center.x - halfSize.x >= box.right && toX - halfSize.x < box.right)
+                {
+                    float contact = box.right + halfSize.x;
+                    if (contact > *hitX) *hitX = contact;
+                    hit = true;
+                }
             }
         }
     }
-    // no collision found
-    return false;
+    return hit;
+}
+
+bool Map::sweepSolidY(Vector2 center, Vector2 halfSize, float toY, float *hitY) const
+{
+    float dy = toY - center.y;
+    if (dy == 0.0f) return false;
+
+    Vector2 min = { center.x - halfSize.x, std::fmin(center.y, toY) - halfSize.y };
+    Vector2 max = { center.x + halfSize.x, std::fmax(center.y, toY) + halfSize.y };
+
+    int colMin, rowMin, colMax, rowMax;
+    getCellRange(min, max, &colMin, &rowMin, &colMax, &rowMax);
+
+    bool hit = false;
+    *hitY = toY;
+
+    for (int row = rowMin; row <= rowMax; row++)
+    {
+        for (int col = colMin; col <= colMax; col++)
+        {
+            int cell = row * mMapColumns + col;
+            for (int k = mCellStart[cell]; k < mCellStart[cell + 1]; k++)
+            {
+                const SolidBox &box = mSolidBoxes[mCellBoxes[k]];
+
+                // must share some of the box's width to be hit at all
+                if (box.left >= max.x || box.right <= min.x) continue;
+
+                if (dy > 0.0f && center.y + halfSize.y <= box.top && toY + halfSize.y > box.top)
+                {
+                    float contact = box.top - halfSize.y;
+                    if (contact < *hitY) *hitY = contact;
+                    hit = true;
+                }
+                else if (dy < 0.0f && center.y - halfSize.y >= box.bottom && toY - halfSize.y < box.bottom)
+                {
+                    float contact = box.bottom + halfSize.y;
+                    if (contact > *hitY) *hitY = contact;
+                    hit = true;
+                }
+            }
+        }
+    }
+    return hit;
 }
 
-void Map::registerMultiTileObject(
+int Map::registerMultiTileObject(
     int tileID,
-    const char* texturePath,
     int widthTiles,
     int heightTiles,
     Vector2 offset,
@@ -225,33 +519,112 @@ void Map::registerMultiTileObject(
     float rotation
 )
 {
-    Texture2D tex = LoadTexture(texturePath);
-
     MultiTileObject obj;
-    obj.texture    = tex;
     obj.widthTiles = widthTiles;
     obj.heightTiles = heightTiles;
     obj.offset     = offset;
     obj.scale      = scale;
     obj.rotation   = rotation;
 
-    mMultiTileObjects[tileID] = obj;
+    growTileTraits(tileID);
+    TileTraits &traits = mTileTraits[tileID];
+    bool wasDrivable = (traits.flags & TILE_DRIVABLE) != 0;
+    if (traits.object < 0)
+    {
+        traits.object = (short) mObjects.size();
+        mObjects.push_back(obj);
+    }
+    else
+    {
+        mObjects[traits.object] = obj;
+    }
+    // the anchor keeps its tile's surface: only tile 0 has ever been
+    // grass to the tyres, whatever stands on the others
+    traits.flags = (traits.flags & ~TILE_DRIVABLE) | TILE_OBJECT | TILE_SOLID;
+    buildCollisionGrid();
+
+    // the edge moves only round the cells showing the tile
+    int colMin = mMapColumns, rowMin = mMapRows, colMax = -1, rowMax = -1;
+    for (int cell : findAll((unsigned int) tileID))
+    {
+        colMin = std::min(colMin, cell % mMapColumns);
+        colMax = std::max(colMax, cell % mMapColumns);
+        rowMin = std::min(rowMin, cell / mMapColumns);
+        rowMax = std::max(rowMax, cell / mMapColumns);
+    }
+    if (wasDrivable && colMax >= 0)
+        updateEdgeField(colMin * EDGE_FIELD_SAMPLES, rowMin * EDGE_FIELD_SAMPLES,
+                        (colMax + 1) * EDGE_FIELD_SAMPLES, (rowMax + 1) * EDGE_FIELD_SAMPLES);
+    return traits.object;
 }
 
-Vector2 Map::findTile(int tileID) const {
-    for(int row = 0; row < mMapRows; row++) {
-        for(int col = 0; col < mMapColumns; col++) {
+TileCellRange Map::findAll(unsigned int tileID) const
+{
+    const int *cells = mTileCells.data();
+    if (mTileStart.empty() || tileID >= mTileStart.size() - 1) return { cells, cells };
+    return { cells + mTileStart[tileID], cells + mTileStart[tileID + 1] };
+}
 
-            int idx = row * mMapColumns + col;
-            if (mLevelData[idx] == tileID) {
-                float x = mLeftBoundary + col * mTileSize + mTileSize * 0.5f;
-                float y = mTopBoundary  + row * mTileSize + mTileSize * 0.5f;
-                return {x, y};
-            }
-        }
-    }
+Vector2 Map::findFirst(unsigned int tileID) const
+{
+    TileCellRange cells = findAll(tileID);
+    if (cells.empty()) return {0,0}; //default
+    return getCellCentre(*cells.begin());
+}
 
-    return {0,0}; //default
+Vector2 Map::getCellCentre(int cell) const
+{
+    int col = cell % mMapColumns;
+    int row = cell / mMapColumns;
+    float x = mLeftBoundary + col * mTileSize + mTileSize * 0.5f;
+    float y = mTopBoundary  + row * mTileSize + mTileSize * 0.5f;
+    return {x, y};
+}
+
+// Bilinear in the four samples round pos, whose slopes along each axis
+// give the gradient. Clamped at the field's border, so flat beyond it:
+// an axis pos is past the border on has no slope
+void Map::sampleEdgeField(Vector2 pos, float *distance, Vector2 *gradient) const
+{
+    float fx = (pos.x - mLeftBoundary) / mEdgeStep - 0.5f;
+    float fy = (pos.y - mTopBoundary)  / mEdgeStep - 0.5f;
+
+    int x0 = std::max(0, std::min(mEdgeColumns - 2, (int) std::floor(fx)));
+    int y0 = std::max(0, std::min(mEdgeRows - 2,    (int) std::floor(fy)));
+    bool clampedX = fx - x0 < 0.0f || fx - x0 > 1.0f;
+    bool clampedY = fy - y0 < 0.0f || fy - y0 > 1.0f;
+    float tx = std::max(0.0f, std::min(1.0f, fx - x0));
+    float ty = std::max(0.0f, std::min(1.0f, fy - y0));
+
+    const signed char *row0 = &mEdgeField[y0 * mEdgeColumns + x0];
+    const signed char *row1 = row0 + mEdgeColumns;
+    float d00 = row0[0], d10 = row0[1];
+    float d01 = row1[0], d11 = row1[1];
+
+    float top    = d00 + (d10 - d00) * tx;
+    float bottom = d01 + (d11 - d01) * tx;
+    *distance = (top + (bottom - top) * ty) * mEdgeUnit;
+
+    if (gradient == nullptr) return;
+
+    float slope = mEdgeUnit / mEdgeStep;
+    gradient->x = clampedX ? 0.0f : ((d10 - d00) + ((d11 - d01) - (d10 - d00)) * ty) * slope;
+    gradient->y = clampedY ? 0.0f : (bottom - top) * slope;
+}
+
+float Map::getEdgeDistance(Vector2 pos) const
+{
+    float distance;
+    sampleEdgeField(pos, &distance, nullptr);
+    return distance;
+}
+
+Vector2 Map::getEdgeGradient(Vector2 pos) const
+{
+    float distance;
+    Vector2 gradient;
+    sampleEdgeField(pos, &distance, &gradient);
+    return gradient;
 }
 
 int Map::getTileAtWorldPos(Vector2 pos) const
@@ -265,3 +638,71 @@ int Map::getTileAtWorldPos(Vector2 pos) const
     return mLevelData[row * mMapColumns + col];
 }
 
+TileTraits Map::getTileTraits(unsigned int tileID) const
+{
+    if (tileID >= mTileTraits.size()) return { 0, SURFACE_GRASS, -1 };
+    return mTileTraits[tileID];
+}
+
+bool Map::isDrivableAt(Vector2 pos) const
+{
+    int col = (int)((pos.x - mLeftBoundary) / mTileSize);
+    int row = (int)((pos.y - mTopBoundary)  / mTileSize);
+
+    if (col < 0 || row < 0 || col >= mMapColumns || row >= mMapRows)
+        return false;
+
+    return (mTileTraits[mLevelData[row * mMapColumns + col]].flags & TILE_DRIVABLE) != 0;
+}
+
+// Cells first, then one gather, so the arithmetic runs as a straight
+// loop the compiler can vectorise. Off the map reads as grass
+void Map::getSurfacesAtWorldPos(const Vector2 *positions, int count, unsigned char *surfaces) const
+{
+    // surfaces is too narrow to hold the cell indices between the two
+    // loops, so they go a block at a time through a small buffer
+    const int BLOCK = 64;
+    int cells[BLOCK];
+
+    for (int begin = 0; begin < count; begin += BLOCK) {
+        int n = std::min(BLOCK, count - begin);
+        const Vector2 *block = positions + begin;
+
+        for (int i = 0; i < n; i++) {
+            int col = (int)((block[i].x - mLeftBoundary) / mTileSize);
+            int row = (int)((block[i].y - mTopBoundary)  / mTileSize);
+            bool inside = col >= 0 && row >= 0 && col < mMapColumns && row < mMapRows;
+            cells[i] = inside ? row * mMapColumns + col : -1;
+        }
+
+        for (int i = 0; i < n; i++)
+            surfaces[begin + i] = cells[i] < 0 ? (unsigned char) SURFACE_GRASS : mSurfaceGrid[cells[i]];
+    }
+}
+
+void Map::setTileSurface(unsigned int tileID, SurfaceKind surface)
+{
+    growTileTraits(tileID);
+    mTileTraits[tileID].surface = (unsigned char) surface;
+    buildSurfaceGrid();
+}
+
+void Map::setCellSurface(int col, int row, SurfaceKind surface)
+{
+    if (col < 0 || row < 0 || col >= mMapColumns || row >= mMapRows) return;
+
+    int cell = row * mMapColumns + col;
+    SurfacePatch *patch = nullptr;
+    for (SurfacePatch &p : mSurfacePatches)
+        if (p.cell == cell) patch = &p;
+
+    if (patch == nullptr)
+    {
+        mSurfacePatches.push_back({ cell, (unsigned char) surface });
+    }
+    else
+    {
+        patch->surface = (unsigned char) surface;
+    }
+    mSurfaceGrid[cell] = (unsigned char) surface;
+}
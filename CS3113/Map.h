@@ -1,31 +1,80 @@
-#include "cs3113.h"
-#include <unordered_map>
+#ifndef MAP_H
+#define MAP_H
+
+#include "SimCommon.h"
+#include "Surface.h"
 
 
 struct MultiTileObject {
-    Texture2D texture;
     int widthTiles;
     int heightTiles;
     Vector2 offset;
     float scale;
-    float rotation;    
+    float rotation;
+};
+
+// Tile IDs with a fixed meaning in every track's level data and atlas
+const unsigned int TILE_GRASS             = 0;
+const unsigned int START_LINE_TOP_TILE    = 307;
+const unsigned int START_LINE_BOTTOM_TILE = 271;
+
+enum TileFlag {
+    TILE_DRIVABLE   = 1 << 0,   // track surface: not grass and not an object
+    TILE_OBJECT     = 1 << 1,   // anchors a registered multi-tile object
+    TILE_SOLID      = 1 << 2,   // that object has a collision box
+    TILE_START_LINE = 1 << 3
+};
+
+// Everything a tile ID means, in Map's table indexed by ID
+struct TileTraits {
+    unsigned char flags;
+    unsigned char surface;  // SurfaceKind of the level cells holding it
+    short object;           // index of its MultiTileObject, -1 for none
+};
+
+// Samples of the edge distance field along each side of a tile
+const int EDGE_FIELD_SAMPLES = 4;
+
+// A cell whose surface isn't its tile's, such as an oil spill
+struct SurfacePatch {
+    int cell;               // row * columns + col
+    unsigned char surface;
 };
 
+// An object's collision box in world space, with the centre and half
+// size isSolidTileAt measures overlaps from
+struct SolidBox {
+    float left, top, right, bottom;
+    float centreX, centreY;
+    float halfWidth, halfHeight;
+};
+
+// The cells holding one tile ID, in ascending order, each as
+// row * columns + col. Good until the map's tiles next change
+struct TileCellRange {
+    const int *first;
+    const int *last;
+
+    const int* begin() const { return first; }
+    const int* end()   const { return last; }
+    int size() const { return (int) (last - first); }
+    bool empty() const { return first == last; }
+};
+
+/*
+    Tile grid and collision queries. Holds no textures so it can run
+    headless; TrackMap layers the atlas and object sprites on top.
+*/
 class Map
 {
-private:
+protected:
     int mMapColumns; // number of columns in map
     int mMapRows;    // number of rows in map
 
     unsigned int *mLevelData; // array of tile indices
-    Texture2D mTextureAtlas;  // texture atlas
 
     float mTileSize; // size of each tile in pixels
 
-    int mTextureColumns; // number of columns in texture atlas
-    int mTextureRows;    // number of rows in texture atlas
-
-    std::vector<Rectangle> mTextureAreas; // texture areas for each tile
     Vector2 mOrigin; // center of the map in world coordinates
 
     float mLeftBoundary;  // left boundary of the map in world coordinates
@@ -33,43 +82,129 @@ private:
     float mTopBoundary;   // top boundary of the map in world coordinates
     float mBottomBoundary;// bottom boundary of the map in world coordinates
 
-    std::unordered_map<int, MultiTileObject> mMultiTileObjects;
+    // Indexed by tile ID, and always long enough for every ID in the
+    // level data, so a tile's traits are one load with no bounds check
+    std::vector<TileTraits> mTileTraits;
+    std::vector<MultiTileObject> mObjects;
+
+    // Every object box, filed under each cell it overlaps: cell c holds
+    // mSolidBoxes[mCellBoxes[mCellStart[c]]] .. up to mCellStart[c + 1],
+    // in the order of the tiles they're anchored on. A probe reads only
+    // its own cell. Rebuilt whenever the objects or tiles change
+    std::vector<SolidBox> mSolidBoxes;
+    std::vector<int> mCellStart;
+    std::vector<int> mCellBoxes;
+
+    // The SurfaceKind of every cell, from its tile's traits with the
+    // patches laid over them. One byte a cell, so the whole track is a
+    // few kilobytes and a wheel reads it with one load
+    std::vector<unsigned char> mSurfaceGrid;
+    std::vector<SurfacePatch> mSurfacePatches;
+
+    // Where each tile ID is: tile t's cells are mTileCells[mTileStart[t]]
+    // up to mTileStart[t + 1], ascending, so looking a tile up costs the
+    // number of times it appears rather than the size of the map
+    std::vector<int> mTileStart;
+    std::vector<int> mTileCells;
+
+    // Signed distance to the edge of the drivable area, positive on the
+    // track and negative off it, sampled EDGE_FIELD_SAMPLES times along
+    // each tile side. A byte a sample, in steps of an eighth of the
+    // sample spacing, so it saturates a few tiles out where nobody asks
+    std::vector<signed char> mEdgeField;
+    int mEdgeColumns;
+    int mEdgeRows;
+    float mEdgeStep;        // world distance between samples
+    float mEdgeUnit;        // world distance of one quantisation step
+
+    void sampleEdgeField(Vector2 pos, float *distance, Vector2 *gradient) const;
+
+    void growTileTraits(unsigned int tileID);
+    bool getObjectBox(int col, int row, SolidBox *box) const;
+    void getCellRange(Vector2 min, Vector2 max, int *colMin, int *rowMin,
+                      int *colMax, int *rowMax) const;
+    void buildCollisionGrid();
+    void buildSurfaceGrid();
+    void buildTileIndex();
+    void buildEdgeField();
+
+    // what an edit rebuilds: just the cells and samples it can reach
+    void updateSurfaceCell(int cell);
+    void moveTileCell(int cell, unsigned int from, unsigned int to);
+    void updateEdgeField(int x0, int y0, int x1, int y1);
 
 public:
     Map(int mapColumns, int mapRows, unsigned int *levelData,
-        const char *textureFilePath, float tileSize, int textureColumns,
-        int textureRows, Vector2 origin);
-    ~Map();
+        float tileSize, Vector2 origin);
+    virtual ~Map();
 
     void build();
-    void render();
     bool isSolidTileAt(Vector2 position, float *xOverlap, float *yOverlap);
 
+    // continuous collision against multi-tile object boxes, for a box of
+    // half size halfSize centred on center
+    bool touchesSolid(Vector2 min, Vector2 max) const;
+    bool sweepSolidX(Vector2 center, Vector2 halfSize, float toX, float *hitX) const;
+    bool sweepSolidY(Vector2 center, Vector2 halfSize, float toY, float *hitY) const;
+
     int           getMapColumns()     const { return mMapColumns;     };
     int           getMapRows()        const { return mMapRows;        };
     float         getTileSize()       const { return mTileSize;       };
     unsigned int* getLevelData()      const { return mLevelData;      };
-    Texture2D     getTextureAtlas()   const { return mTextureAtlas;   };
-    int           getTextureColumns() const { return mTextureColumns; };
-    int           getTextureRows()    const { return mTextureRows;    };
     float         getLeftBoundary()   const { return mLeftBoundary;   };
     float         getRightBoundary()  const { return mRightBoundary;  };
     float         getTopBoundary()    const { return mTopBoundary;    };
     float         getBottomBoundary() const { return mBottomBoundary; };
     int           getTileAtWorldPos(Vector2 pos) const;
 
-    Vector2 findTile(int tileID) const;
+    // Off the map, and IDs the map has never seen, are grass
+    TileTraits getTileTraits(unsigned int tileID) const;
+    bool isDrivableAt(Vector2 pos) const;
+
+    // the SurfaceKind under count points in one pass, into surfaces
+    void getSurfacesAtWorldPos(const Vector2 *positions, int count, unsigned char *surfaces) const;
+
+    // Every cell showing tileID, from now on
+    void setTileSurface(unsigned int tileID, SurfaceKind surface);
 
-    void setTileType(int index, int tileType) 
-        { mLevelData[index] = tileType; }
+    // One cell, whatever tile it holds; kept if the tiles change
+    void setCellSurface(int col, int row, SurfaceKind surface);
 
-    void registerMultiTileObject(
+    const std::vector<SurfacePatch>& getSurfacePatches() const { return mSurfacePatches; }
+
+    // How far pos is from the edge of the drivable area, bilinear between
+    // samples: positive on track, negative off it, 0 on the edge. Off
+    // the field it holds the nearest edge sample's value
+    float getEdgeDistance(Vector2 pos) const;
+
+    // Which way the edge distance grows at pos, per world unit: about
+    // unit length near an edge, pointing onto the track. Off the field
+    // it has no part across the border, as the distance is flat there
+    Vector2 getEdgeGradient(Vector2 pos) const;
+
+    int getObjectCount() const { return (int) mObjects.size(); }
+    const MultiTileObject& getObject(int index) const { return mObjects[index]; }
+
+    // Every cell showing tileID, and the centre of the first of them in
+    // reading order ({0, 0} if there is none)
+    TileCellRange findAll(unsigned int tileID) const;
+    Vector2 findFirst(unsigned int tileID) const;
+    Vector2 getCellCentre(int cell) const;
+
+    // Changes one cell's tile. Only what the cell reaches is rebuilt: its
+    // surface and index entry, the edge field a few tiles round it, and
+    // the collision grid if an object was or is anchored there
+    void setTileType(int index, int tileType);
+
+    // Returns the object's index; registering a tile ID again replaces it
+    int registerMultiTileObject(
         int tileID,
-        const char* texturePath,
         int widthTiles,
         int heightTiles,
         Vector2 offset = {0,0},
         float scale = 1.0f,
-        float rotation = 0.0f       
+        float rotation = 0.0f
     );
-};
\ No newline at end of file
+};
+
+#endif
@@ -0,0 +1,416 @@
+#include "PropPool.h"
+#include "FastMath.h"
+#include "StateHash.h"
+
+struct PropType {
+    float radius;
+    float invMass;
+    float damping;      // share of speed and spin lost per second
+};
+
+const PropType PROP_TYPES[PROP_KIND_COUNT] = {
+    { 22.0f, 1.0f / 4.0f,  3.0f },     // cone, light and skittish
+    { 34.0f, 1.0f / 60.0f, 5.0f },     // barrel
+    { 42.0f, 1.0f / 90.0f, 6.0f },     // tyre stack
+};
+
+const float PROP_MAX_RADIUS  = 42.0f;
+const float PROP_RESTITUTION = 0.5f;
+const float PROP_WAKE_MARGIN = 8.0f;    // sleep bounds past the prop's radius
+
+// a prop slower than this, for this long, goes to sleep
+const float PROP_SLEEP_SPEED = 20.0f;
+const float PROP_SLEEP_SPIN  = 30.0f;
+const float PROP_SLEEP_TIME  = 0.5f;
+
+// how much of a glancing blow turns into spin, and the most it can give
+const float PROP_SPIN_SHARE = 0.5f;
+const float PROP_MAX_SPIN   = 1080.0f;
+
+PropPool::PropPool(float cellSize)
+{
+    mCellSize = cellSize;
+    mInvCellSize = 1.0f / cellSize;
+}
+
+// Props start asleep; the first car to reach one wakes it
+int PropPool::add(PropKind kind, Vector2 position, float angle)
+{
+    int index = size();
+
+    mPosX.push_back(position.x);
+    mPosY.push_back(position.y);
+    mVelX.push_back(0.0f);
+    mVelY.push_back(0.0f);
+    mAngle.push_back(angle);
+    mSpin.push_back(0.0f);
+    mRestTime.push_back(0.0f);
+    mKind.push_back((unsigned char) kind);
+    mAwake.push_back(0);
+    mCellCol.push_back(0);
+    mCellRow.push_back(0);
+    mSleepCol.push_back(0);
+    mSleepRow.push_back(0);
+
+    mSleepGridDirty = true;
+    return index;
+}
+
+void PropPool::clear()
+{
+    std::vector<float>* arrays[] = {
+        &mPosX, &mPosY, &mVelX, &mVelY, &mAngle, &mSpin, &mRestTime
+    };
+    for (std::vector<float>* array : arrays) array->clear();
+
+    mKind.clear();
+    mAwake.clear();
+    mAwakeList.clear();
+    mCellCol.clear();
+    mCellRow.clear();
+    mSleepCol.clear();
+    mSleepRow.clear();
+    mSleepGrid = PropGrid();
+    mAwakeGrid = PropGrid();
+    mSleepGridDirty = false;
+}
+
+float PropPool::getRadius(int index) const
+{
+    return PROP_TYPES[mKind[index]].radius;
+}
+
+static unsigned int bucketOf(const PropGrid &grid, int col, int row)
+{
+    return ((unsigned int) col * 73856093u ^ (unsigned int) row * 19349663u) & grid.mask;
+}
+
+// Counting sort of the props into the buckets of their cells
+void PropPool::fileProps(PropGrid *grid, const int *props, int count)
+{
+    unsigned int buckets = 16;
+    while (buckets < (unsigned int) count * 2) buckets *= 2;
+    grid->mask = buckets - 1;
+    grid->bucketStart.assign(buckets + 1, 0);
+    grid->props.resize(count);
+    grid->cols.resize(count);
+    grid->rows.resize(count);
+
+    for (int k = 0; k < count; k++) {
+        int i = props[k];
+        mCellCol[i] = (int) fastFloor(mPosX[i] * mInvCellSize);
+        mCellRow[i] = (int) fastFloor(mPosY[i] * mInvCellSize);
+        grid->bucketStart[bucketOf(*grid, mCellCol[i], mCellRow[i])]++;
+    }
+
+    for (size_t b = 1; b + 1 < grid->bucketStart.size(); b++)
+        grid->bucketStart[b] += grid->bucketStart[b - 1];
+    grid->bucketStart.back() = count;
+
+    for (int k = count - 1; k >= 0; k--) {
+        int i = props[k];
+        int slot = --grid->bucketStart[bucketOf(*grid, mCellCol[i], mCellRow[i])];
+        grid->props[slot] = i;
+        grid->cols[slot] = mCellCol[i];
+        grid->rows[slot] = mCellRow[i];
+    }
+}
+
+// Every filed prop whose cell could put it in the box, each once
+void PropPool::findNear(const PropGrid &grid, Vector2 min, Vector2 max,
+                        std::vector<int> *out) const
+{
+    out->clear();
+    if (grid.mask == 0) return;
+
+    // a prop can hang over the edge of its cell
+    int col0 = (int) fastFloor((min.x - PROP_MAX_RADIUS) * mInvCellSize);
+    int col1 = (int) fastFloor((max.x + PROP_MAX_RADIUS) * mInvCellSize);
+    int row0 = (int) fastFloor((min.y - PROP_MAX_RADIUS) * mInvCellSize);
+    int row1 = (int) fastFloor((max.y + PROP_MAX_RADIUS) * mInvCellSize);
+
+    for (int row = row0; row <= row1; row++) {
+        for (int col = col0; col <= col1; col++) {
+            unsigned int b = bucketOf(grid, col, row);
+            for (int k = grid.bucketStart[b]; k < grid.bucketStart[b + 1]; k++)
+                if (grid.cols[k] == col && grid.rows[k] == row)
+                    out->push_back(grid.props[k]);
+        }
+    }
+}
+
+void PropPool::wake(int index)
+{
+    if (mAwake[index]) return;
+    mAwake[index] = 1;
+    mRestTime[index] = 0.0f;
+    mAwakeList.push_back(index);
+}
+
+void PropPool::wakeInside(Vector2 min, Vector2 max)
+{
+    if (mSleepGridDirty) {
+        std::vector<int> all(size());
+        for (int i = 0; i < size(); i++) all[i] = i;
+        fileProps(&mSleepGrid, all.data(), size());
+        mSleepCol = mCellCol;
+        mSleepRow = mCellRow;
+        mSleepGridDirty = false;
+    }
+
+    findNear(mSleepGrid, min, max, &mNear);
+    for (int i : mNear) {
+        if (mAwake[i]) continue;
+
+        float r = getRadius(i) + PROP_WAKE_MARGIN;
+        if (mPosX[i] - r > max.x || mPosX[i] + r < min.x ||
+            mPosY[i] - r > max.y || mPosY[i] + r < min.y) continue;
+
+        wake(i);
+    }
+}
+
+bool PropPool::collideBox(const OrientedBox &box, Vector2 velocity, float invMass,
+                          ContactDelta *delta)
+{
+    bool touched = false;
+
+    for (int i : mAwakeList) {
+        float r = getRadius(i);
+
+        // prop centre in the box's frame, and the nearest point of the box
+        float dx = mPosX[i] - box.centre.x;
+        float dy = mPosY[i] - box.centre.y;
+        float lx = dx * box.axis.x + dy * box.axis.y;
+        float ly = dy * box.axis.x - dx * box.axis.y;
+        float cx = std::fmax(-box.half.x, std::fmin(box.half.x, lx));
+        float cy = std::fmax(-box.half.y, std::fmin(box.half.y, ly));
+
+        float ox = lx - cx;
+        float oy = ly - cy;
+        float distSq = ox * ox + oy * oy;
+        if (distSq >= r * r) continue;
+
+        // normal from the box to the prop, in the box's frame
+        float nx, ny, depth;
+        if (distSq > 1e-6f) {
+            float dist = simSqrt(distSq);
+            nx = ox / dist;
+            ny = oy / dist;
+            depth = r - dist;
+        } else {
+            // centre inside the box: out through the nearest face
+            float gapX = box.half.x - std::fabs(lx);
+            float gapY = box.half.y - std::fabs(ly);
+            nx = gapX < gapY ? (lx < 0.0f ? -1.0f : 1.0f) : 0.0f;
+            ny = gapX < gapY ? 0.0f : (ly < 0.0f ? -1.0f : 1.0f);
+            depth = r + std::fmin(gapX, gapY);
+        }
+
+        Vector2 n = {
+            nx * box.axis.x - ny * box.axis.y,
+            nx * box.axis.y + ny * box.axis.x
+        };
+
+        float propInvMass = PROP_TYPES[mKind[i]].invMass;
+        float invMassSum = invMass + propInvMass;
+
+        float push = depth * 1.01f / invMassSum;
+        mPosX[i] += n.x * push * propInvMass;
+        mPosY[i] += n.y * push * propInvMass;
+        delta->push.x -= n.x * push * invMass;
+        delta->push.y -= n.y * push * invMass;
+
+        float relX = mVelX[i] - velocity.x;
+        float relY = mVelY[i] - velocity.y;
+        float closing = relX * n.x + relY * n.y;
+        if (closing < 0.0f) {
+            float impulse = -(1.0f + PROP_RESTITUTION) * closing / invMassSum;
+            mVelX[i] += n.x * impulse * propInvMass;
+            mVelY[i] += n.y * impulse * propInvMass;
+            delta->impulse.x -= n.x * impulse * invMass;
+            delta->impulse.y -= n.y * impulse * invMass;
+
+            // a glancing blow sets it spinning
+            float sliding = relY * n.x - relX * n.y;
+            float spin = mSpin[i] + PROP_SPIN_SHARE * sliding / r * RAD2DEG;
+            mSpin[i] = std::fmax(-PROP_MAX_SPIN, std::fmin(PROP_MAX_SPIN, spin));
+        }
+
+        mRestTime[i] = 0.0f;
+        touched = true;
+    }
+    return touched;
+}
+
+// Two round props, pushed apart and bounced by their masses
+static void resolveProps(float *posX, float *posY, float *velX, float *velY,
+                         int a, int b, float radiusA, float radiusB,
+                         float invMassA, float invMassB)
+{
+    float dx = posX[b] - posX[a];
+    float dy = posY[b] - posY[a];
+    float reach = radiusA + radiusB;
+    float distSq = dx * dx + dy * dy;
+    if (distSq >= reach * reach || distSq < 1e-6f) return;
+
+    float dist = simSqrt(distSq);
+    float nx = dx / dist;
+    float ny = dy / dist;
+    float invMassSum = invMassA + invMassB;
+
+    float push = (reach - dist) * 1.01f / invMassSum;
+    posX[a] -= nx * push * invMassA;
+    posY[a] -= ny * push * invMassA;
+    posX[b] += nx * push * invMassB;
+    posY[b] += ny * push * invMassB;
+
+    float closing = (velX[b] - velX[a]) * nx + (velY[b] - velY[a]) * ny;
+    if (closing >= 0.0f) return;
+
+    float impulse = -(1.0f + PROP_RESTITUTION) * closing / invMassSum;
+    velX[a] -= nx * impulse * invMassA;
+    velY[a] -= ny * impulse * invMassA;
+    velX[b] += nx * impulse * invMassB;
+    velY[b] += ny * impulse * invMassB;
+}
+
+// Against the awake props filed after it moved, then the sleeping ones
+// nearby, which wake if it reaches them
+void PropPool::collideProps(int i)
+{
+    float radius = getRadius(i);
+    float invMass = PROP_TYPES[mKind[i]].invMass;
+    float reach = radius + PROP_MAX_RADIUS;
+    Vector2 min = { mPosX[i] - reach, mPosY[i] - reach };
+    Vector2 max = { mPosX[i] + reach, mPosY[i] + reach };
+
+    // each awake pair once, from its lower index
+    findNear(mAwakeGrid, min, max, &mNear);
+    for (int j : mNear) {
+        if (j <= i) continue;
+        resolveProps(mPosX.data(), mPosY.data(), mVelX.data(), mVelY.data(), i, j,
+                     radius, getRadius(j), invMass, PROP_TYPES[mKind[j]].invMass);
+    }
+
+    findNear(mSleepGrid, min, max, &mNear);
+    for (int j : mNear) {
+        if (mAwake[j]) continue;
+
+        float dx = mPosX[j] - mPosX[i];
+        float dy = mPosY[j] - mPosY[i];
+        float touch = radius + getRadius(j);
+        if (dx * dx + dy * dy >= touch * touch) continue;
+
+        wake(j);
+        resolveProps(mPosX.data(), mPosY.data(), mVelX.data(), mVelY.data(), i, j,
+                     radius, getRadius(j), invMass, PROP_TYPES[mKind[j]].invMass);
+    }
+}
+
+// Damped drift, stopped and bounced by object boxes one axis at a time
+void PropPool::moveProp(int i, float dt, const Map *map)
+{
+    float keep = 1.0f / (1.0f + PROP_TYPES[mKind[i]].damping * dt);
+    mVelX[i] *= keep;
+    mVelY[i] *= keep;
+    mSpin[i] *= keep;
+
+    float r = getRadius(i);
+    float x = mPosX[i] + mVelX[i] * dt;
+    if (map != nullptr && map->touchesSolid({ x - r, mPosY[i] - r }, { x + r, mPosY[i] + r })) {
+        mVelX[i] *= -PROP_RESTITUTION;
+        x = mPosX[i];
+    }
+    mPosX[i] = x;
+
+    float y = mPosY[i] + mVelY[i] * dt;
+    if (map != nullptr && map->touchesSolid({ x - r, y - r }, { x + r, y + r })) {
+        mVelY[i] *= -PROP_RESTITUTION;
+        y = mPosY[i];
+    }
+    mPosY[i] = y;
+
+    mAngle[i] = wrapDegrees(mAngle[i] + mSpin[i] * dt);
+}
+
+void PropPool::step(float dt, const Map *map)
+{
+    if (mAwakeList.empty()) return;
+
+    for (int i : mAwakeList) moveProp(i, dt, map);
+    fileProps(&mAwakeGrid, mAwakeList.data(), (int) mAwakeList.size());
+
+    // the list can grow as props knock others awake; those are checked in
+    // turn against the ones still asleep, and move from next tick
+    for (size_t slot = 0; slot < mAwakeList.size(); slot++)
+        collideProps(mAwakeList[slot]);
+
+    // settle: still long enough and a prop sleeps where it lies
+    size_t kept = 0;
+    for (int i : mAwakeList) {
+        float speedSq = mVelX[i] * mVelX[i] + mVelY[i] * mVelY[i];
+        bool still = speedSq < PROP_SLEEP_SPEED * PROP_SLEEP_SPEED &&
+                     std::fabs(mSpin[i]) < PROP_SLEEP_SPIN;
+        mRestTime[i] = still ? mRestTime[i] + dt : 0.0f;
+
+        if (mRestTime[i] < PROP_SLEEP_TIME) {
+            mAwakeList[kept++] = i;
+            continue;
+        }
+
+        mAwake[i] = 0;
+        mVelX[i] = mVelY[i] = mSpin[i] = 0.0f;
+
+        // still filed under its old cell if it hasn't left it
+        if ((int) fastFloor(mPosX[i] * mInvCellSize) != mSleepCol[i] ||
+            (int) fastFloor(mPosY[i] * mInvCellSize) != mSleepRow[i])
+            mSleepGridDirty = true;
+    }
+    mAwakeList.resize(kept);
+}
+
+void PropPool::saveState(PropState *props, uint16_t *awake) const
+{
+    for (int i = 0; i < size(); i++) {
+        props[i].pos = { mPosX[i], mPosY[i] };
+        props[i].vel = { mVelX[i], mVelY[i] };
+        props[i].angle = mAngle[i];
+        props[i].spin = mSpin[i];
+        props[i].restTime = mRestTime[i];
+    }
+    for (size_t k = 0; k < mAwakeList.size(); k++) awake[k] = (uint16_t) mAwakeList[k];
+}
+
+// The awake list keeps its order: props knock each other in that order
+void PropPool::restoreState(const PropState *props, const uint16_t *awake, int awakeCount)
+{
+    for (int i = 0; i < size(); i++) {
+        mPosX[i] = props[i].pos.x;
+        mPosY[i] = props[i].pos.y;
+        mVelX[i] = props[i].vel.x;
+        mVelY[i] = props[i].vel.y;
+        mAngle[i] = props[i].angle;
+        mSpin[i] = props[i].spin;
+        mRestTime[i] = props[i].restTime;
+        mAwake[i] = 0;
+    }
+
+    mAwakeList.assign(awake, awake + awakeCount);
+    for (int i : mAwakeList) mAwake[i] = 1;
+    mSleepGridDirty = true;
+}
+
+// A sleeping prop can't change, so only the awake ones are folded in
+uint64_t PropPool::hashState(uint64_t h) const
+{
+    for (int i : mAwakeList) {
+        h = hashWord(h, (uint32_t) i);
+        h = hashFloat(h, mPosX[i]);
+        h = hashFloat(h, mPosY[i]);
+        h = hashFloat(h, mVelX[i]);
+        h = hashFloat(h, mVelY[i]);
+        h = hashFloat(h, mAngle[i]);
+    }
+    return h;
+}
@@ -0,0 +1,111 @@
+#ifndef PROPPOOL_H
+#define PROPPOOL_H
+
+#include "Contact.h"
+#include "Map.h"
+#include <cstdint>
+
+/*
+    Knockable trackside props (cones, barrels, tyre stacks) as round rigid
+    bodies in one structure-of-arrays pool.
+
+    A prop that has sat still for PROP_SLEEP_TIME goes to sleep: it drops
+    off the awake list and step() never looks at it again. Sleeping props
+    are kept in a hashed grid of tile-sized cells so wakeInside() can find
+    the ones under a box without touching the rest. RaceWorld calls it
+    with each car's broadphase bounds, so a line of untouched cones costs
+    a few cell lookups per car and nothing per cone.
+
+    Awake props are pushed by cars (collideBox), by each other, and stop
+    against object boxes on the map. Waking a prop never moves it, and the
+    sleeping grid is only rebuilt when one goes back to sleep somewhere
+    new. The awake props get a grid of their own each step, so a pile-up
+    that knocks a whole row loose doesn't go quadratic.
+*/
+
+enum PropKind { PROP_CONE, PROP_BARREL, PROP_TYRES, PROP_KIND_COUNT };
+
+// One prop as a RaceState keeps it. Kind and count don't change in a race
+struct PropState {
+    Vector2 pos;
+    Vector2 vel;
+    float angle;
+    float spin;
+    float restTime;
+};
+
+// Props filed by the cell their centre is in, hashed into buckets: bucket
+// b holds props[bucketStart[b]] .. props[bucketStart[b + 1] - 1]
+struct PropGrid {
+    std::vector<int> bucketStart;
+    std::vector<int> props;
+    std::vector<int> cols, rows;    // each filed prop's cell, as in props
+    unsigned int mask = 0;
+};
+
+class PropPool {
+private:
+    // per prop
+    std::vector<float> mPosX, mPosY;
+    std::vector<float> mVelX, mVelY;
+    std::vector<float> mAngle;      // degrees
+    std::vector<float> mSpin;       // degrees per second
+    std::vector<float> mRestTime;   // how long it has been still
+    std::vector<unsigned char> mKind;
+    std::vector<unsigned char> mAwake;
+
+    std::vector<int> mAwakeList;
+
+    float mCellSize;
+    float mInvCellSize;
+    PropGrid mSleepGrid;    // every prop, awake ones skipped
+    PropGrid mAwakeGrid;    // the awake list, refiled every step
+    bool mSleepGridDirty = false;
+    std::vector<int> mCellCol, mCellRow;    // per prop, where last filed
+    std::vector<int> mSleepCol, mSleepRow;  // per prop, its cell in mSleepGrid
+    std::vector<int> mNear;
+
+    void fileProps(PropGrid *grid, const int *props, int count);
+    void findNear(const PropGrid &grid, Vector2 min, Vector2 max,
+                  std::vector<int> *out) const;
+    void wake(int index);
+    void collideProps(int index);
+    void moveProp(int index, float dt, const Map *map);
+
+public:
+    explicit PropPool(float cellSize = 450.0f);
+
+    int  add(PropKind kind, Vector2 position, float angle = 0.0f);
+    void clear();
+
+    // Wakes every sleeping prop whose bounds overlap the box
+    void wakeInside(Vector2 min, Vector2 max);
+
+    // Pushes awake props out of a moving box and bounces them off it. The
+    // box's share of the push and impulse, by invMass, is added to delta.
+    // Returns whether any prop touched it.
+    bool collideBox(const OrientedBox &box, Vector2 velocity, float invMass,
+                    ContactDelta *delta);
+
+    void step(float dt, const Map *map);
+
+    int      size()                 const { return (int) mPosX.size(); }
+    int      getAwakeCount()        const { return (int) mAwakeList.size(); }
+    Vector2  getPosition(int index) const { return { mPosX[index], mPosY[index] }; }
+    float    getAngle(int index)    const { return mAngle[index]; }
+    PropKind getKind(int index)     const { return (PropKind) mKind[index]; }
+    bool     isAwake(int index)     const { return mAwake[index] != 0; }
+    float    getRadius(int index)   const;
+
+    // Every prop into props[0..size()), and the awake list in the order
+    // they step into awake[0..getAwakeCount()), for RaceState
+    void saveState(PropState *props, uint16_t *awake) const;
+
+    // Puts back what saveState wrote from this pool. The sleeping grid is
+    // refiled from the restored positions before it is next searched.
+    void restoreState(const PropState *props, const uint16_t *awake, int awakeCount);
+
+    uint64_t hashState(uint64_t h) const;
+};
+
+#endif // PROPPOOL_H
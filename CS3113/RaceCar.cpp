@@ -0,0 +1,39 @@
+#include "RaceCar.h"
+
+RaceCar::RaceCar(Vector2 startPos,
+                 Vector2 scale,
+                 const char* texturePath,
+                 CarProfile profile) : Car{startPos, scale, profile} {
+    mTexture = LoadTexture(texturePath);
+}
+
+RaceCar::~RaceCar() {
+    UnloadTexture(mTexture);
+}
+
+void RaceCar::render()
+{
+    Rectangle src = {0,0,(float)mTexture.width,(float)mTexture.height};
+
+    Rectangle dst = {
+        mPos.x,
+        mPos.y,
+        mScale.x,
+        mScale.y
+    };
+
+    Vector2 origin = { mScale.x*0.5f, mScale.y*0.5f };
+
+    DrawTexturePro(mTexture, src, dst, origin, getAngle(), WHITE);
+}
+
+void RaceCar::displayCollider()
+{
+    DrawRectangleLines(
+        (int)(mPos.x - mScale.x / 2.0f),
+        (int)(mPos.y - mScale.y / 2.0f),
+        (int)mScale.x,
+        (int)mScale.y,
+        GREEN
+    );
+}
@@ -0,0 +1,25 @@
+#ifndef RACECAR_H
+#define RACECAR_H
+
+#include "cs3113.h"
+#include "car.h"
+
+/*
+    A Car as the game shows it: the headless physics body plus its sprite.
+*/
+class RaceCar : public Car {
+private:
+    Texture2D mTexture;
+
+public:
+    RaceCar(Vector2 startPos,
+            Vector2 scale,
+            const char* texturePath,
+            CarProfile profile);
+    ~RaceCar();
+
+    void render();
+    void displayCollider();
+};
+
+#endif
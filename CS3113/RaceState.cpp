@@ -0,0 +1,33 @@
+#include "RaceState.h"
+#include <cstring>
+
+RaceHistory::RaceHistory(int capacity)
+{
+    reset(capacity);
+}
+
+void RaceHistory::reset(int capacity)
+{
+    mSlots.resize(capacity);
+    clear();
+}
+
+void RaceHistory::push(const RaceState &state)
+{
+    if (mSlots.empty()) return;
+
+    mNewest = (mNewest + 1) % capacity();
+    std::memcpy(&mSlots[mNewest], &state, sizeof(RaceState));
+    if (mCount < capacity()) mCount++;
+}
+
+bool RaceHistory::rewind(int ticks, RaceState *out)
+{
+    if (mCount == 0) return false;
+    if (ticks > mCount - 1) ticks = mCount - 1;
+
+    mNewest = (mNewest - ticks + capacity()) % capacity();
+    mCount -= ticks;
+    std::memcpy(out, &mSlots[mNewest], sizeof(RaceState));
+    return true;
+}
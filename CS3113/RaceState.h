@@ -0,0 +1,92 @@
+#ifndef RACESTATE_H
+#define RACESTATE_H
+
+#include "car.h"
+#include "PropPool.h"
+#include <cstdint>
+#include <type_traits>
+
+/*
+    The whole race at the end of one tick, as a single block of plain
+    data: every car, RaceWorld's tiers, the props and the track's lap
+    tracking. It has no pointers or containers, so saving it or putting it
+    back is one memcpy, and a RaceHistory of them allocates nothing once
+    it is made.
+*/
+
+const int RACE_MAX_CARS = 8;
+const int RACE_MAX_PROPS = 256;
+
+// What a track keeps for hotlap and race mode, see TrackOne
+struct TrackProgress {
+    // hotlap
+    bool inLap;
+    bool lapDisqualified;
+    float currentLapTime;
+    float bestLapTime;
+    Vector2 prevCarPos;
+    int currentCorner;
+
+    // race, indexed like the cars: the player first
+    int lapCount[RACE_MAX_CARS];
+    Vector2 prevCarPositions[RACE_MAX_CARS];
+    int aiCurrentWaypoint[RACE_MAX_CARS];
+    bool raceFinished;
+    bool incompleteLapWarning;
+    int playerFinishPosition;
+    int raceCurrentCorner;
+};
+
+struct RaceState {
+    uint64_t tick;                          // GameState::tick
+
+    int carCount;
+    CarState cars[RACE_MAX_CARS];
+
+    // RaceWorld's level of detail, so coarse cars keep their stride
+    unsigned int worldTick;
+    unsigned char tier[RACE_MAX_CARS];
+    float skipped[RACE_MAX_CARS];
+
+    // RaceWorld's props, and which are awake in the order they step
+    int propCount;
+    int awakePropCount;
+    PropState props[RACE_MAX_PROPS];
+    uint16_t awakeProps[RACE_MAX_PROPS];
+
+    TrackProgress track;
+};
+
+static_assert(std::is_trivially_copyable<RaceState>::value,
+              "RaceState is saved and restored with memcpy");
+
+/*
+    The last capacity() ticks of RaceState in a ring allocated up front.
+    push() overwrites the oldest once it is full; rewind() steps back by
+    index arithmetic alone, so both cost the same however long the race.
+*/
+class RaceHistory {
+private:
+    std::vector<RaceState> mSlots;
+    int mNewest = -1;
+    int mCount = 0;
+
+public:
+    explicit RaceHistory(int capacity = 0);
+
+    // drops every saved tick; only this allocates
+    void reset(int capacity);
+    void clear() { mNewest = -1; mCount = 0; }
+
+    void push(const RaceState &state);
+
+    // Copies the state from ticks pushes ago into out (0 is the newest)
+    // and forgets everything after it, so the next push follows on from
+    // there. Goes back as far as it has if asked for more. False if empty
+    bool rewind(int ticks, RaceState *out);
+
+    int size() const { return mCount; }
+    int capacity() const { return (int) mSlots.size(); }
+};
+
+#endif // RACESTATE_H
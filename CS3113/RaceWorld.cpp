@@ -0,0 +1,327 @@
+#include "RaceWorld.h"
+
+// Slipstream cone behind a car: full strength right on its tail, fading
+// to nothing DRAFT_RANGE back or at the cone's edge
+const float DRAFT_RANGE      = 900.0f;   // six car lengths
+const float DRAFT_SPREAD     = 0.2f;     // cone half-width per unit back
+const float DRAFT_TAIL_WIDTH = 40.0f;    // half-width at the leader's tail
+const float DRAFT_MIN_SPEED  = 300.0f;   // below this neither car drafts
+
+// Level of detail: a coarse car steps at 15 Hz, and keeps full physics
+// while within two car lengths of any other car. Leaving the focus takes
+// two tiles past its radius, so a car on the edge doesn't flip every tick
+const int   COARSE_STRIDE     = 4;
+const float WAKE_DISTANCE     = 300.0f;
+const float FOCUS_HYSTERESIS  = 900.0f;
+
+RaceWorld::RaceWorld(float cellSize) : mBroadphase(cellSize) {}
+
+int RaceWorld::add(Car *car)
+{
+    mDeltas.push_back(ContactDelta());
+    mTouched.push_back(0);
+    mTier.push_back(TIER_FULL);
+    mSkipped.push_back(0.0f);
+    mStepDt.push_back(0.0f);
+    return mBroadphase.add(car);
+}
+
+void RaceWorld::clear()
+{
+    mBroadphase.clear();
+    mBoxA.clear();
+    mBoxB.clear();
+    mContacts.clear();
+    mDeltas.clear();
+    mTouched.clear();
+    mTier.clear();
+    mSkipped.clear();
+    mStepDt.clear();
+    mHasFocus = false;
+    mTick = 0;
+    mProps = nullptr;
+}
+
+void RaceWorld::setFocus(Vector2 centre, float radius)
+{
+    mHasFocus = true;
+    mFocus = centre;
+    mFocusRadius = radius;
+}
+
+void RaceWorld::step(float dt, Map *map)
+{
+    beginStep(dt);
+    stepCars(0, getCount(), map);
+    resolveContacts(map);
+}
+
+bool RaceWorld::save(RaceState *out) const
+{
+    if (getCount() > RACE_MAX_CARS) return false;
+    if (mProps != nullptr && mProps->size() > RACE_MAX_PROPS) return false;
+
+    out->carCount = getCount();
+    out->worldTick = mTick;
+    for (int i = 0; i < getCount(); i++) {
+        mBroadphase.getCar(i)->saveState(&out->cars[i]);
+        out->tier[i] = mTier[i];
+        out->skipped[i] = mSkipped[i];
+    }
+
+    out->propCount = 0;
+    out->awakePropCount = 0;
+    if (mProps != nullptr) {
+        out->propCount = mProps->size();
+        out->awakePropCount = mProps->getAwakeCount();
+        mProps->saveState(out->props, out->awakeProps);
+    }
+    return true;
+}
+
+void RaceWorld::restore(const RaceState &in)
+{
+    mTick = in.worldTick;
+    for (int i = 0; i < in.carCount && i < getCount(); i++) {
+        mBroadphase.getCar(i)->restoreState(in.cars[i]);
+        mTier[i] = in.tier[i];
+        mSkipped[i] = in.skipped[i];
+    }
+
+    if (mProps != nullptr && in.propCount == mProps->size())
+        mProps->restoreState(in.props, in.awakeProps, in.awakePropCount);
+}
+
+// Pairs are found before anyone moves. A car's bounds allow for the
+// longest step it can take this tick: its skipped time as well, should
+// it step or come back to full
+void RaceWorld::beginStep(float dt)
+{
+    for (int i = 0; i < getCount(); i++) mStepDt[i] = mSkipped[i] + dt;
+    mBroadphase.update(mStepDt.data());
+    updateTiers(dt);
+    updateDraft();
+    mDt = dt;
+
+    if (mProps == nullptr) return;
+    for (int i = 0; i < getCount(); i++) {
+        const CarBounds &bounds = mBroadphase.getBounds(i);
+        mProps->wakeInside({ bounds.minX, bounds.minY }, { bounds.maxX, bounds.maxY });
+    }
+}
+
+// Whether any other car is within WAKE_DISTANCE of this one's bounds
+bool RaceWorld::isCrowded(int index)
+{
+    Vector2 pos = mBroadphase.getCar(index)->getPosition();
+    Vector2 min = { pos.x - WAKE_DISTANCE, pos.y - WAKE_DISTANCE };
+    Vector2 max = { pos.x + WAKE_DISTANCE, pos.y + WAKE_DISTANCE };
+
+    mBroadphase.query(min, max, &mNearby);
+    for (int other : mNearby)
+        if (other != index) return true;
+    return false;
+}
+
+void RaceWorld::updateTiers(float dt)
+{
+    for (int tier = 0; tier < SIM_TIER_COUNT; tier++) mTierCount[tier] = 0;
+
+    for (int i = 0; i < getCount(); i++) {
+        // coarse cars are spread over the stride so each tick steps a share
+        // of them. Out of the focus a car only changes tier on its stride
+        // tick, so the crowding query runs once a stride, not every tick
+        bool strideTick = (mTick + i) % COARSE_STRIDE == 0;
+        bool full = !mHasFocus;
+
+        if (!full) {
+            Vector2 pos = mBroadphase.getCar(i)->getPosition();
+            float dx = pos.x - mFocus.x;
+            float dy = pos.y - mFocus.y;
+            float reach = mFocusRadius + (mTier[i] == TIER_FULL ? FOCUS_HYSTERESIS : 0.0f);
+            full = dx * dx + dy * dy < reach * reach;
+            if (!full) full = strideTick ? isCrowded(i) : mTier[i] == TIER_FULL;
+        }
+
+        mTier[i] = full ? TIER_FULL : TIER_COARSE;
+        mTierCount[mTier[i]]++;
+        mSkipped[i] += dt;
+
+        // a car just back to full catches up in this step
+        if (full || strideTick) {
+            mStepDt[i] = mSkipped[i];
+            mSkipped[i] = 0.0f;
+        } else {
+            mStepDt[i] = 0.0f;
+        }
+    }
+    mTick++;
+}
+
+// How deep pos sits in the leader's slipstream, 0..1
+float RaceWorld::draftBehind(int leader, Vector2 pos) const
+{
+    const Car *car = mBroadphase.getCar(leader);
+    if (car->getSpeed() < DRAFT_MIN_SPEED) return 0.0f;
+
+    OrientedBox box = car->getBox();
+    Vector2 d = { pos.x - box.centre.x, pos.y - box.centre.y };
+
+    // distance back from the leader's tail, and off its centre line
+    float back = -(d.x * box.axis.x + d.y * box.axis.y) - box.half.x;
+    float side = std::fabs(d.x * box.axis.y - d.y * box.axis.x);
+    if (back <= 0.0f || back >= DRAFT_RANGE) return 0.0f;
+
+    float halfWidth = DRAFT_TAIL_WIDTH + back * DRAFT_SPREAD;
+    if (side >= halfWidth) return 0.0f;
+
+    return (1.0f - back / DRAFT_RANGE) * (1.0f - side / halfWidth);
+}
+
+// Only for cars that step this tick: a coarse car between its steps
+// never reads its draft
+void RaceWorld::updateDraft()
+{
+    for (int i = 0; i < getCount(); i++) {
+        if (mStepDt[i] <= 0.0f) continue;
+        Car *car = mBroadphase.getCar(i);
+        float draft = 0.0f;
+
+        if (car->getSpeed() >= DRAFT_MIN_SPEED) {
+            // a leader whose cone reaches us is ahead of us; look only
+            // along our own heading, as wide as the cone gets
+            OrientedBox box = car->getBox();
+            float reach = DRAFT_RANGE + 2.0f * box.half.x;
+            float width = DRAFT_TAIL_WIDTH + DRAFT_RANGE * DRAFT_SPREAD;
+
+            Vector2 tip = { box.centre.x + box.axis.x * reach, box.centre.y + box.axis.y * reach };
+            Vector2 min = { std::fmin(box.centre.x, tip.x) - width, std::fmin(box.centre.y, tip.y) - width };
+            Vector2 max = { std::fmax(box.centre.x, tip.x) + width, std::fmax(box.centre.y, tip.y) + width };
+
+            mBroadphase.query(min, max, &mNearby);
+            for (int other : mNearby)
+                if (other != i) draft = std::fmax(draft, draftBehind(other, box.centre));
+        }
+
+        car->setDraft(draft);
+    }
+}
+
+// Each car by the step beginStep gave it. Anything longer than a tick,
+// a coarse step or a catch-up, goes through RK2: Euler's damping and slip
+// correction are per call, so they'd be wrong over several ticks at once,
+// and over at most COARSE_STRIDE ticks RK2 holds the line for half of
+// RK4's evaluations
+void RaceWorld::stepCars(int begin, int end, Map *map)
+{
+    for (int i = begin; i < end; i++) {
+        Car *car = mBroadphase.getCar(i);
+
+        if (mTier[i] == TIER_FULL && mStepDt[i] <= mDt) {
+            car->step(mStepDt[i], map);
+        } else if (mStepDt[i] > 0.0f) {
+            Integrator integrator = car->getIntegrator();
+            car->setIntegrator(RK2);
+            car->step(mStepDt[i], map);
+            car->setIntegrator(integrator);
+        }
+    }
+}
+
+void RaceWorld::resolveContacts(Map *map)
+{
+    // sum every contact's effect from the phase 1 state
+    collectCarContacts();
+    if (mProps != nullptr) collectPropContacts();
+
+    // then commit
+    for (int i = 0; i < getCount(); i++) {
+        if (!mTouched[i]) continue;
+        mBroadphase.getCar(i)->applyContact(mDeltas[i], map);
+        mTouched[i] = 0;
+    }
+
+    if (mProps != nullptr) mProps->step(mDt, map);
+
+    sampleSurfaces(map);
+}
+
+// A car's wheels are where this tick left them until it next steps, so
+// coarse cars waiting out their stride aren't looked up again
+void RaceWorld::sampleSurfaces(Map *map)
+{
+    if (map == nullptr) return;
+
+    mSampled.clear();
+    for (int i = 0; i < getCount(); i++)
+        if (mBroadphase.getCar(i)->needsSurface()) mSampled.push_back(i);
+    if (mSampled.empty()) return;
+
+    mWheelPos.resize(mSampled.size() * WHEEL_COUNT);
+    mWheelSurfaces.resize(mWheelPos.size());
+
+    for (size_t k = 0; k < mSampled.size(); k++)
+        mBroadphase.getCar(mSampled[k])->getWheelPositions(&mWheelPos[k * WHEEL_COUNT]);
+
+    map->getSurfacesAtWorldPos(mWheelPos.data(), (int) mWheelPos.size(), mWheelSurfaces.data());
+
+    for (size_t k = 0; k < mSampled.size(); k++)
+        mBroadphase.getCar(mSampled[k])->setWheelSurfaces(&mWheelSurfaces[k * WHEEL_COUNT]);
+}
+
+// Starts a car's delta the first time a contact reaches it this tick
+void RaceWorld::touch(int index)
+{
+    if (mTouched[index]) return;
+    mDeltas[index] = { { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+    mTouched[index] = 1;
+}
+
+void RaceWorld::collectCarContacts()
+{
+    const std::vector<CandidatePair> &pairs = mBroadphase.getPairs();
+    if (pairs.empty()) return;
+
+    mBoxA.resize(pairs.size());
+    mBoxB.resize(pairs.size());
+    mContacts.resize(pairs.size());
+
+    for (size_t k = 0; k < pairs.size(); k++) {
+        mBoxA[k] = mBroadphase.getCar(pairs[k].a)->getBox();
+        mBoxB[k] = mBroadphase.getCar(pairs[k].b)->getBox();
+    }
+
+    if (findContacts(mBoxA.data(), mBoxB.data(), (int) pairs.size(), mContacts.data()) == 0)
+        return;
+
+    for (size_t k = 0; k < pairs.size(); k++) {
+        if (mContacts[k].depth <= 0.0f) continue;
+
+        int a = pairs[k].a;
+        int b = pairs[k].b;
+        touch(a);
+        touch(b);
+
+        mBroadphase.getCar(a)->contactResponse(*mBroadphase.getCar(b), mContacts[k],
+                                               &mDeltas[a], &mDeltas[b]);
+    }
+}
+
+// Props move as they're hit; the cars' share goes into their deltas
+void RaceWorld::collectPropContacts()
+{
+    if (mProps->getAwakeCount() == 0) return;
+
+    for (int i = 0; i < getCount(); i++) {
+        Car *car = mBroadphase.getCar(i);
+        ContactDelta delta = { { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+        if (!mProps->collideBox(car->getBox(), car->getVelocity(), car->getInvMass(), &delta))
+            continue;
+
+        touch(i);
+        mDeltas[i].push.x += delta.push.x;
+        mDeltas[i].push.y += delta.push.y;
+        mDeltas[i].impulse.x += delta.impulse.x;
+        mDeltas[i].impulse.y += delta.impulse.y;
+    }
+}
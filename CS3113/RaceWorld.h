@@ -0,0 +1,133 @@
+#ifndef RACEWORLD_H
+#define RACEWORLD_H
+
+#include "Broadphase.h"
+#include "PropPool.h"
+#include "RaceState.h"
+
+/*
+    A field of cars stepped as one tick in three phases:
+
+        1. integrate  every car runs Car::step, its own physics and map
+                      collision. A car's step reads and writes only that
+                      car, so the cars can go in any order or be split
+                      across threads (stepCars takes a range for that)
+        2. contacts   the broadphase pairs go through the oriented box
+                      test a block of lanes at a time. Each contact's
+                      push and impulse are worked out from the phase 1
+                      state and summed per car, without moving anyone
+        3. commit     each touched car applies its summed delta, then its
+                      wall checks. Then every car that moved gets the
+                      tiles under its four wheels for the next tick, all
+                      of them looked up in one pass over the grid
+
+    No car reads another mid-change, so the tick comes out the same
+    whatever order phase 1 runs in. Pairs, and the sums in phase 2, go in
+    the broadphase's order, which depends only on where the cars are and
+    the order they were added.
+
+    Before phase 1 each car also gets its slipstream factor (Car::setDraft)
+    from the cars ahead of it, found through a broadphase query rather
+    than a scan of the field. That reads start-of-tick positions only, so
+    it too is the same in any order.
+
+    Cars can also drop to a coarse tier (setFocus). A car far from the
+    focus, usually the camera, with nobody near it is stepped every
+    COARSE_STRIDE ticks over the time it skipped, with RK2 so the long
+    step stays on line. It comes back to full the tick it nears the focus,
+    or on its next stride tick once another car is near, catching up its
+    skipped time first, again with RK2.
+    The focus radius covers the screen, so the catch-up is never seen.
+    Its broadphase bounds cover the whole of a long step.
+
+    Trackside props (setProps) ride along: each car's broadphase bounds
+    wake the props under them in beginStep, awake props push on the cars
+    in phase 2 like another contact, and the props step after the commit.
+
+    save() and restore() put every car, the tiers and the props in a
+    RaceState, for rewinding through a RaceHistory. A restored world steps
+    on exactly as it did from the tick it was saved.
+
+    Cars and props are not owned; the scene keeps them alive while they're added.
+*/
+// How much simulation a car gets this tick
+enum SimTier { TIER_FULL, TIER_COARSE, SIM_TIER_COUNT };
+
+class RaceWorld {
+private:
+    Broadphase mBroadphase;
+
+    // phase 2 scratch, kept between ticks
+    std::vector<OrientedBox> mBoxA, mBoxB;
+    std::vector<Contact> mContacts;
+    std::vector<ContactDelta> mDeltas;
+    std::vector<unsigned char> mTouched;
+    std::vector<int> mNearby;
+
+    // wheel positions of the cars that moved, for one batched surface lookup
+    std::vector<int> mSampled;
+    std::vector<Vector2> mWheelPos;
+    std::vector<unsigned char> mWheelSurfaces;
+
+    // level of detail
+    bool mHasFocus = false;
+    Vector2 mFocus;
+    float mFocusRadius;
+    unsigned int mTick = 0;
+    std::vector<unsigned char> mTier;
+    std::vector<float> mSkipped;    // time since a coarse car last stepped
+    std::vector<float> mStepDt;     // this tick's step, 0 for none
+    int mTierCount[SIM_TIER_COUNT] = {};
+
+    PropPool *mProps = nullptr;
+    float mDt = 0.0f;
+
+    void collectCarContacts();
+    void collectPropContacts();
+    void touch(int index);
+    void updateTiers(float dt);
+    bool isCrowded(int index);
+    void updateDraft();
+    void sampleSurfaces(Map *map);
+    float draftBehind(int leader, Vector2 pos) const;
+
+public:
+    explicit RaceWorld(float cellSize = 450.0f);
+
+    // index of the car in the broadphase
+    int add(Car *car);
+    void clear();
+
+    // props the cars can knock about, or nullptr for none
+    void setProps(PropPool *props) { mProps = props; }
+
+    // the whole tick, on the calling thread
+    void step(float dt, Map *map);
+
+    // the phases on their own, for callers spreading phase 1 over threads:
+    // beginStep, then stepCars over every car, then resolveContacts
+    void beginStep(float dt);
+    void stepCars(int begin, int end, Map *map);
+    void resolveContacts(Map *map);
+
+    // Cars further than radius from centre, with nobody near them, go
+    // coarse from the next beginStep. Without a focus every car runs full
+    void setFocus(Vector2 centre, float radius);
+    void clearFocus() { mHasFocus = false; }
+
+    // as of the last beginStep
+    SimTier getTier(int index) const { return (SimTier) mTier[index]; }
+    int getTierCount(SimTier tier) const { return mTierCount[tier]; }
+
+    // Fills the cars, tiers and props of out; false if there are more
+    // cars or props than a RaceState holds. restore() takes a state saved
+    // from this field
+    bool save(RaceState *out) const;
+    void restore(const RaceState &in);
+
+    int getCount() const { return mBroadphase.getCount(); }
+    Car* getCar(int index) const { return mBroadphase.getCar(index); }
+    const Broadphase& getBroadphase() const { return mBroadphase; }
+};
+
+#endif // RACEWORLD_H
@@ -1,13 +1,15 @@
 #ifndef SCENE_H
 #define SCENE_H
 
-#include "car.h"
+#include "RaceCar.h"
+#include "TrackMap.h"
+#include "RaceWorld.h"
 
 struct GameState
 {
     Car* player;
     std::vector<Car>* AI;
-    Map* map;
+    TrackMap* map;
 
     Music bgm1;
     Music bgm2;
@@ -21,6 +23,13 @@ struct GameState
 
     int nextSceneID;
     int gameMode;
+
+    // ticks since initialise() and the hash of every car after the last one
+    uint64_t tick;
+    uint64_t stateHash;
+
+    // cars in each RaceWorld tier on the last tick
+    int tierCounts[SIM_TIER_COUNT];
 };
 
 class Scene 
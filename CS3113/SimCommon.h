@@ -0,0 +1,40 @@
+#ifndef SIMCOMMON_H
+#define SIMCOMMON_H
+
+/*
+    Types shared by the simulation core (car physics and map queries).
+
+    The sim core is built into libugp_sim with UGP_HEADLESS defined so it
+    never needs a window, GL context or the raylib library. In that build
+    the few raylib value types it uses are declared here instead, laid out
+    exactly as raylib declares them so the game can link the same objects.
+*/
+
+#ifdef UGP_HEADLESS
+
+#ifndef PI
+    #define PI 3.14159265358979323846f
+#endif
+#ifndef DEG2RAD
+    #define DEG2RAD (PI/180.0f)
+#endif
+#ifndef RAD2DEG
+    #define RAD2DEG (180.0f/PI)
+#endif
+
+// Vector2, 2 components
+typedef struct Vector2 {
+    float x;                // Vector x component
+    float y;                // Vector y component
+} Vector2;
+
+#else
+
+#include "raylib.h"
+
+#endif // UGP_HEADLESS
+
+#include <cmath>
+#include <vector>
+
+#endif // SIMCOMMON_H
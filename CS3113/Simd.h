@@ -0,0 +1,151 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/*
+    Minimal float lane type for batched kernels. The widest instruction set
+    the compiler targets is picked at build time: AVX runs 8 lanes, SSE2
+    runs 4, anything else falls back to one plain float per "lane", so a
+    kernel is written once against FloatLanes and LaneMask.
+*/
+
+#include <cmath>
+
+#if defined(__AVX__)
+
+#include <immintrin.h>
+#define UGP_SIMD_WIDTH 8
+
+struct FloatLanes { __m256 v; };
+struct LaneMask   { __m256 v; };
+
+inline FloatLanes lanesSet(float x)          { return { _mm256_set1_ps(x) }; }
+inline FloatLanes lanesLoad(const float *p)  { return { _mm256_loadu_ps(p) }; }
+inline void lanesStore(float *p, FloatLanes a) { _mm256_storeu_ps(p, a.v); }
+
+// p[0], p[stride], p[2 * stride], ... one float per lane
+inline FloatLanes lanesGather(const float *p, int stride) {
+    return { _mm256_set_ps(p[7 * stride], p[6 * stride], p[5 * stride], p[4 * stride],
+                           p[3 * stride], p[2 * stride], p[stride], p[0]) };
+}
+
+inline FloatLanes operator+(FloatLanes a, FloatLanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline FloatLanes operator-(FloatLanes a, FloatLanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline FloatLanes operator*(FloatLanes a, FloatLanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline FloatLanes operator/(FloatLanes a, FloatLanes b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline FloatLanes operator-(FloatLanes a) { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) }; }
+
+inline LaneMask operator<(FloatLanes a, FloatLanes b)  { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline LaneMask operator>(FloatLanes a, FloatLanes b)  { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline LaneMask operator>=(FloatLanes a, FloatLanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline LaneMask operator==(FloatLanes a, FloatLanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+inline LaneMask operator&(LaneMask a, LaneMask b) { return { _mm256_and_ps(a.v, b.v) }; }
+inline LaneMask operator|(LaneMask a, LaneMask b) { return { _mm256_or_ps(a.v, b.v) }; }
+
+inline FloatLanes lanesMin(FloatLanes a, FloatLanes b)  { return { _mm256_min_ps(a.v, b.v) }; }
+inline FloatLanes lanesMax(FloatLanes a, FloatLanes b)  { return { _mm256_max_ps(a.v, b.v) }; }
+inline FloatLanes lanesSqrt(FloatLanes a)               { return { _mm256_sqrt_ps(a.v) }; }
+inline FloatLanes lanesAbs(FloatLanes a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+inline FloatLanes lanesFloor(FloatLanes a)              { return { _mm256_floor_ps(a.v) }; }
+
+// hardware estimate, about 12 bits
+inline FloatLanes lanesRsqrtEstimate(FloatLanes a)      { return { _mm256_rsqrt_ps(a.v) }; }
+
+// mask ? a : b
+inline FloatLanes lanesSelect(LaneMask m, FloatLanes a, FloatLanes b)
+    { return { _mm256_blendv_ps(b.v, a.v, m.v) }; }
+
+inline bool lanesAll(LaneMask m) { return _mm256_movemask_ps(m.v) == 0xff; }
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+#include <emmintrin.h>
+#define UGP_SIMD_WIDTH 4
+
+struct FloatLanes { __m128 v; };
+struct LaneMask   { __m128 v; };
+
+inline FloatLanes lanesSet(float x)          { return { _mm_set1_ps(x) }; }
+inline FloatLanes lanesLoad(const float *p)  { return { _mm_loadu_ps(p) }; }
+inline void lanesStore(float *p, FloatLanes a) { _mm_storeu_ps(p, a.v); }
+
+// p[0], p[stride], p[2 * stride], p[3 * stride]
+inline FloatLanes lanesGather(const float *p, int stride)
+    { return { _mm_set_ps(p[3 * stride], p[2 * stride], p[stride], p[0]) }; }
+
+inline FloatLanes operator+(FloatLanes a, FloatLanes b) { return { _mm_add_ps(a.v, b.v) }; }
+inline FloatLanes operator-(FloatLanes a, FloatLanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline FloatLanes operator*(FloatLanes a, FloatLanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline FloatLanes operator/(FloatLanes a, FloatLanes b) { return { _mm_div_ps(a.v, b.v) }; }
+inline FloatLanes operator-(FloatLanes a) { return { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; }
+
+inline LaneMask operator<(FloatLanes a, FloatLanes b)  { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline LaneMask operator>(FloatLanes a, FloatLanes b)  { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline LaneMask operator>=(FloatLanes a, FloatLanes b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline LaneMask operator==(FloatLanes a, FloatLanes b) { return { _mm_cmpeq_ps(a.v, b.v) }; }
+inline LaneMask operator&(LaneMask a, LaneMask b) { return { _mm_and_ps(a.v, b.v) }; }
+inline LaneMask operator|(LaneMask a, LaneMask b) { return { _mm_or_ps(a.v, b.v) }; }
+
+inline FloatLanes lanesMin(FloatLanes a, FloatLanes b)  { return { _mm_min_ps(a.v, b.v) }; }
+inline FloatLanes lanesMax(FloatLanes a, FloatLanes b)  { return { _mm_max_ps(a.v, b.v) }; }
+inline FloatLanes lanesSqrt(FloatLanes a)               { return { _mm_sqrt_ps(a.v) }; }
+inline FloatLanes lanesAbs(FloatLanes a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+
+// SSE2 has no floor: truncate, then step down where that rounded up
+inline FloatLanes lanesFloor(FloatLanes a) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return { _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f))) };
+}
+
+// hardware estimate, about 12 bits
+inline FloatLanes lanesRsqrtEstimate(FloatLanes a)      { return { _mm_rsqrt_ps(a.v) }; }
+
+// mask ? a : b (SSE2 has no blend, so and/andnot/or)
+inline FloatLanes lanesSelect(LaneMask m, FloatLanes a, FloatLanes b)
+    { return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) }; }
+
+inline bool lanesAll(LaneMask m) { return _mm_movemask_ps(m.v) == 0xf; }
+
+#else
+
+#define UGP_SIMD_WIDTH 1
+
+struct FloatLanes { float v; };
+struct LaneMask   { bool v; };
+
+inline FloatLanes lanesSet(float x)          { return { x }; }
+inline FloatLanes lanesLoad(const float *p)  { return { *p }; }
+inline void lanesStore(float *p, FloatLanes a) { *p = a.v; }
+inline FloatLanes lanesGather(const float *p, int)  { return { *p }; }
+
+inline FloatLanes operator+(FloatLanes a, FloatLanes b) { return { a.v + b.v }; }
+inline FloatLanes operator-(FloatLanes a, FloatLanes b) { return { a.v - b.v }; }
+inline FloatLanes operator*(FloatLanes a, FloatLanes b) { return { a.v * b.v }; }
+inline FloatLanes operator/(FloatLanes a, FloatLanes b) { return { a.v / b.v }; }
+inline FloatLanes operator-(FloatLanes a) { return { -a.v }; }
+
+inline LaneMask operator<(FloatLanes a, FloatLanes b)  { return { a.v < b.v }; }
+inline LaneMask operator>(FloatLanes a, FloatLanes b)  { return { a.v > b.v }; }
+inline LaneMask operator>=(FloatLanes a, FloatLanes b) { return { a.v >= b.v }; }
+inline LaneMask operator==(FloatLanes a, FloatLanes b) { return { a.v == b.v }; }
+inline LaneMask operator&(LaneMask a, LaneMask b) { return { a.v && b.v }; }
+inline LaneMask operator|(LaneMask a, LaneMask b) { return { a.v || b.v }; }
+
+inline FloatLanes lanesMin(FloatLanes a, FloatLanes b)  { return { a.v < b.v ? a.v : b.v }; }
+inline FloatLanes lanesMax(FloatLanes a, FloatLanes b)  { return { a.v > b.v ? a.v : b.v }; }
+inline FloatLanes lanesSqrt(FloatLanes a)               { return { std::sqrt(a.v) }; }
+inline FloatLanes lanesAbs(FloatLanes a)                { return { std::fabs(a.v) }; }
+inline FloatLanes lanesFloor(FloatLanes a)              { return { std::floor(a.v) }; }
+inline FloatLanes lanesRsqrtEstimate(FloatLanes a)      { return { 1.0f / std::sqrt(a.v) }; }
+
+inline FloatLanes lanesSelect(LaneMask m, FloatLanes a, FloatLanes b)
+    { return { m.v ? a.v : b.v }; }
+
+inline bool lanesAll(LaneMask m) { return m.v; }
+
+#endif
+
+// clamp a to [-limit, limit], limit >= 0
+inline FloatLanes lanesClamp(FloatLanes a, FloatLanes limit)
+    { return lanesMax(lanesMin(a, limit), -limit); }
+
+#endif // SIMD_H
@@ -0,0 +1,40 @@
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+/*
+    64-bit FNV-1a over the raw bits of sim state. Every tick folds in the
+    tick number and each car, so two runs fed the same inputs can be
+    compared hash for hash. Only meaningful across builds and machines in
+    a DETERMINISTIC=1 build; see FastMath.h.
+*/
+
+#include <cstdint>
+#include <cstring>
+
+const uint64_t STATE_HASH_SEED  = 14695981039346656037ull;
+const uint64_t STATE_HASH_PRIME = 1099511628211ull;
+
+inline uint64_t hashWord(uint64_t h, uint32_t word)
+{
+    for (int i = 0; i < 4; i++) {
+        h ^= (word >> (i * 8)) & 0xffu;
+        h *= STATE_HASH_PRIME;
+    }
+    return h;
+}
+
+// bit pattern, so -0 and +0 hash differently, as they should here
+inline uint64_t hashFloat(uint64_t h, float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return hashWord(h, bits);
+}
+
+inline uint64_t hashTick(uint64_t tick)
+{
+    uint64_t h = hashWord(STATE_HASH_SEED, (uint32_t) tick);
+    return hashWord(h, (uint32_t) (tick >> 32));
+}
+
+#endif // STATEHASH_H
@@ -0,0 +1,41 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+/*
+    What a car's tyres can be on, and what each surface does to them. Map
+    files every cell under one of these and Car scales its grip, throttle
+    and drag by the entry it reads, so a new surface is a row here rather
+    than another branch in the physics step.
+
+    Asphalt is exactly neutral: ones and zeroes leave the arithmetic as it
+    was before surfaces existed.
+*/
+
+enum SurfaceKind {
+    SURFACE_ASPHALT,
+    SURFACE_KERB,
+    SURFACE_GRASS,
+    SURFACE_GRAVEL,
+    SURFACE_OIL,
+    SURFACE_COUNT
+};
+
+struct SurfaceMaterial {
+    float frontGrip;    // multiplies the front axle's grip
+    float rearGrip;     // and the rear's
+    float traction;     // multiplies throttle, through the driven rear wheels
+    float rolling;      // multiplies rolling resistance
+    float scrub;        // extra share of velocity lost each tick (EULER)
+    float scrubRate;    // the same loss as a rate per second (RK2, RK4)
+};
+
+const SurfaceMaterial SURFACE_MATERIALS[SURFACE_COUNT] = {
+    //  front  rear   trac   roll   scrub   scrubRate
+    { 1.0f,  1.0f,  1.0f,  1.0f,  0.0f,   0.0f        },  // asphalt
+    { 0.9f,  0.9f,  0.95f, 1.5f,  0.0f,   0.0f        },  // kerb
+    { 0.2f,  0.6f,  0.5f,  1.0f,  0.001f, 0.06003002f },  // grass
+    { 0.35f, 0.45f, 0.4f,  4.0f,  0.003f, 0.18027041f },  // gravel
+    { 0.1f,  0.15f, 0.3f,  0.5f,  0.0f,   0.0f        },  // oil
+};
+
+#endif // SURFACE_H
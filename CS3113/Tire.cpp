@@ -0,0 +1,84 @@
+#include "Tire.h"
+#include "car.h"
+#include "FastMath.h"
+#include <deque>
+
+float pacejkaLateral(const CarProfile &profile, float slipAngle, float loadRatio)
+{
+    // above static load the tyre peaks lower and later, below it higher
+    // and sooner
+    float dLoad = loadRatio - 0.5f;
+    float peak  = 1.0f - profile.tireLoadSens * 2.0f * dLoad;
+    float b     = profile.tireB * (1.0f - 0.5f * dLoad);
+
+    float x = b * slipAngle;
+    return peak * simSin(profile.tireC *
+                         simAtan(x - profile.tireE * (x - simAtan(x))));
+}
+
+void TireTable::build(const CarProfile &profile)
+{
+    mB = profile.tireB;
+    mC = profile.tireC;
+    mE = profile.tireE;
+    mLoadSens = profile.tireLoadSens;
+
+    for (int j = 0; j <= TIRE_LOAD_BINS; j++) {
+        float loadRatio = (float) j / TIRE_LOAD_BINS;
+
+        for (int i = 0; i <= TIRE_SLIP_BINS; i++) {
+            float slipAngle = simAsin((float) i / TIRE_SLIP_BINS);
+            mValues[j * (TIRE_SLIP_BINS + 1) + i] =
+                pacejkaLateral(profile, slipAngle, loadRatio);
+        }
+    }
+
+    // Split the slip axis at the earliest peak of any load row. Before it
+    // every entry is at least mSlope * sinSlip, after it at least mFloor,
+    // and blending between entries keeps both bounds.
+    int knee = TIRE_SLIP_BINS;
+    for (int j = 0; j <= TIRE_LOAD_BINS; j++) {
+        const float *row = &mValues[j * (TIRE_SLIP_BINS + 1)];
+        int peak = 0;
+        for (int i = 1; i <= TIRE_SLIP_BINS; i++)
+            if (row[i] > row[peak]) peak = i;
+        if (peak < knee) knee = peak;
+    }
+    if (knee < 1) knee = 1;
+    int near = knee / 4 > 1 ? knee / 4 : 1;
+    mKnee = (float) knee / TIRE_SLIP_BINS;
+    mNear = (float) near / TIRE_SLIP_BINS;
+
+    mNearSlope = 1e30f;
+    mSlope = 1e30f;
+    mFloor = 1e30f;
+    for (int j = 0; j <= TIRE_LOAD_BINS; j++) {
+        const float *row = &mValues[j * (TIRE_SLIP_BINS + 1)];
+        for (int i = 1; i <= knee; i++) {
+            float slope = row[i] * TIRE_SLIP_BINS / i;
+            if (slope < mSlope) mSlope = slope;
+            if (i <= near && slope < mNearSlope) mNearSlope = slope;
+        }
+        for (int i = knee; i <= TIRE_SLIP_BINS; i++)
+            if (row[i] < mFloor) mFloor = row[i];
+    }
+}
+
+bool TireTable::builtFor(const CarProfile &profile) const
+{
+    return mB == profile.tireB && mC == profile.tireC &&
+           mE == profile.tireE && mLoadSens == profile.tireLoadSens;
+}
+
+const TireTable* TireTable::forProfile(const CarProfile &profile)
+{
+    // a deque never moves what it holds, so the pointers stay valid
+    static std::deque<TireTable> tables;
+
+    for (const TireTable &table : tables)
+        if (table.builtFor(profile)) return &table;
+
+    tables.push_back(TireTable());
+    tables.back().build(profile);
+    return &tables.back();
+}
@@ -0,0 +1,91 @@
+#ifndef TIRE_H
+#define TIRE_H
+
+#include "SimCommon.h"
+
+struct CarProfile;
+
+/*
+    Pacejka "magic formula" lateral tyre curve. It gives the share of the
+    tyre's grip available at a slip angle: rising almost linearly, peaking
+    near 8-10 degrees, then falling off as the tyre slides.
+
+    The formula costs two atans and a sin, so each profile's curve is baked
+    into a table over two axes:
+        slip   sin of the slip angle, 0 to 90 degrees. Physics gets it as
+               lateral slip / speed with no trig.
+        load   u = Fz / (Fz + Fz_static). Static load sits at 0.5, and the
+               heavy aero loads at speed squeeze towards 1 without a log.
+    lookup() blends the four surrounding entries.
+
+    Most ticks a tyre is well inside its limit, where the clamp can't bite
+    whatever the curve says. build() also finds a lower bound on the table,
+    slope * sinSlip up to the knee (the earliest peak) and floor past it,
+    and belowCurve() uses it to skip the lookup, and the divisions feeding
+    it, on those ticks. The curve is steepest near zero, so the first
+    quarter of the knee gets its own, steeper slope: small slips at speed
+    are the common case. Cars lapping the bench oval look up about one
+    axle in six; the rest cost three compares over the old linear clamp.
+*/
+
+const int TIRE_SLIP_BINS = 64;
+const int TIRE_LOAD_BINS = 8;
+
+// Direct formula, slipAngle in radians, loadRatio as u above
+float pacejkaLateral(const CarProfile &profile, float slipAngle, float loadRatio);
+
+class TireTable {
+private:
+    float mValues[(TIRE_LOAD_BINS + 1) * (TIRE_SLIP_BINS + 1)];
+    float mB, mC, mE, mLoadSens;
+    float mNearSlope, mNear;
+    float mSlope, mKnee, mFloor;
+
+public:
+    void build(const CarProfile &profile);
+    bool builtFor(const CarProfile &profile) const;
+
+    // One table per distinct curve, built on first use and shared by
+    // every car with that curve. The tables live until exit.
+    static const TireTable* forProfile(const CarProfile &profile);
+
+    float lookup(float sinSlip, float loadRatio) const;
+
+    // Whether cap * curve >= force for any slip angle the force could come
+    // from, where force = stiffness * slip and stiffSpeed = stiffness * speed
+    bool belowCurve(float force, float cap, float stiffSpeed) const {
+        return (force <= stiffSpeed * mNear && stiffSpeed <= cap * mNearSlope) ||
+               (force <= stiffSpeed * mKnee ? stiffSpeed <= cap * mSlope
+                                            : force <= cap * mFloor);
+    }
+
+    float getNearSlopeBound() const { return mNearSlope; }
+    float getNear()       const { return mNear; }
+    float getSlopeBound() const { return mSlope; }
+    float getKnee()       const { return mKnee; }
+    float getFloorBound() const { return mFloor; }
+};
+
+inline float TireTable::lookup(float sinSlip, float loadRatio) const
+{
+    // both inputs are >= 0, so truncation is floor
+    float x = sinSlip * TIRE_SLIP_BINS;
+    float y = loadRatio * TIRE_LOAD_BINS;
+    int i = (int) x;
+    int j = (int) y;
+    float fx = x - i;
+    float fy = y - j;
+
+    // past the last entry: hold the edge
+    if (i >= TIRE_SLIP_BINS) { i = TIRE_SLIP_BINS - 1; fx = 1.0f; }
+    if (j >= TIRE_LOAD_BINS) { j = TIRE_LOAD_BINS - 1; fy = 1.0f; }
+
+    const float *row0 = &mValues[j * (TIRE_SLIP_BINS + 1) + i];
+    const float *row1 = row0 + TIRE_SLIP_BINS + 1;
+
+    float a = row0[0] + (row0[1] - row0[0]) * fx;
+    float b = row1[0] + (row1[1] - row1[0]) * fx;
+    return a + (b - a) * fy;
+}
+
+#endif // TIRE_H
@@ -3,8 +3,19 @@
 
 #include <vector>
 
-constexpr int TRACK_WIDTH  = 40;
-constexpr int TRACK_HEIGHT = 30;
+// Holding R runs the race back REWIND_SPEED ticks a tick, as far as the
+// last REWIND_TICKS (ten seconds at 60 Hz)
+constexpr int REWIND_TICKS = 600;
+constexpr int REWIND_SPEED = 2;
+
+// A hotlap counts while any of the car is on the track: its centre may be
+// up to half its width past the edge
+constexpr float TRACK_LIMIT = 30.0f;
+
+// AI looks AI_EDGE_LOOKAHEAD ahead of the car and, once that point is
+// within AI_EDGE_MARGIN of the edge, steers back along the edge field
+constexpr float AI_EDGE_LOOKAHEAD = 450.0f;
+constexpr float AI_EDGE_MARGIN    = 100.0f;
 
 struct Corner {
     std::vector<std::pair<int,int>> tiles;   // (row, col) pairs for the corner
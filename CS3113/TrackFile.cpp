@@ -0,0 +1,231 @@
+#include "TrackFile.h"
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool TrackFile::open(const char *path)
+{
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(TrackFileHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // private and writable: writes land in this process's copy of a page
+    void *data = mmap(nullptr, (size_t) info.st_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+
+    mData = (unsigned char*) data;
+    mSize = (size_t) info.st_size;
+    mMapped = true;
+#else
+    FILE *file = std::fopen(path, "rb");
+    if (file == nullptr) return false;
+
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    if (size < (long) sizeof(TrackFileHeader))
+    {
+        std::fclose(file);
+        return false;
+    }
+
+    // vector storage is aligned well past the 4 bytes the records need
+    mBuffer.resize((size_t) size);
+    size_t read = std::fread(mBuffer.data(), 1, mBuffer.size(), file);
+    std::fclose(file);
+    if (read != mBuffer.size())
+    {
+        mBuffer.clear();
+        return false;
+    }
+
+    mData = mBuffer.data();
+    mSize = mBuffer.size();
+#endif
+
+    if (!validate())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void TrackFile::close()
+{
+#ifndef _WIN32
+    if (mMapped) munmap(mData, mSize);
+#endif
+    mData = nullptr;
+    mSize = 0;
+    mMapped = false;
+    mBuffer.clear();
+}
+
+// Only the header and section table are read; the sections themselves
+// stay on disk until something asks for them
+bool TrackFile::validate() const
+{
+    const TrackFileHeader *h = header();
+    if (h->magic != TRACK_FILE_MAGIC || h->version != TRACK_FILE_VERSION) return false;
+
+    uint64_t tableEnd = sizeof(TrackFileHeader) + (uint64_t) h->sectionCount * sizeof(TrackSection);
+    if (tableEnd > mSize) return false;
+
+    const TrackSection *sections = (const TrackSection*) (mData + sizeof(TrackFileHeader));
+    for (uint32_t i = 0; i < h->sectionCount; i++)
+    {
+        const TrackSection &s = sections[i];
+        if (s.offset % TRACK_FILE_ALIGN != 0) return false;
+        if (s.offset < tableEnd || s.size > mSize || s.offset > mSize - s.size) return false;
+
+        size_t record = 0;
+        switch (s.kind)
+        {
+            case TRACK_SECTION_TILES:        record = sizeof(uint32_t);        break;
+            case TRACK_SECTION_OBJECTS:      record = sizeof(TrackFileObject); break;
+            case TRACK_SECTION_CORNERS:      record = sizeof(TrackFileCorner); break;
+            case TRACK_SECTION_CORNER_TILES: record = sizeof(TrackFileCell);   break;
+            case TRACK_SECTION_RACING_LINE:  record = sizeof(TrackFileCell);   break;
+            case TRACK_SECTION_GRID:         record = sizeof(TrackFileSpawn);  break;
+            default: continue;      // a section a later version added
+        }
+        if (s.size != (uint64_t) s.count * record) return false;
+    }
+
+    const TrackSection *tiles = findSection(TRACK_SECTION_TILES);
+    if (tiles == nullptr ||
+        tiles->count != (uint64_t) h->columns * h->rows * h->layers) return false;
+
+    // corners must point inside the corner tiles
+    int cornerCount, tileCount;
+    const TrackFileCorner *corners = getCorners(&cornerCount);
+    getCornerTiles(&tileCount);
+    for (int i = 0; i < cornerCount; i++)
+        if ((uint64_t) corners[i].firstTile + corners[i].tileCount > (uint64_t) tileCount)
+            return false;
+
+    return true;
+}
+
+const TrackSection* TrackFile::findSection(uint32_t kind) const
+{
+    const TrackSection *sections = (const TrackSection*) (mData + sizeof(TrackFileHeader));
+    for (uint32_t i = 0; i < header()->sectionCount; i++)
+        if (sections[i].kind == kind) return &sections[i];
+    return nullptr;
+}
+
+template <class T>
+T* TrackFile::getSection(uint32_t kind, int *count) const
+{
+    const TrackSection *section = isOpen() ? findSection(kind) : nullptr;
+    if (section == nullptr)
+    {
+        *count = 0;
+        return nullptr;
+    }
+    *count = (int) section->count;
+    return (T*) (mData + section->offset);
+}
+
+unsigned int* TrackFile::getTiles(int layer) const
+{
+    int count;
+    unsigned int *tiles = getSection<unsigned int>(TRACK_SECTION_TILES, &count);
+    if (tiles == nullptr || layer < 0 || layer >= getLayerCount()) return nullptr;
+    return tiles + (size_t) layer * getColumns() * getRows();
+}
+
+const TrackFileObject* TrackFile::getObjects(int *count) const
+{
+    return getSection<const TrackFileObject>(TRACK_SECTION_OBJECTS, count);
+}
+
+const TrackFileCorner* TrackFile::getCorners(int *count) const
+{
+    return getSection<const TrackFileCorner>(TRACK_SECTION_CORNERS, count);
+}
+
+const TrackFileCell* TrackFile::getCornerTiles(int *count) const
+{
+    return getSection<const TrackFileCell>(TRACK_SECTION_CORNER_TILES, count);
+}
+
+const TrackFileCell* TrackFile::getRacingLine(int *count) const
+{
+    return getSection<const TrackFileCell>(TRACK_SECTION_RACING_LINE, count);
+}
+
+const TrackFileSpawn* TrackFile::getGrid(int *count) const
+{
+    return getSection<const TrackFileSpawn>(TRACK_SECTION_GRID, count);
+}
+
+// Header, table, then each section padded out to the next boundary
+bool writeTrackFile(const char *path, const TrackDescription &track)
+{
+    struct Pending {
+        uint32_t kind;
+        uint32_t count;
+        const void *data;
+        size_t size;
+    };
+    Pending pending[] = {
+        { TRACK_SECTION_TILES,        (uint32_t) track.tiles.size(),       track.tiles.data(),       track.tiles.size()       * sizeof(uint32_t) },
+        { TRACK_SECTION_OBJECTS,      (uint32_t) track.objects.size(),     track.objects.data(),     track.objects.size()     * sizeof(TrackFileObject) },
+        { TRACK_SECTION_CORNERS,      (uint32_t) track.corners.size(),     track.corners.data(),     track.corners.size()     * sizeof(TrackFileCorner) },
+        { TRACK_SECTION_CORNER_TILES, (uint32_t) track.cornerTiles.size(), track.cornerTiles.data(), track.cornerTiles.size() * sizeof(TrackFileCell) },
+        { TRACK_SECTION_RACING_LINE,  (uint32_t) track.racingLine.size(),  track.racingLine.data(),  track.racingLine.size()  * sizeof(TrackFileCell) },
+        { TRACK_SECTION_GRID,         (uint32_t) track.grid.size(),        track.grid.data(),        track.grid.size()        * sizeof(TrackFileSpawn) },
+    };
+    const uint32_t sectionCount = sizeof(pending) / sizeof(pending[0]);
+
+    size_t cells = (size_t) track.columns * track.rows;
+    if (cells == 0 || track.tiles.size() % cells != 0) return false;
+
+    TrackFileHeader header = {};
+    header.magic        = TRACK_FILE_MAGIC;
+    header.version      = TRACK_FILE_VERSION;
+    header.columns      = (uint32_t) track.columns;
+    header.rows         = (uint32_t) track.rows;
+    header.layers       = (uint32_t) (track.tiles.size() / cells);
+    header.sectionCount = sectionCount;
+
+    std::vector<unsigned char> out(sizeof(TrackFileHeader) + sectionCount * sizeof(TrackSection), 0);
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    for (uint32_t i = 0; i < sectionCount; i++)
+    {
+        out.resize((out.size() + TRACK_FILE_ALIGN - 1) / TRACK_FILE_ALIGN * TRACK_FILE_ALIGN, 0);
+
+        TrackSection section = { pending[i].kind, pending[i].count, out.size(), pending[i].size };
+        std::memcpy(out.data() + sizeof(TrackFileHeader) + i * sizeof(TrackSection),
+                    &section, sizeof(section));
+
+        const unsigned char *bytes = (const unsigned char*) pending[i].data;
+        out.insert(out.end(), bytes, bytes + pending[i].size);
+    }
+
+    FILE *file = std::fopen(path, "wb");
+    if (file == nullptr) return false;
+    bool written = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    return std::fclose(file) == 0 && written;
+}
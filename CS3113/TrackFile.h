@@ -0,0 +1,152 @@
+#ifndef TRACKFILE_H
+#define TRACKFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+    A track on disk (.ugpt): the tile layers, the multi-tile objects, the
+    corners lap counting checks, the AI's racing line and the starting
+    grid. A header, a table of sections, then the sections, each starting
+    on a TRACK_FILE_ALIGN boundary and laid out exactly as the structs
+    below (little-endian), so nothing is parsed: TrackFile maps the file
+    and hands out pointers into it, and the OS reads a page in only when
+    something first touches it. tools/track_convert.cpp writes them from
+    CSV or Tiled exports.
+
+    Bump TRACK_FILE_VERSION whenever a struct here changes.
+*/
+
+const uint32_t TRACK_FILE_MAGIC   = 0x54504755;    // "UGPT"
+const uint32_t TRACK_FILE_VERSION = 1;
+const uint32_t TRACK_FILE_ALIGN   = 16;
+
+enum TrackSectionKind : uint32_t {
+    TRACK_SECTION_TILES = 1,        // uint32_t per cell, layer after layer
+    TRACK_SECTION_OBJECTS,          // TrackFileObject
+    TRACK_SECTION_CORNERS,          // TrackFileCorner
+    TRACK_SECTION_CORNER_TILES,     // TrackFileCell, the corners' tiles in turn
+    TRACK_SECTION_RACING_LINE,      // TrackFileCell, waypoint tiles in lap order
+    TRACK_SECTION_GRID              // TrackFileSpawn, the player's first
+};
+
+struct TrackFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t columns;
+    uint32_t rows;
+    uint32_t layers;
+    uint32_t sectionCount;          // TrackSections straight after this
+    uint32_t reserved[2];
+};
+
+struct TrackSection {
+    uint32_t kind;
+    uint32_t count;                 // records in it
+    uint64_t offset;                // from the start of the file
+    uint64_t size;                  // bytes, count records exactly
+};
+
+// What Map::registerMultiTileObject takes, plus the sprite for TrackMap
+struct TrackFileObject {
+    uint32_t tileID;
+    int32_t widthTiles;
+    int32_t heightTiles;
+    float offsetX, offsetY;
+    float scale;
+    float rotation;
+    char texture[100];              // path, NUL terminated
+};
+
+struct TrackFileCorner {
+    uint32_t firstTile;             // into TRACK_SECTION_CORNER_TILES
+    uint32_t tileCount;
+    float angle;
+    uint32_t reserved;
+};
+
+struct TrackFileCell {
+    int32_t col;
+    int32_t row;
+};
+
+// World offset from the map's centre, and heading in degrees
+struct TrackFileSpawn {
+    float x, y;
+    float angle;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(TrackFileHeader) == 32, "TrackFileHeader is a file format");
+static_assert(sizeof(TrackSection)    == 24, "TrackSection is a file format");
+static_assert(sizeof(TrackFileObject) == 128, "TrackFileObject is a file format");
+static_assert(sizeof(TrackFileCorner) == 16, "TrackFileCorner is a file format");
+static_assert(sizeof(TrackFileCell)   == 8,  "TrackFileCell is a file format");
+static_assert(sizeof(TrackFileSpawn)  == 16, "TrackFileSpawn is a file format");
+
+/*
+    An open .ugpt. open() checks the header and that every section lies
+    inside the file, aligned and of the size its count says, so the
+    getters after it just add offsets.
+
+    The mapping is private and copy-on-write: getTiles() can go straight
+    to a Map, whose setTileType changes only this process's copy of the
+    pages it writes. Where there is no mmap the file is read in whole.
+*/
+class TrackFile {
+private:
+    unsigned char *mData = nullptr;
+    size_t mSize = 0;
+    bool mMapped = false;
+    std::vector<unsigned char> mBuffer;     // without mmap
+
+    const TrackFileHeader* header() const { return (const TrackFileHeader*) mData; }
+    const TrackSection* findSection(uint32_t kind) const;
+    bool validate() const;
+
+    template <class T>
+    T* getSection(uint32_t kind, int *count) const;
+
+public:
+    TrackFile() {}
+    ~TrackFile() { close(); }
+    TrackFile(const TrackFile&) = delete;
+    TrackFile& operator=(const TrackFile&) = delete;
+
+    // False if the file can't be read or isn't a track of this version
+    bool open(const char *path);
+    void close();
+    bool isOpen() const { return mData != nullptr; }
+
+    int getColumns()    const { return isOpen() ? (int) header()->columns : 0; }
+    int getRows()       const { return isOpen() ? (int) header()->rows    : 0; }
+    int getLayerCount() const { return isOpen() ? (int) header()->layers  : 0; }
+
+    // columns * rows tile IDs, row by row
+    unsigned int* getTiles(int layer = 0) const;
+
+    // Each returns the first record and puts the count in count; nullptr
+    // and 0 for a track without that section
+    const TrackFileObject* getObjects(int *count) const;
+    const TrackFileCorner* getCorners(int *count) const;
+    const TrackFileCell*   getCornerTiles(int *count) const;
+    const TrackFileCell*   getRacingLine(int *count) const;
+    const TrackFileSpawn*  getGrid(int *count) const;
+};
+
+// Track as the converter builds it, written out in the layout above
+struct TrackDescription {
+    int columns = 0;
+    int rows = 0;
+    std::vector<uint32_t> tiles;                // layers * columns * rows
+    std::vector<TrackFileObject> objects;
+    std::vector<TrackFileCorner> corners;
+    std::vector<TrackFileCell> cornerTiles;
+    std::vector<TrackFileCell> racingLine;
+    std::vector<TrackFileSpawn> grid;
+};
+
+bool writeTrackFile(const char *path, const TrackDescription &track);
+
+#endif // TRACKFILE_H
@@ -0,0 +1,329 @@
+#include "TrackMap.h"
+#include <algorithm>
+
+TrackMap::TrackMap(int mapColumns, int mapRows, unsigned int *levelData,
+                   const char *textureFilePath, float tileSize, int textureColumns,
+                   int textureRows, Vector2 origin) :
+                   Map {mapColumns, mapRows, levelData, tileSize, origin},
+                   mTextureAtlas { LoadTexture(textureFilePath) },
+                   mTextureColumns {textureColumns}, mTextureRows {textureRows}
+                   { buildTextureAreas(); }
+
+TrackMap::~TrackMap()
+{
+    unloadChunks();
+    UnloadTexture(mTextureAtlas);
+
+    for (Texture2D &texture : mObjectTextures)
+        UnloadTexture(texture);
+
+    for (Texture2D &texture : mPropTextures)
+        if (texture.id != 0) UnloadTexture(texture);
+
+    for (Texture2D &texture : mSurfaceTextures)
+        if (texture.id != 0) UnloadTexture(texture);
+}
+
+void TrackMap::buildTextureAreas()
+{
+    // Precompute texture areas for each tile
+    for (int row = 0; row < mTextureRows; row++)
+    {
+        for (int col = 0; col < mTextureColumns; col++)
+        {
+            Rectangle textureArea = {
+                (float) col * (mTextureAtlas.width / mTextureColumns),
+                (float) row * (mTextureAtlas.height / mTextureRows),
+                (float) mTextureAtlas.width / mTextureColumns,
+                (float) mTextureAtlas.height / mTextureRows
+            };
+
+            mTextureAreas.push_back(textureArea);
+        }
+    }
+}
+
+// World-space bounds of what camera shows. The camera turns with the
+// car, so this is the box round the screen's four corners rotated back
+// into the world, the inverse of raylib's Camera2D transform
+void TrackMap::getViewBounds(const Camera2D &camera, Vector2 *min, Vector2 *max) const
+{
+    float angle = camera.rotation * DEG2RAD;
+    float c = cosf(angle);
+    float s = sinf(angle);
+
+    float width  = (float) GetScreenWidth();
+    float height = (float) GetScreenHeight();
+    const Vector2 corners[4] = { {0.0f, 0.0f}, {width, 0.0f}, {0.0f, height}, {width, height} };
+
+    for (int i = 0; i < 4; i++)
+    {
+        float dx = (corners[i].x - camera.offset.x) / camera.zoom;
+        float dy = (corners[i].y - camera.offset.y) / camera.zoom;
+        Vector2 world = {
+            camera.target.x + c * dx + s * dy,
+            camera.target.y - s * dx + c * dy
+        };
+
+        if (i == 0 || world.x < min->x) min->x = world.x;
+        if (i == 0 || world.y < min->y) min->y = world.y;
+        if (i == 0 || world.x > max->x) max->x = world.x;
+        if (i == 0 || world.y > max->y) max->y = world.y;
+    }
+}
+
+// Tiles into one render texture per chunk, at the atlas's own texel size,
+// and every object into a flat list of sprites in texture order
+void TrackMap::bake()
+{
+    unloadChunks();
+    int texel = mTextureAtlas.width / mTextureColumns;
+
+    for (int chunkRow = 0; chunkRow < mMapRows; chunkRow += CHUNK_TILES)
+    {
+        for (int chunkCol = 0; chunkCol < mMapColumns; chunkCol += CHUNK_TILES)
+        {
+            int cols = std::min(CHUNK_TILES, mMapColumns - chunkCol);
+            int rows = std::min(CHUNK_TILES, mMapRows - chunkRow);
+
+            MapChunk chunk;
+            chunk.area = {
+                mLeftBoundary + chunkCol * mTileSize,
+                mTopBoundary  + chunkRow * mTileSize,
+                cols * mTileSize,
+                rows * mTileSize
+            };
+            chunk.target = LoadRenderTexture(cols * texel, rows * texel);
+
+            BeginTextureMode(chunk.target);
+            ClearBackground(BLANK);
+
+            bool empty = true;
+            for (int row = 0; row < rows; row++)
+            {
+                for (int col = 0; col < cols; col++)
+                {
+                    int tile = mLevelData[(chunkRow + row) * mMapColumns + chunkCol + col];
+
+                    // grass is the background colour, objects are sprites
+                    if (!(mTileTraits[tile].flags & TILE_DRIVABLE)) continue;
+
+                    DrawTexturePro(
+                        mTextureAtlas,
+                        mTextureAreas[tile - 1], // -1 because tile indices start at 1
+                        { (float) (col * texel), (float) (row * texel), (float) texel, (float) texel },
+                        {0.0f, 0.0f},
+                        0.0f,
+                        WHITE
+                    );
+                    empty = false;
+                }
+            }
+
+            // patches such as oil are painted over the tiles they lie on
+            for (const SurfacePatch &patch : mSurfacePatches)
+            {
+                const Texture2D &texture = mSurfaceTextures[patch.surface];
+                int col = patch.cell % mMapColumns - chunkCol;
+                int row = patch.cell / mMapColumns - chunkRow;
+                if (texture.id == 0 || col < 0 || row < 0 || col >= cols || row >= rows)
+                    continue;
+
+                DrawTexturePro(
+                    texture,
+                    { 0.0f, 0.0f, (float) texture.width, (float) texture.height },
+                    { (float) (col * texel), (float) (row * texel), (float) texel, (float) texel },
+                    {0.0f, 0.0f},
+                    0.0f,
+                    WHITE
+                );
+                empty = false;
+            }
+            EndTextureMode();
+
+            // all grass: nothing to draw
+            if (empty)
+            {
+                UnloadRenderTexture(chunk.target);
+                continue;
+            }
+            mChunks.push_back(chunk);
+        }
+    }
+
+    bakeObjects();
+}
+
+void TrackMap::bakeObjects()
+{
+    mObjectSprites.clear();
+
+    for (int row = 0; row < mMapRows; row++)
+    {
+        for (int col = 0; col < mMapColumns; col++)
+        {
+            const TileTraits &traits = mTileTraits[mLevelData[row * mMapColumns + col]];
+
+            if (traits.object < 0)
+                continue;
+
+            const MultiTileObject &obj = mObjects[traits.object];
+            const Texture2D &texture = mObjectTextures[traits.object];
+
+            // Position of TOP-LEFT in world space
+            float px = mLeftBoundary + col * mTileSize + obj.offset.x;
+            float py = mTopBoundary  + row * mTileSize + obj.offset.y;
+
+            // World size of the object (what matters)
+            float worldW = obj.widthTiles  * mTileSize;
+            float worldH = obj.heightTiles * mTileSize;
+
+            // Calculate origin point based on rotation so that top-left
+            // of rotated sprite ends up at (px, py)
+            Vector2 origin;
+
+            if (fabs(obj.rotation) < 0.1f) {
+                // 0 degrees: top-left stays top-left
+                origin = { 0.0f, 0.0f };
+            }
+            else if (fabs(obj.rotation - 90.0f) < 0.1f) {
+                // 90 degrees: top-left becomes bottom-left
+                origin = { 0.0f, worldH };
+            }
+            else if (fabs(obj.rotation - 180.0f) < 0.1f) {
+                // 180 degrees: top-left becomes bottom-right
+                origin = { worldW, worldH };
+            }
+            else if (fabs(obj.rotation - 270.0f) < 0.1f || fabs(obj.rotation + 90.0f) < 0.1f) {
+                // 270 degrees: top-left becomes top-right
+                origin = { worldW, 0.0f };
+            }
+            else {
+                // General case for arbitrary rotations
+                origin = { 0.0f, 0.0f };
+            }
+
+            // whatever the rotation, the sprite stays within its own
+            // width plus height of (px, py)
+            float reach = worldW + worldH;
+
+            ObjectSprite sprite;
+            sprite.texture  = texture;
+            sprite.src      = { 0.0f, 0.0f, (float) texture.width, (float) texture.height };
+            sprite.dst      = { px, py, worldW, worldH };
+            sprite.origin   = origin;
+            sprite.rotation = obj.rotation;
+            sprite.min      = { px - reach, py - reach };
+            sprite.max      = { px + reach, py + reach };
+            mObjectSprites.push_back(sprite);
+        }
+    }
+
+    // one texture after another, so raylib's batch isn't broken by
+    // switching back and forth
+    std::stable_sort(mObjectSprites.begin(), mObjectSprites.end(),
+        [](const ObjectSprite &a, const ObjectSprite &b) { return a.texture.id < b.texture.id; });
+}
+
+void TrackMap::unloadChunks()
+{
+    for (MapChunk &chunk : mChunks)
+        UnloadRenderTexture(chunk.target);
+    mChunks.clear();
+}
+
+void TrackMap::render(const Camera2D &camera)
+{
+    Vector2 viewMin, viewMax;
+    getViewBounds(camera, &viewMin, &viewMax);
+
+    for (const MapChunk &chunk : mChunks)
+    {
+        const Rectangle &area = chunk.area;
+        if (area.x > viewMax.x || area.x + area.width  < viewMin.x ||
+            area.y > viewMax.y || area.y + area.height < viewMin.y)
+            continue;
+
+        // render textures come out upside down, hence the negative height
+        const Texture2D &texture = chunk.target.texture;
+        DrawTexturePro(
+            texture,
+            { 0.0f, 0.0f, (float) texture.width, -(float) texture.height },
+            area,
+            {0.0f, 0.0f},
+            0.0f,
+            WHITE
+        );
+    }
+
+    for (const ObjectSprite &sprite : mObjectSprites)
+    {
+        if (sprite.min.x > viewMax.x || sprite.max.x < viewMin.x ||
+            sprite.min.y > viewMax.y || sprite.max.y < viewMin.y)
+            continue;
+
+        DrawTexturePro(sprite.texture, sprite.src, sprite.dst,
+                       sprite.origin, sprite.rotation, WHITE);
+    }
+}
+
+void TrackMap::registerMultiTileObject(
+    int tileID,
+    const char* texturePath,
+    int widthTiles,
+    int heightTiles,
+    Vector2 offset,
+    float scale,
+    float rotation
+)
+{
+    int index = Map::registerMultiTileObject(tileID, widthTiles, heightTiles,
+                                             offset, scale, rotation);
+
+    // a tile ID registered again keeps its index
+    if (index < (int) mObjectTextures.size())
+        UnloadTexture(mObjectTextures[index]);
+    else
+        mObjectTextures.resize(index + 1);
+
+    mObjectTextures[index] = LoadTexture(texturePath);
+}
+
+void TrackMap::registerPropTexture(PropKind kind, const char *texturePath)
+{
+    if (mPropTextures[kind].id != 0)
+        UnloadTexture(mPropTextures[kind]);
+
+    mPropTextures[kind] = LoadTexture(texturePath);
+}
+
+void TrackMap::registerSurfaceTexture(SurfaceKind surface, const char *texturePath)
+{
+    if (mSurfaceTextures[surface].id != 0)
+        UnloadTexture(mSurfaceTextures[surface]);
+
+    mSurfaceTextures[surface] = LoadTexture(texturePath);
+}
+
+void TrackMap::renderProps(const PropPool &props)
+{
+    for (int i = 0; i < props.size(); i++)
+    {
+        const Texture2D &texture = mPropTextures[props.getKind(i)];
+        if (texture.id == 0) continue;
+
+        // the sprite's width spans the prop, centred on it
+        float width  = props.getRadius(i) * 2.0f;
+        float height = width * texture.height / texture.width;
+        Vector2 pos  = props.getPosition(i);
+
+        DrawTexturePro(
+            texture,
+            { 0.0f, 0.0f, (float) texture.width, (float) texture.height },
+            { pos.x, pos.y, width, height },
+            { width / 2.0f, height / 2.0f },
+            props.getAngle(i),
+            WHITE
+        );
+    }
+}
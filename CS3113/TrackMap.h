@@ -0,0 +1,94 @@
+#ifndef TRACKMAP_H
+#define TRACKMAP_H
+
+#include "cs3113.h"
+#include "Map.h"
+#include "PropPool.h"
+
+/*
+    Renderable map: the headless Map plus the tile atlas, the sprites for
+    each registered multi-tile object, and a sprite per kind of prop.
+
+    The tiles never change once the track is set up, so bake() draws them
+    once into a render texture per CHUNK_TILES square chunk, and lists the
+    objects as ready-made sprites sorted by texture. A frame then draws
+    the chunks and sprites in view: a handful of quads, not every tile.
+*/
+
+// Tiles along each side of a baked chunk
+constexpr int CHUNK_TILES = 8;
+
+struct MapChunk {
+    RenderTexture2D target;
+    Rectangle area;         // world space
+};
+
+// A multi-tile object as DrawTexturePro wants it, with its world bounds
+struct ObjectSprite {
+    Texture2D texture;
+    Rectangle src;
+    Rectangle dst;
+    Vector2 origin;
+    float rotation;
+    Vector2 min, max;
+};
+
+class TrackMap : public Map
+{
+private:
+    Texture2D mTextureAtlas;  // texture atlas
+
+    int mTextureColumns; // number of columns in texture atlas
+    int mTextureRows;    // number of rows in texture atlas
+
+    std::vector<Rectangle> mTextureAreas; // texture areas for each tile
+
+    std::vector<Texture2D> mObjectTextures;             // by object index
+    Texture2D mPropTextures[PROP_KIND_COUNT] = {};      // id 0 until loaded
+    Texture2D mSurfaceTextures[SURFACE_COUNT] = {};     // for surface patches
+
+    // chunks with nothing but grass are left out
+    std::vector<MapChunk> mChunks;
+    std::vector<ObjectSprite> mObjectSprites;
+
+    void buildTextureAreas();
+    void bakeObjects();
+    void unloadChunks();
+    void getViewBounds(const Camera2D &camera, Vector2 *min, Vector2 *max) const;
+
+public:
+    TrackMap(int mapColumns, int mapRows, unsigned int *levelData,
+        const char *textureFilePath, float tileSize, int textureColumns,
+        int textureRows, Vector2 origin);
+    ~TrackMap();
+
+    // Bakes the tiles and objects for render(). Call once the objects are
+    // registered, outside BeginDrawing: render textures reset the camera
+    void bake();
+
+    // Draws only the chunks and objects camera can see, so the cost
+    // follows the screen rather than the size of the map
+    void render(const Camera2D &camera);
+    void renderProps(const PropPool &props);
+
+    Texture2D     getTextureAtlas()   const { return mTextureAtlas;   };
+    int           getTextureColumns() const { return mTextureColumns; };
+    int           getTextureRows()    const { return mTextureRows;    };
+
+    void registerMultiTileObject(
+        int tileID,
+        const char* texturePath,
+        int widthTiles,
+        int heightTiles,
+        Vector2 offset = {0,0},
+        float scale = 1.0f,
+        float rotation = 0.0f
+    );
+
+    void registerPropTexture(PropKind kind, const char *texturePath);
+
+    // Drawn over each cell patched with surface, baked in with the tiles
+    void registerSurfaceTexture(SurfaceKind surface, const char *texturePath);
+};
+
+#endif
@@ -1,80 +1,94 @@
 #include "car.h"
+#include "FastMath.h"
 #include <cmath>
 
+// The EULER step's per-tick factors as rates per second, so the RK
+// integrators reproduce it at any timestep. Each is -ln(factor) * 60.
+const float DAMPING_RATE   = 0.12012016f;  // velocity *= 0.998 per tick
+const float STIFFNESS_RATE = 9.75113574f;  // 15% of tyre slip removed per tick
+
+// share of the closing speed two cars bounce apart with
+const float CAR_RESTITUTION = 0.3f;
+
+// share of the aero drag a car deep in a slipstream no longer feels
+const float DRAFT_DRAG_CUT = 0.35f;
+
+// Contact patches, inset from the corners of the car's box
+const float WHEEL_BASE_INSET  = 0.7f;   // axles' share of the half length
+const float WHEEL_TRACK_INSET = 0.8f;   // wheels' share of the half width
+
 Car::Car(Vector2 startPos,
          Vector2 scale,
-         const char* texturePath,
          CarProfile profile) {
     mPos = startPos;
     mScale = scale;
-    mAngle = 0.0f;
+    mHeading = 0.0f;
 
-    mSpeed = 0.0f;
     mVelocityAngle = 0.0f;
     mSteerAngle = 0.0f;
 
     mVel = {0.0f, 0.0f};
 
-    mTexture = LoadTexture(texturePath);
+    mFrame.speed = 0.0f;
+    mFrame.speedSq = 0.0f;
+    updateHeadingFrame();
+    updateWheelFrame();
+
     mProfile = profile;
+    mTires = TireTable::forProfile(profile);
+    mDerived = deriveProfile(profile);
+    mDragCoeff = profile.dragCoeff;
 }
 
-Car::~Car() {
-    UnloadTexture(mTexture);
-}
+Car::~Car() {}
 
 void Car::updateGrip() {
-    float g = 9.81f;
-
-    float speed = mSpeed;
-
-    mGrip.aeroFront = mProfile.frontAero * (speed * speed);
-    mGrip.aeroRear  = mProfile.rearAero  * (speed * speed);
+    const DerivedProfile &d = mDerived;
 
-    mGrip.loadFront = mProfile.weightDistrib * mProfile.mass * g + mGrip.aeroFront;
-    mGrip.loadRear  = (1.0f - mProfile.weightDistrib) * mProfile.mass * g + mGrip.aeroRear;
+    mGrip.aeroFront = d.frontAero * mFrame.speedSq;
+    mGrip.aeroRear  = d.rearAero  * mFrame.speedSq;
 
-    float mu = mProfile.tireMu;
+    mGrip.loadFront = d.staticLoadFront + mGrip.aeroFront;
+    mGrip.loadRear  = d.staticLoadRear  + mGrip.aeroRear;
 
-    mGrip.effectiveFrontGrip = mu * mGrip.loadFront;
-    mGrip.effectiveRearGrip  = mu * mGrip.loadRear;
+    mGrip.effectiveFrontGrip = d.tireMu * mGrip.loadFront;
+    mGrip.effectiveRearGrip  = d.tireMu * mGrip.loadRear;
 }
 
 void Car::accelerate(float dt, Map* map) {
-    float accel = (mProfile.horsepower * 1500.0f) / mProfile.mass;
+    float accel = mDerived.accel;
 
-    int tileID = map->getTileAtWorldPos(mPos);
-    if (tileID == 0) {
-        //grass penalty
-        accel *= 0.5f;
-    }
-
-    float rad = mAngle * DEG2RAD;
-    Vector2 forward = { std::cos(rad), std::sin(rad) };
+    sampleSurface(map);
+    accel *= mSurface.traction;
 
-    mVel.x += forward.x * accel * dt;
-    mVel.y += forward.y * accel * dt;
+    mVel.x += mFrame.forward.x * accel * dt;
+    mVel.y += mFrame.forward.y * accel * dt;
 }
 
 
 void Car::reverse(float dt) {
-    float accel = (mProfile.horsepower * 730.0f) / mProfile.mass * 0.3f;
+    float accel = mDerived.reverseAccel;
 
-    float rad = mAngle * DEG2RAD;
-    Vector2 forward = { std::cos(rad), std::sin(rad) };
+    mVel.x -= mFrame.forward.x * accel * dt;
+    mVel.y -= mFrame.forward.y * accel * dt;
+}
 
-    mVel.x -= forward.x * accel * dt;
-    mVel.y -= forward.y * accel * dt;
+// The car ahead has already got the air moving, so a follower pushes
+// through less of it. Only aero drag drops; the tyres roll as before.
+void Car::applyDraft() {
+    mDragCoeff = mDerived.dragCoeff * (1.0f - DRAFT_DRAG_CUT * mDraft);
 }
 
 void Car::applyDrag(float dt) {
-    float speed = mSpeed;
+    const DerivedProfile &d = mDerived;
+
+    float speed = mFrame.speed;
     if (speed <= 0.0f) return;
 
-    float drag = mProfile.dragCoeff * speed * speed;
-    float roll = mProfile.rollingCoeff * speed;
+    float drag = mDragCoeff * mFrame.speedSq;
+    float roll = d.rollingCoeff * mSurface.rolling * speed;
 
-    float decel = (drag + roll) / mProfile.mass;
+    float decel = (drag + roll) * d.invMass;
 
     float newSpeed = speed - decel * dt;
     if (newSpeed < 0) newSpeed = 0;
@@ -84,93 +98,293 @@ void Car::applyDrag(float dt) {
         mVel.x *= scale;
         mVel.y *= scale;
     }
+
+    // the scale above sets |vel| to newSpeed, no need to measure it again
+    mFrame.speed = newSpeed;
+    mFrame.speedSq = newSpeed * newSpeed;
 }
 
 void Car::applySteering(float dt) {
     // return steering to center when no input
-    if (!IsKeyDown(KEY_A) && !IsKeyDown(KEY_D)) {
+    if (!mSteerInput) {
         if (mSteerAngle > 0)        mSteerAngle -= mSteerReturnSpeed * dt;
         else if (mSteerAngle < 0)   mSteerAngle += mSteerReturnSpeed * dt;
 
         if (std::fabs(mSteerAngle) < 0.2f)
             mSteerAngle = 0;
     }
+    mSteerInput = false;
 
-    if (mSpeed < 0.1f) return;
+    // the RK integrators turn the car along with the velocity
+    if (mIntegrator != EULER) return;
 
-    // get car orientation
-    float rad = mAngle * DEG2RAD;
-    Vector2 carForward = { std::cos(rad), std::sin(rad) };
+    if (mFrame.speed < 0.1f) return;
 
-    // calculate front wheel direction
-    float frontWheelAngle = rad + (mSteerAngle * DEG2RAD);
-    Vector2 frontWheelDir = { std::cos(frontWheelAngle), std::sin(frontWheelAngle) };
     float steerRad = mSteerAngle * DEG2RAD;
 
     if (std::abs(steerRad) > 0.01f) {
-        float angVel = (mSpeed * std::sin(steerRad)) / mProfile.turnRadius;
-        mAngle += angVel * RAD2DEG * dt;
+        float sinSteer, cosSteer;
+        simSinCos(steerRad, &sinSteer, &cosSteer);
+
+        float angVel = (mFrame.speed * sinSteer) / mDerived.turnRadius;
+        // kept in [-pi, pi) so trig arguments never grow lap after lap
+        mHeading = wrapRadians(mHeading + angVel * dt);
+        updateHeadingFrame();
     }
 }
 
 void Car::applyFriction(float dt) {
+    const DerivedProfile &d = mDerived;
+
     //  damping
     float frictionFactor = 0.998f;
     mVel.x *= frictionFactor;
     mVel.y *= frictionFactor;
 
-    if (mSpeed < 0.1f) return;
+    if (mFrame.speed < 0.1f) return;
 
-    float rad = mAngle * DEG2RAD;
-    Vector2 carForward = { std::cos(rad), std::sin(rad) };
-    Vector2 carLateral = { -carForward.y, carForward.x };
+    const Vector2 &carLateral = mFrame.lateral;
+    const Vector2 &frontLateral = mFrame.wheelLateral;
 
-    float velForward = mVel.x * carForward.x + mVel.y * carForward.y;
     float velLateral = mVel.x * carLateral.x + mVel.y * carLateral.y;
 
     // front wheels
-    float frontWheelAngle = rad + (mSteerAngle * DEG2RAD);
-    Vector2 frontDir = { std::cos(frontWheelAngle), std::sin(frontWheelAngle) };
-    Vector2 frontLateral = { -frontDir.y, frontDir.x };
 
     float frontSlipVel = mVel.x * frontLateral.x + mVel.y * frontLateral.y;
 
     // rear wheels
     float rearSlipVel = velLateral;
 
-    float frontMaxGrip = (mGrip.effectiveFrontGrip / mProfile.mass) * dt * 5.0f;
-    float rearMaxGrip = (mGrip.effectiveRearGrip / mProfile.mass) * dt * 5.0f;
-
     const float tireStiffness = 0.15f;  // how much tires resist slip
 
     float frontForce = -frontSlipVel * tireStiffness;
-    if (std::abs(frontForce) > frontMaxGrip) {
-        frontForce = std::copysign(frontMaxGrip, frontForce);
+    float rearForce = -rearSlipVel * tireStiffness;
+
+    // clamp to the grip the tyre curve leaves at this slip angle and load,
+    // only looked up when the tyre could be near its limit
+    float gripWindow = d.invMass * dt * 5.0f;
+    float stiffSpeed = mFrame.speed * tireStiffness;
+
+    float frontMaxGrip = mGrip.effectiveFrontGrip * gripWindow;
+    if (!mTires->belowCurve(std::fabs(frontForce), frontMaxGrip, stiffSpeed)) {
+        frontMaxGrip *= mTires->lookup(std::fabs(frontSlipVel) / mFrame.speed,
+                                      mGrip.loadFront / (mGrip.loadFront + d.staticLoadFront));
+        if (std::abs(frontForce) > frontMaxGrip)
+            frontForce = std::copysign(frontMaxGrip, frontForce);
     }
 
-    float rearForce = -rearSlipVel * tireStiffness;
-    if (std::abs(rearForce) > rearMaxGrip) {
-        rearForce = std::copysign(rearMaxGrip, rearForce);
+    float rearMaxGrip = mGrip.effectiveRearGrip * gripWindow;
+    if (!mTires->belowCurve(std::fabs(rearForce), rearMaxGrip, stiffSpeed)) {
+        rearMaxGrip *= mTires->lookup(std::fabs(rearSlipVel) / mFrame.speed,
+                                     mGrip.loadRear / (mGrip.loadRear + d.staticLoadRear));
+        if (std::abs(rearForce) > rearMaxGrip)
+            rearForce = std::copysign(rearMaxGrip, rearForce);
     }
 
     // apply forces in lateral directions
-    mVel.x += frontLateral.x * frontForce * mProfile.weightDistrib;
-    mVel.y += frontLateral.y * frontForce * mProfile.weightDistrib;
+    mVel.x += frontLateral.x * frontForce * d.frontShare;
+    mVel.y += frontLateral.y * frontForce * d.frontShare;
 
-    mVel.x += carLateral.x * rearForce * (1.0f - mProfile.weightDistrib);
-    mVel.y += carLateral.y * rearForce * (1.0f - mProfile.weightDistrib);
+    mVel.x += carLateral.x * rearForce * d.rearShare;
+    mVel.y += carLateral.y * rearForce * d.rearShare;
 }
 
 void Car::handleSpeed() {
-    mSpeed = std::sqrt(mVel.x*mVel.x + mVel.y*mVel.y);
+    mFrame.speedSq = mVel.x*mVel.x + mVel.y*mVel.y;
+    mFrame.speed = simSqrt(mFrame.speedSq);
+}
 
+void Car::updateHeadingFrame() {
+    simSinCos(mHeading, &mFrame.forward.y, &mFrame.forward.x);
+    mFrame.lateral = { -mFrame.forward.y, mFrame.forward.x };
 }
 
-float Car::getForwardSpeed() const{
-    float rad = mAngle * DEG2RAD;
-    Vector2 carForward = { std::cos(rad), std::sin(rad)};
+void Car::updateWheelFrame() {
+    // wheels straight ahead need no trig
+    if (mSteerAngle == 0.0f) {
+        mFrame.wheelForward = mFrame.forward;
+        mFrame.wheelLateral = mFrame.lateral;
+        return;
+    }
+
+    // rotate the heading by the steer angle
+    float steerRad = mSteerAngle * DEG2RAD;
+    float c, s;
+    simSinCos(steerRad, &s, &c);
+
+    mFrame.wheelForward = {
+        mFrame.forward.x * c - mFrame.forward.y * s,
+        mFrame.forward.y * c + mFrame.forward.x * s
+    };
+    mFrame.wheelLateral = { -mFrame.wheelForward.y, mFrame.wheelForward.x };
+}
+
+// The forces applyFriction, applySurfaceScrub and applyDrag apply, summed
+// as accelerations for a car moving at vel with the given heading.
+CarRates Car::evaluateRates(Vector2 vel, float heading, float sinSteer,
+                            float cosSteer) const {
+    CarRates rates = { { 0.0f, 0.0f }, 0.0f };
+
+    float speedSq = vel.x * vel.x + vel.y * vel.y;
+    float speed = simSqrt(speedSq);
+
+    float damping = DAMPING_RATE + mSurface.scrubRate;
+    rates.accel.x = -vel.x * damping;
+    rates.accel.y = -vel.y * damping;
+
+    if (speed < 0.1f) return rates;
 
-    return mVel.x * carForward.x + mVel.y * carForward.y;
+    Vector2 forward, wheel;
+    simSinCos(heading, &forward.y, &forward.x);
+    wheel.x = forward.x * cosSteer - forward.y * sinSteer;
+    wheel.y = forward.y * cosSteer + forward.x * sinSteer;
+
+    Vector2 lateral      = { -forward.y, forward.x };
+    Vector2 wheelLateral = { -wheel.y, wheel.x };
+
+    // tyre grip, as in updateGrip
+    const DerivedProfile &d = mDerived;
+    float loadFront = d.staticLoadFront + d.frontAero * speedSq;
+    float loadRear  = d.staticLoadRear  + d.rearAero * speedSq;
+
+    float frontGrip = d.tireMu * loadFront;
+    float rearGrip  = d.tireMu * loadRear;
+    frontGrip *= mSurface.frontGrip;
+    rearGrip  *= mSurface.rearGrip;
+
+    float frontSlip = vel.x * wheelLateral.x + vel.y * wheelLateral.y;
+    float rearSlip  = vel.x * lateral.x + vel.y * lateral.y;
+
+    float frontAccel = -frontSlip * STIFFNESS_RATE;
+    float rearAccel  = -rearSlip * STIFFNESS_RATE;
+
+    // tyre curve clamp, as in applyFriction
+    float stiffSpeed = speed * STIFFNESS_RATE;
+
+    float frontMax = frontGrip * d.invMass * 5.0f;
+    if (!mTires->belowCurve(std::fabs(frontAccel), frontMax, stiffSpeed)) {
+        frontMax *= mTires->lookup(std::fabs(frontSlip) / speed, loadFront / (loadFront + d.staticLoadFront));
+        if (std::fabs(frontAccel) > frontMax) frontAccel = std::copysign(frontMax, frontAccel);
+    }
+
+    float rearMax = rearGrip * d.invMass * 5.0f;
+    if (!mTires->belowCurve(std::fabs(rearAccel), rearMax, stiffSpeed)) {
+        rearMax *= mTires->lookup(std::fabs(rearSlip) / speed, loadRear / (loadRear + d.staticLoadRear));
+        if (std::fabs(rearAccel) > rearMax) rearAccel = std::copysign(rearMax, rearAccel);
+    }
+
+    frontAccel *= d.frontShare;
+    rearAccel  *= d.rearShare;
+
+    rates.accel.x += wheelLateral.x * frontAccel + lateral.x * rearAccel;
+    rates.accel.y += wheelLateral.y * frontAccel + lateral.y * rearAccel;
+
+    // aero drag and rolling resistance, along the velocity
+    float drag = (mDragCoeff * speed + d.rollingCoeff * mSurface.rolling) * d.invMass;
+    rates.accel.x -= vel.x * drag;
+    rates.accel.y -= vel.y * drag;
+
+    rates.turnRate = (speed * sinSteer) / d.turnRadius;
+
+    return rates;
+}
+
+// RK2 (midpoint) or RK4 step of velocity and heading. The steer angle and
+// surface are held for the tick; position follows in update() from the
+// new velocity, as it does for EULER.
+void Car::integrate(float dt, Map *map) {
+    handleTurn();
+    updateWheelFrame();
+    updateGrip();
+
+    sampleSurface(map);
+    mGrip.effectiveFrontGrip *= mSurface.frontGrip;
+    mGrip.effectiveRearGrip  *= mSurface.rearGrip;
+
+    // same dead zone as applySteering
+    float steerRad = mSteerAngle * DEG2RAD;
+    float sinSteer = 0.0f, cosSteer = 1.0f;
+    if (std::fabs(steerRad) > 0.01f)
+        simSinCos(steerRad, &sinSteer, &cosSteer);
+
+    Vector2 v0 = mVel;
+    float h0 = mHeading;
+
+    CarRates k1 = evaluateRates(v0, h0, sinSteer, cosSteer);
+
+    if (mIntegrator == RK2) {
+        float half = dt * 0.5f;
+        Vector2 vMid = { v0.x + k1.accel.x * half, v0.y + k1.accel.y * half };
+        CarRates k2 = evaluateRates(vMid, h0 + k1.turnRate * half, sinSteer, cosSteer);
+
+        mVel.x   = v0.x + k2.accel.x * dt;
+        mVel.y   = v0.y + k2.accel.y * dt;
+        mHeading = h0 + k2.turnRate * dt;
+    } else {
+        float half = dt * 0.5f;
+        Vector2 v2 = { v0.x + k1.accel.x * half, v0.y + k1.accel.y * half };
+        CarRates k2 = evaluateRates(v2, h0 + k1.turnRate * half, sinSteer, cosSteer);
+
+        Vector2 v3 = { v0.x + k2.accel.x * half, v0.y + k2.accel.y * half };
+        CarRates k3 = evaluateRates(v3, h0 + k2.turnRate * half, sinSteer, cosSteer);
+
+        Vector2 v4 = { v0.x + k3.accel.x * dt, v0.y + k3.accel.y * dt };
+        CarRates k4 = evaluateRates(v4, h0 + k3.turnRate * dt, sinSteer, cosSteer);
+
+        float sixth = dt / 6.0f;
+        mVel.x   = v0.x + (k1.accel.x + 2.0f * (k2.accel.x + k3.accel.x) + k4.accel.x) * sixth;
+        mVel.y   = v0.y + (k1.accel.y + 2.0f * (k2.accel.y + k3.accel.y) + k4.accel.y) * sixth;
+        mHeading = h0 + (k1.turnRate + 2.0f * (k2.turnRate + k3.turnRate) + k4.turnRate) * sixth;
+    }
+
+    mHeading = wrapRadians(mHeading);
+    updateHeadingFrame();
+    handleSpeed();
+}
+
+uint64_t Car::hashState(uint64_t h) const {
+    h = hashFloat(h, mPos.x);
+    h = hashFloat(h, mPos.y);
+    h = hashFloat(h, mVel.x);
+    h = hashFloat(h, mVel.y);
+    h = hashFloat(h, mHeading);
+    h = hashFloat(h, mSteerAngle);
+    h = hashFloat(h, mFrame.speed);
+    return hashWord(h, mSteerInput ? 1u : 0u);
+}
+
+void Car::saveState(CarState *out) const {
+    out->pos = mPos;
+    out->vel = mVel;
+    out->heading = mHeading;
+    out->velocityAngle = mVelocityAngle;
+    out->steerAngle = mSteerAngle;
+    out->draft = mDraft;
+    out->dragCoeff = mDragCoeff;
+    out->frame = mFrame;
+    out->grip = mGrip;
+    out->surface = mSurface;
+    out->steerInput = mSteerInput;
+    out->surfaceStale = mSurfaceStale;
+}
+
+void Car::restoreState(const CarState &in) {
+    mPos = in.pos;
+    mVel = in.vel;
+    mHeading = in.heading;
+    mVelocityAngle = in.velocityAngle;
+    mSteerAngle = in.steerAngle;
+    mDraft = in.draft;
+    mDragCoeff = in.dragCoeff;
+    mFrame = in.frame;
+    mGrip = in.grip;
+    mSurface = in.surface;
+    mSteerInput = in.steerInput;
+    mSurfaceStale = in.surfaceStale;
+}
+
+float Car::getForwardSpeed() const{
+    return mVel.x * mFrame.forward.x + mVel.y * mFrame.forward.y;
 }
 
 void Car::handleTurn() {
@@ -180,34 +394,30 @@ void Car::handleTurn() {
 
 
 void Car::brake(float dt) {
-    float speed = mSpeed;
+    float speed = mFrame.speed;
     if (speed <= 0.1f) {
         mVel.x = 0;
         mVel.y = 0;
-        mSpeed = 0;
+        mFrame.speed = 0;
+        mFrame.speedSq = 0;
         return;
     }
 
-    float g = 9.81f;
+    const DerivedProfile &d = mDerived;
 
-    float aeroFront = mProfile.frontAero * (speed * speed);
-    float aeroRear  = mProfile.rearAero  * (speed * speed);
-
-    float loadFront = mProfile.weightDistrib * mProfile.mass * g + aeroFront;
-    float loadRear  = (1.0f - mProfile.weightDistrib) * mProfile.mass * g + aeroRear;
+    float loadFront = d.staticLoadFront + d.frontAero * mFrame.speedSq;
+    float loadRear  = d.staticLoadRear  + d.rearAero  * mFrame.speedSq;
 
     // max brake force
-    float maxBrakeForce = mProfile.tireMu * (loadFront + loadRear);
+    float maxBrakeForce = d.tireMu * (loadFront + loadRear);
 
-    float brakeForce = mProfile.brake;
-    if (brakeForce > maxBrakeForce) {
-        brakeForce = maxBrakeForce;
+    // the brakes alone, unless the tyres can't take it
+    float decel_units = d.brakeDecel;
+    if (mProfile.brake > maxBrakeForce) {
+        float decel_ms2 = maxBrakeForce / mProfile.mass;
+        decel_units = decel_ms2 * MS_TO_GAME_UNITS;
     }
 
-    float decel_ms2 = brakeForce / mProfile.mass;
-    const float MS_TO_GAME_UNITS = 36.0f;
-    float decel_units = decel_ms2 * MS_TO_GAME_UNITS;
-
     float brakeReduction = decel_units * dt;
 
     if (brakeReduction >= speed) {
@@ -222,42 +432,107 @@ void Car::brake(float dt) {
 
 void Car::turnleft(float dt) {
     mSteerAngle -= mSteerSpeed * dt;
+    mSteerInput = true;
 }
 
 void Car::turnright(float dt) {
     mSteerAngle += mSteerSpeed * dt;
+    mSteerInput = true;
 }
 
 void Car::update(float dt, Map *map, const std::vector<Car*> &cars) {
-    // update speed for physics
-    handleSpeed();
-    updateGrip();
-    applyGrassPenalty(map);
-    applyFriction(dt);
+    step(dt, map);
+    resolveCarContacts(cars, map);
+}
 
-    // reupdate for drag
+void Car::step(float dt, Map *map) {
+    // speed from the velocity this tick's controls left us,
+    // wheel basis from the steer they set
     handleSpeed();
-    applyDrag(dt);
+    applyDraft();
+
+    if (mIntegrator == EULER) {
+        updateWheelFrame();
+        updateGrip();
+        sampleSurface(map);
+        applySurfaceScrub();
+        applyFriction(dt);
+
+        // friction changed the lateral velocity, reupdate for drag
+        handleSpeed();
+        applyDrag(dt);
+    } else {
+        integrate(dt, map);
+    }
 
-    // update position and check collisions
-    mPos.x += mVel.x * dt;
-    checkCollisionX(cars);
-    checkCollisionX(map);
+    // update position and check collisions. Only a car whose swept box
+    // reaches an object this tick pays for the sweeps and sub-steps
+    Vector2 velBeforeContact = mVel;
 
-    mPos.y += mVel.y * dt;
-    checkCollisionY(cars);
-    checkCollisionY(map);
+    int substeps = countSubsteps(dt, map);
+    bool sweep = substeps > 0;
+    if (!sweep) substeps = 1;
+    float subDt = dt / substeps;
+
+    for (int i = 0; i < substeps; i++) {
+        float fromX = mPos.x;
+        mPos.x += mVel.x * subDt;
+        checkCollisionX(map, sweep ? fromX : mPos.x);
+
+        float fromY = mPos.y;
+        mPos.y += mVel.y * subDt;
+        checkCollisionY(map, sweep ? fromY : mPos.y);
+    }
+
+    // only a wall stopping an axis changes speed after drag
+    if (mVel.x != velBeforeContact.x || mVel.y != velBeforeContact.y)
+        handleSpeed();
 
-    // update speed for steering
-    handleSpeed();
     handleTurn();
     applySteering(dt);
+    mSurfaceStale = true;
+}
+
+// 0 when the car's swept box this tick reaches no object. Otherwise each
+// sub-step moves at most half the car's short side, so the x-then-y moves
+// stay close to the straight path; the sweeps in checkCollisionX/Y stop
+// tunnelling whatever the count.
+int Car::countSubsteps(float dt, Map *map) const
+{
+    if (map == nullptr) return 0;
+
+    float dx = mVel.x * dt;
+    float dy = mVel.y * dt;
+
+    Vector2 half = { mScale.x / 2.0f, mScale.y / 2.0f };
+    Vector2 sweptMin = { mPos.x + std::fmin(dx, 0.0f) - half.x, mPos.y + std::fmin(dy, 0.0f) - half.y };
+    Vector2 sweptMax = { mPos.x + std::fmax(dx, 0.0f) + half.x, mPos.y + std::fmax(dy, 0.0f) + half.y };
+
+    if (!map->touchesSolid(sweptMin, sweptMax)) return 0;
+
+    float travel  = std::fmax(fabs(dx), fabs(dy));
+    float maxMove = std::fmin(half.x, half.y);
+    int substeps  = (int) ceil(travel / maxMove);
+
+    if (substeps < 1) substeps = 1;
+    if (substeps > mMaxSubsteps) substeps = mMaxSubsteps;
+    return substeps;
 }
 
-void Car::checkCollisionY(Map *map)
+void Car::checkCollisionY(Map *map, float fromY)
 {
     if (map == nullptr) return;
 
+    // continuous pass: stop at the first object the move would cross
+    float hitY;
+    Vector2 from = { mPos.x, fromY };
+    if (map->sweepSolidY(from, { mScale.x / 2.0f, mScale.y / 2.0f }, mPos.y, &hitY))
+    {
+        mPos.y = hitY;
+        mVel.y = 0.0f;
+        return;
+    }
+
     Vector2 topCentreProbe    = { mPos.x, mPos.y - (mScale.y / 2.0f) };
     Vector2 topLeftProbe      = { mPos.x - (mScale.x / 2.0f), mPos.y - (mScale.y / 2.0f) };
     Vector2 topRightProbe     = { mPos.x + (mScale.x / 2.0f), mPos.y - (mScale.y / 2.0f) };
@@ -290,10 +565,20 @@ void Car::checkCollisionY(Map *map)
     }
 }
 
-void Car::checkCollisionX(Map *map)
+void Car::checkCollisionX(Map *map, float fromX)
 {
     if (map == nullptr) return;
 
+    // continuous pass: stop at the first object the move would cross
+    float hitX;
+    Vector2 from = { fromX, mPos.y };
+    if (map->sweepSolidX(from, { mScale.x / 2.0f, mScale.y / 2.0f }, mPos.x, &hitX))
+    {
+        mPos.x = hitX;
+        mVel.x = 0.0f;
+        return;
+    }
+
     Vector2 leftCentreProbe   = { mPos.x - (mScale.x / 2.0f), mPos.y };
     Vector2 leftTopProbe      = { mPos.x - (mScale.x / 2.0f), mPos.y - (mScale.y / 2.0f) };
     Vector2 leftBottomProbe   = { mPos.x - (mScale.x / 2.0f), mPos.y + (mScale.y / 2.0f) };
@@ -326,99 +611,145 @@ void Car::checkCollisionX(Map *map)
     }
 }
 
-void Car::checkCollisionY(const std::vector<Car*> &cars)
+// Tests this car against the others a block of lanes at a time and
+// separates any it overlaps, one contact after another
+void Car::resolveCarContacts(const std::vector<Car*> &cars, Map *map)
 {
-    for (size_t i = 0; i < cars.size(); i++)
+    OrientedBox self[UGP_SIMD_WIDTH];
+    OrientedBox others[UGP_SIMD_WIDTH];
+    Car *partners[UGP_SIMD_WIDTH];
+    Contact contacts[UGP_SIMD_WIDTH];
+
+    size_t i = 0;
+    while (i < cars.size())
     {
-        Car *otherCar = cars[i];
+        OrientedBox box = getBox();
+        int count = 0;
 
-        if (isColliding(otherCar))
+        for (; i < cars.size() && count < UGP_SIMD_WIDTH; i++)
         {
-            float yDistance = fabs(mPos.y - otherCar->mPos.y);
-            float yOverlap  = fabs(yDistance - (mScale.y / 2.0f) - (otherCar->mScale.y / 2.0f));
-
-            if (mVel.y > 0.0f)
-            {
-                mPos.y -= yOverlap * 1.01f;
-            }
-            else if (mVel.y < 0.0f)
-            {
-                mPos.y += yOverlap * 1.01f;
-            }
+            if (cars[i] == this) continue;
+
+            self[count]     = box;
+            others[count]   = cars[i]->getBox();
+            partners[count] = cars[i];
+            count++;
         }
-    }
-}
 
-void Car::checkCollisionX(const std::vector<Car*> &cars)
-{
-    for (size_t i = 0; i < cars.size(); i++)
-    {
-        Car *otherCar = cars[i];
+        if (findContacts(self, others, count, contacts) == 0) continue;
 
-        if (isColliding(otherCar))
+        for (int k = 0; k < count; k++)
         {
-            float xDistance = fabs(mPos.x - otherCar->mPos.x);
-            float xOverlap  = fabs(xDistance - (mScale.x / 2.0f) - (otherCar->mScale.x / 2.0f));
-
-            if (mVel.x > 0.0f)
-            {
-                mPos.x -= xOverlap * 1.01f;
-            }
-            else if (mVel.x < 0.0f)
-            {
-                mPos.x += xOverlap * 1.01f;
-            }
+            if (contacts[k].depth <= 0.0f) continue;
+
+            ContactDelta mine = { { 0.0f, 0.0f }, { 0.0f, 0.0f } };
+            ContactDelta theirs = mine;
+            contactResponse(*partners[k], contacts[k], &mine, &theirs);
+            applyContact(mine, map);
+            partners[k]->applyContact(theirs, map);
         }
     }
 }
 
-bool Car::isColliding(Car *other) const
+// Pushes both cars apart along the contact normal, then exchanges momentum
+// along it. The lighter car gives way more in both.
+void Car::contactResponse(const Car &other, const Contact &contact,
+                          ContactDelta *self, ContactDelta *otherDelta) const
 {
-    if (other == this) return false;
-
-    float xDistance = fabs(mPos.x - other->getPosition().x) -
-        ((mScale.x + other->mScale.x) / 2.0f);
-    float yDistance = fabs(mPos.y - other->getPosition().y) -
-        ((mScale.y + other->mScale.y) / 2.0f);
-
-    if (xDistance < 0.0f && yDistance < 0.0f) return true;
+    const Vector2 &n = contact.normal;
+    float invMassSum = mDerived.invMass + other.mDerived.invMass;
+
+    float push = contact.depth * 1.01f / invMassSum;
+    self->push.x -= n.x * push * mDerived.invMass;
+    self->push.y -= n.y * push * mDerived.invMass;
+    otherDelta->push.x += n.x * push * other.mDerived.invMass;
+    otherDelta->push.y += n.y * push * other.mDerived.invMass;
+
+    // only cars closing on each other trade momentum
+    float closing = (other.mVel.x - mVel.x) * n.x + (other.mVel.y - mVel.y) * n.y;
+    if (closing >= 0.0f) return;
+
+    float impulse = -(1.0f + CAR_RESTITUTION) * closing / invMassSum;
+    self->impulse.x -= n.x * impulse * mDerived.invMass;
+    self->impulse.y -= n.y * impulse * mDerived.invMass;
+    otherDelta->impulse.x += n.x * impulse * other.mDerived.invMass;
+    otherDelta->impulse.y += n.y * impulse * other.mDerived.invMass;
+}
 
-    return false;
+void Car::applyContact(const ContactDelta &delta, Map *map)
+{
+    mPos.x += delta.push.x;
+    mPos.y += delta.push.y;
+    mVel.x += delta.impulse.x;
+    mVel.y += delta.impulse.y;
+
+    // walls have the last word: a car pushed into one is pushed back out
+    checkCollisionX(map, mPos.x);
+    checkCollisionY(map, mPos.y);
+    handleSpeed();
+    mSurfaceStale = true;
 }
 
 void Car::checkCollision(Map *map, const std::vector<Car*> &cars)
 {
-    checkCollisionX(cars);
-    checkCollisionX(map);
-
-    checkCollisionY(cars);
-    checkCollisionY(map);
+    resolveCarContacts(cars, map);
+    checkCollisionX(map, mPos.x);
+    checkCollisionY(map, mPos.y);
 }
 
-void Car::applyGrassPenalty(Map *map) {
-    //handle just grip portion
-    if (map == nullptr) return;
-    int tileID = map->getTileAtWorldPos(mPos);
+void Car::getWheelPositions(Vector2 *out) const {
+    const Vector2 &f = mFrame.forward;
+    const Vector2 &l = mFrame.lateral;
+    float along  = mScale.x * 0.5f * WHEEL_BASE_INSET;
+    float across = mScale.y * 0.5f * WHEEL_TRACK_INSET;
 
-    if (tileID == 0) {
-        mGrip.effectiveFrontGrip *= 0.2f;
-        mVel.x *= 0.999f;
-        mVel.y *= 0.999f;
-    }
+    Vector2 front = { mPos.x + f.x * along, mPos.y + f.y * along };
+    Vector2 rear  = { mPos.x - f.x * along, mPos.y - f.y * along };
+
+    out[WHEEL_FRONT_LEFT]  = { front.x - l.x * across, front.y - l.y * across };
+    out[WHEEL_FRONT_RIGHT] = { front.x + l.x * across, front.y + l.y * across };
+    out[WHEEL_REAR_LEFT]   = { rear.x - l.x * across,  rear.y - l.y * across };
+    out[WHEEL_REAR_RIGHT]  = { rear.x + l.x * across,  rear.y + l.y * across };
 }
 
-void Car::render()
-{
-    Rectangle src = {0,0,(float)mTexture.width,(float)mTexture.height};
+void Car::setWheelSurfaces(const unsigned char *surfaces) {
+    const SurfaceMaterial &fl = SURFACE_MATERIALS[surfaces[WHEEL_FRONT_LEFT]];
+    const SurfaceMaterial &fr = SURFACE_MATERIALS[surfaces[WHEEL_FRONT_RIGHT]];
+    const SurfaceMaterial &rl = SURFACE_MATERIALS[surfaces[WHEEL_REAR_LEFT]];
+    const SurfaceMaterial &rr = SURFACE_MATERIALS[surfaces[WHEEL_REAR_RIGHT]];
+
+    mSurface.frontGrip = (fl.frontGrip + fr.frontGrip) * 0.5f;
+    mSurface.rearGrip  = (rl.rearGrip + rr.rearGrip) * 0.5f;
+    mSurface.traction  = (rl.traction + rr.traction) * 0.5f;
+    mSurface.rolling   = (fl.rolling + fr.rolling + rl.rolling + rr.rolling) * 0.25f;
+    mSurface.scrub     = (fl.scrub + fr.scrub + rl.scrub + rr.scrub) * 0.25f;
+    mSurface.scrubRate = (fl.scrubRate + fr.scrubRate + rl.scrubRate + rr.scrubRate) * 0.25f;
+    mSurfaceStale = false;
+}
 
-    Rectangle dst = {
-        mPos.x,
-        mPos.y,
-        mScale.x,
-        mScale.y
-    };
+// Looks up the surface under the wheels unless it's still current.
+// Without a map it's all asphalt
+void Car::sampleSurface(Map *map) {
+    if (!mSurfaceStale) return;
+    if (map == nullptr) {
+        mSurface = SURFACE_NEUTRAL;
+        return;
+    }
+
+    Vector2 wheels[WHEEL_COUNT];
+    unsigned char surfaces[WHEEL_COUNT];
+    getWheelPositions(wheels);
+    map->getSurfacesAtWorldPos(wheels, WHEEL_COUNT, surfaces);
+    setWheelSurfaces(surfaces);
+}
 
-    Vector2 origin = { mScale.x*0.5f, mScale.y*0.5f };
+// Grip per axle, and whatever velocity the surface scrubs off each tick.
+// Asphalt scrubs nothing, and multiplying by one leaves it exact
+void Car::applySurfaceScrub() {
+    mGrip.effectiveFrontGrip *= mSurface.frontGrip;
+    mGrip.effectiveRearGrip  *= mSurface.rearGrip;
 
-    DrawTexturePro(mTexture, src, dst, origin, mAngle, WHITE);
+    float factor = 1.0f - mSurface.scrub;
+    mVel.x *= factor;
+    mVel.y *= factor;
 }
@@ -1,7 +1,10 @@
 #ifndef CAR_H
 #define CAR_H
 
-#include "map.h"
+#include "Map.h"
+#include "StateHash.h"
+#include "Tire.h"
+#include "Contact.h"
 
 struct CarProfile {
     float horsepower;       
@@ -14,8 +17,105 @@ struct CarProfile {
     float frontAero;
     float rearAero;
     float brake;
+
+    // Pacejka lateral curve, see Tire.h
+    float tireB;            // stiffness factor
+    float tireC;            // shape
+    float tireE;            // curvature
+    float tireLoadSens;     // share of peak grip lost from static to full load
+};
+
+/*
+    Everything the physics reads from a profile each tick, with the
+    products and quotients worked out once: a car derives its own when it
+    is built. deriveProfile is constexpr, so a built-in profile's can also
+    be had at compile time.
+*/
+struct DerivedProfile {
+    float invMass;
+    float accel;            // full throttle, horsepower * 1500 / mass
+    float reverseAccel;     // horsepower * 730 / mass * 0.3
+    float staticLoadFront;  // weightDistrib * mass * g
+    float staticLoadRear;
+    float frontShare;       // of the lateral grip force, weightDistrib
+    float rearShare;
+    float frontAero;
+    float rearAero;
+    float tireMu;
+    float dragCoeff;
+    float rollingCoeff;
+    float turnRadius;
+    float brakeDecel;       // game units / s^2 from the brakes alone
+};
+
+constexpr float MS_TO_GAME_UNITS = 36.0f;
+
+constexpr DerivedProfile deriveProfile(const CarProfile &p)
+{
+    return {
+        1.0f / p.mass,
+        (p.horsepower * 1500.0f) / p.mass,
+        (p.horsepower * 730.0f) / p.mass * 0.3f,
+        p.weightDistrib * p.mass * 9.81f,
+        (1.0f - p.weightDistrib) * p.mass * 9.81f,
+        p.weightDistrib,
+        1.0f - p.weightDistrib,
+        p.frontAero,
+        p.rearAero,
+        p.tireMu,
+        p.dragCoeff,
+        p.rollingCoeff,
+        p.turnRadius,
+        p.brake / p.mass * MS_TO_GAME_UNITS
+    };
+}
+
+/*
+    Everything the physics steps need about the car's orientation and speed,
+    worked out once and shared instead of each step redoing its own trig
+    and sqrt. The heading basis is refreshed only when the heading changes,
+    the wheel basis once per tick from the steer angle.
+*/
+struct KinematicFrame {
+    Vector2 forward;        // unit heading
+    Vector2 lateral;        // heading rotated +90 degrees
+    Vector2 wheelForward;   // front wheel direction
+    Vector2 wheelLateral;
+    float speed;
+    float speedSq;
+};
+
+// How Car::update advances velocity and heading. EULER is the original
+// split step (grip, friction, drag applied one after another) and is tuned
+// for 60 Hz. RK2/RK4 integrate the same forces as one continuous model,
+// so they hold together at 30 Hz: a lone car's best lap stays within
+// 0.15 s of the 60 Hz EULER car, where EULER itself drifts off
+// (ugp_bench integrators).
+enum Integrator { EULER, RK2, RK4 };
+
+// d(velocity)/dt and d(heading)/dt of the combined force model
+struct CarRates {
+    Vector2 accel;
+    float turnRate;
+};
+
+// The four contact patches, in the order getWheelPositions gives them
+enum Wheel { WHEEL_FRONT_LEFT, WHEEL_FRONT_RIGHT, WHEEL_REAR_LEFT, WHEEL_REAR_RIGHT, WHEEL_COUNT };
+
+// The SurfaceMaterial under the car, averaged over the wheels each term
+// acts through: grip per axle, traction over the driven rear wheels, the
+// rest over all four
+struct SurfaceInfo {
+    float frontGrip;
+    float rearGrip;
+    float traction;
+    float rolling;
+    float scrub;
+    float scrubRate;
 };
 
+const SurfaceInfo SURFACE_NEUTRAL = { 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f };
+
 struct GripInfo {
     float loadFront;
     float loadRear;
@@ -25,24 +125,58 @@ struct GripInfo {
     float effectiveRearGrip;
 };
 
+// Everything a car carries from one tick to the next, as plain data, for
+// RaceState snapshots. The profile, size and integrator stay put in a race
+struct CarState {
+    Vector2 pos;
+    Vector2 vel;
+    float heading;
+    float velocityAngle;
+    float steerAngle;
+    float draft;
+    float dragCoeff;
+    KinematicFrame frame;
+    GripInfo grip;
+    SurfaceInfo surface;
+    bool steerInput;
+    bool surfaceStale;
+};
+
 
+/*
+    Car physics. Headless: rendering lives in RaceCar, and steering input
+    arrives through turnleft/turnright rather than from the keyboard.
+*/
 class Car {
-private:
+protected:
     Vector2 mPos;
-    float mAngle;
-    float mSpeed;
+    float mHeading;         // radians
     float mVelocityAngle; 
     float mSteerAngle;      
     float mMaxSteer = 20.0f;  
     float mSteerSpeed = 20.0f; 
     float mSteerReturnSpeed = 20.0f; 
 
-    Texture2D mTexture;
+    bool mSteerInput = false; // steering held this tick
+    int mMaxSubsteps = 8;     // collision moves per tick near objects
+
+    Integrator mIntegrator = EULER;
+
     Vector2 mScale;  
     Vector2 mVel = {0.0f, 0.0f};     
 
     CarProfile mProfile;
+    DerivedProfile mDerived;
+    const TireTable *mTires;    // shared by cars with the same curve
     GripInfo mGrip;
+    float mDraft = 0.0f;      // 0..1, how deep in another car's slipstream
+    float mDragCoeff;         // profile drag, less what the draft takes off
+    KinematicFrame mFrame;
+
+    // what the wheels are on, from the tiles under them. Stale once the
+    // car moves; refreshed by the car itself or, batched, by RaceWorld
+    SurfaceInfo mSurface = SURFACE_NEUTRAL;
+    bool mSurfaceStale = true;
 
     void applyDrag(float dt);
     void applyDraft();
@@ -50,21 +184,26 @@ private:
     void applyFriction(float dt);
     void handleSpeed();
     void handleTurn();
+    void updateHeadingFrame();
+    void updateWheelFrame();
+
+    CarRates evaluateRates(Vector2 vel, float heading, float sinSteer,
+                           float cosSteer) const;
+    void integrate(float dt, Map *map);
 
-    void checkCollisionX(Map *map);
-    void checkCollisionY(Map *map);
-    void checkCollisionX(const std::vector<Car*> &cars);
-    void checkCollisionY(const std::vector<Car*> &cars);
+    int  countSubsteps(float dt, Map *map) const;
+    void checkCollisionX(Map *map, float fromX);
+    void checkCollisionY(Map *map, float fromY);
     void checkCollision(Map *map, const std::vector<Car*> &cars);
-    bool isColliding(Car *other) const;
-    void applyGrassPenalty(Map *map);
+    void resolveCarContacts(const std::vector<Car*> &cars, Map *map);
+    void sampleSurface(Map *map);
+    void applySurfaceScrub();
 
 public:
     Car(Vector2 startPos,
         Vector2 scale,                
-        const char* texturePath,
         CarProfile profile);
-    ~Car();
+    virtual ~Car();
 
     void updateGrip();
     
@@ -73,22 +212,60 @@ public:
     void reverse(float dt);
     void turnleft(float dt);
     void turnright(float dt);
+
+    // One car on its own: step(), then push apart from each of cars in
+    // turn. The result depends on which car updates first; RaceWorld::step
+    // is the order-independent tick for a field of cars.
     void update(float dt, Map *map, const std::vector<Car*> &cars);
-    void render();
-    void displayCollider();
+
+    // Physics and map collision for this tick. Reads and writes only this
+    // car (and reads the map), so cars can step in any order, or at once.
+    void step(float dt, Map *map);
+
+    // What a contact with other does to each car, from current state.
+    // Adds into the deltas so one car's contacts can be summed.
+    void contactResponse(const Car &other, const Contact &contact,
+                         ContactDelta *self, ContactDelta *otherDelta) const;
+    void applyContact(const ContactDelta &delta, Map *map);
+
+    // Contact patch centres in world space, WHEEL_COUNT of them in out.
+    // A caller looking up many cars' surfaces at once hands each car the
+    // SurfaceKinds under its four with setWheelSurfaces; a car nobody does
+    // that for looks its own up when it next needs them.
+    void getWheelPositions(Vector2 *out) const;
+    void setWheelSurfaces(const unsigned char *surfaces);
+    bool needsSurface() const { return mSurfaceStale; }
+    SurfaceInfo getSurface() const { return mSurface; }
 
     Vector2 getPosition() const { return mPos; }
-    float getAngle() const { return mAngle; }
-    float getSpeed() const { return mSpeed; }
+    Vector2 getScale() const { return mScale; }
+    float getAngle() const { return mHeading * RAD2DEG; }
+    float getSpeed() const { return mFrame.speed; }
     float getForwardSpeed() const;
     float getFrontGrip() const { return mGrip.effectiveFrontGrip; }
     float getSteerAngle() const { return mSteerAngle; }
+    float getDraft() const { return mDraft; }
     Vector2 getVelocity() const { return mVel; }
     float getWeight() const { return mProfile.mass; }
+    float getInvMass() const { return mDerived.invMass; }
+    // the sprite's length runs along the heading
+    OrientedBox getBox() const { return { mPos, mFrame.forward, { mScale.x / 2.0f, mScale.y / 2.0f } }; }
 
-    void setAngle(float angle) { mAngle = angle; }
+    void setAngle(float angle) { mHeading = angle * DEG2RAD; updateHeadingFrame(); mSurfaceStale = true; }
     void setSteerAngle(float angle) { mSteerAngle = angle; }
 
+    // Set before step() from the cars around this one, see RaceWorld
+    void setDraft(float draft) { mDraft = draft; }
+    void setIntegrator(Integrator integrator) { mIntegrator = integrator; }
+    Integrator getIntegrator() const { return mIntegrator; }
+
+    // folds everything update() carries between ticks into h
+    uint64_t hashState(uint64_t h) const;
+
+    // a car restored from a saved state steps on exactly as it did then
+    void saveState(CarState *out) const;
+    void restoreState(const CarState &in);
+
     
 };
 
@@ -3,7 +3,7 @@
 
 #include "car.h"
 
-const CarProfile PORSCHE_911 = {
+constexpr CarProfile PORSCHE_911 = {
     .horsepower    = 520.0f,
     .mass          = 1420.0f,
     .dragCoeff     = 0.03f,
@@ -13,10 +13,14 @@ const CarProfile PORSCHE_911 = {
     .turnRadius    = 155.0f,
     .frontAero     = 0.16f,
     .rearAero      = 0.28f,
-    .brake         = 26000.0f
+    .brake         = 26000.0f,
+    .tireB         = 10.5f,
+    .tireC         = 1.6f,
+    .tireE         = 0.6f,
+    .tireLoadSens  = 0.12f
 };
 
-const CarProfile HONDA_NSX = {
+constexpr CarProfile HONDA_NSX = {
     .horsepower    = 390.0f,
     .mass          = 1210.0f,
     .dragCoeff     = 0.03f,
@@ -26,10 +30,14 @@ const CarProfile HONDA_NSX = {
     .turnRadius    = 152.0f,
     .frontAero     = 0.18f,
     .rearAero      = 0.25f,
-    .brake         = 23000.0f
+    .brake         = 23000.0f,
+    .tireB         = 11.0f,
+    .tireC         = 1.55f,
+    .tireE         = 0.5f,
+    .tireLoadSens  = 0.10f
 };
 
-const CarProfile LAMBORGHINI_GALLARDO = {
+constexpr CarProfile LAMBORGHINI_GALLARDO = {
     .horsepower    = 550.0f,
     .mass          = 1590.0f,
     .dragCoeff     = 0.031f,
@@ -39,10 +47,14 @@ const CarProfile LAMBORGHINI_GALLARDO = {
     .turnRadius    = 148.0f,
     .frontAero     = 0.17f,
     .rearAero      = 0.30f,
-    .brake         = 24000.0f
+    .brake         = 24000.0f,
+    .tireB         = 9.5f,
+    .tireC         = 1.65f,
+    .tireE         = 0.65f,
+    .tireLoadSens  = 0.14f
 };
 
-const CarProfile FORD_GT = {
+constexpr CarProfile FORD_GT = {
     .horsepower    = 550.0f,
     .mass          = 1530.0f,
     .dragCoeff     = 0.029f,
@@ -52,7 +64,11 @@ const CarProfile FORD_GT = {
     .turnRadius    = 160.0f,
     .frontAero     = 0.19f,
     .rearAero      = 0.33f,
-    .brake         = 22500.0f
+    .brake         = 22500.0f,
+    .tireB         = 10.0f,
+    .tireC         = 1.6f,
+    .tireE         = 0.6f,
+    .tireLoadSens  = 0.13f
 };
 
 #endif
@@ -1,5 +1,6 @@
 #include "trackone.h"
 #include "car_profiles.h"
+#include "FastMath.h"
 
 TrackOne::TrackOne() : Scene{{0.0f, 0.0f}, nullptr} {
     mGameMode = 0;
@@ -19,6 +20,10 @@ TrackOne::~TrackOne() {
 
 void TrackOne::initialise() {
     mGameState.nextSceneID = -1;  
+    mGameState.tick = 0;
+    mGameState.stateHash = 0;
+    for (int tier = 0; tier < SIM_TIER_COUNT; tier++) mGameState.tierCounts[tier] = 0;
+    mHistory.reset(REWIND_TICKS);
 
     /*
         ----------- Audio -----------
@@ -35,95 +40,77 @@ void TrackOne::initialise() {
 
     //map setup
 
-    mGameState.map = new Map(
-        TRACK_WIDTH,
-        TRACK_HEIGHT,
-        (unsigned int*)mTrackData,
+    if (!mTrackFile.open("assets/track/data/trackone.ugpt"))
+        TraceLog(LOG_FATAL, "can't load assets/track/data/trackone.ugpt, try make tracks");
+
+    int gridCount;
+    const TrackFileSpawn *grid = mTrackFile.getGrid(&gridCount);
+    if (gridCount < 4)
+        TraceLog(LOG_FATAL, "trackone.ugpt has %d spawns, the race needs 4", gridCount);
+
+    mGameState.map = new TrackMap(
+        mTrackFile.getColumns(),
+        mTrackFile.getRows(),
+        mTrackFile.getTiles(),
         "assets/track/tiles.png",
         TILE_SIZE,
         18, 18,
         mOrigin
     );
 
-    mGameState.map->registerMultiTileObject(
-        500,                               
-        "assets/track/Objects/tribune_full.png",
-        2, 1,                               
-        { 0.0f, -32.0f },                   
-        1.0f                               
-    );
-    mGameState.map->registerMultiTileObject(
-        501,                               
-        "assets/track/Objects/tribune_full.png",
-        2, 1,                               
-        { 0.0f, -32.0f },                   
-        1.0f,
-        90.0f                               
-    );
-    mGameState.map->registerMultiTileObject(
-        502,                               
-        "assets/track/Objects/tribune_full.png",
-        2, 1,                               
-        { 0.0f, -32.0f },                   
-        1.0f,
-        180.0f                               
-    );
-    mGameState.map->registerMultiTileObject(
-        503,                               
-        "assets/track/Objects/tribune_full.png",
-        2, 1,                               
-        { 0.0f, -32.0f },                   
-        1.0f,
-        270.0f                               
-    );
+    int objectCount;
+    const TrackFileObject *objects = mTrackFile.getObjects(&objectCount);
+    for (int i = 0; i < objectCount; i++) {
+        const TrackFileObject &obj = objects[i];
+        mGameState.map->registerMultiTileObject(
+            obj.tileID,
+            obj.texture,
+            obj.widthTiles, obj.heightTiles,
+            { obj.offsetX, obj.offsetY },
+            obj.scale,
+            obj.rotation
+        );
+    }
 
-    startLineTop    = mGameState.map->findTile(307);
-    startLineBottom = mGameState.map->findTile(271);
+    // an oil spill on the outer lane of the back straight
+    mGameState.map->registerSurfaceTexture(SURFACE_OIL, "assets/track/Objects/oil.png");
+    mGameState.map->setCellSurface(20, 8, SURFACE_OIL);
+
+    // the tiles, tribunes and oil are fixed from here on
+    mGameState.map->bake();
+
+    startLineTop    = mGameState.map->findFirst(START_LINE_TOP_TILE);
+    startLineBottom = mGameState.map->findFirst(START_LINE_BOTTOM_TILE);
     // Expand finish line by 2 blocks above and below for more generous detection
     startLineTop.y    -= TILE_SIZE * 2.5f;  // 2 blocks above + half tile
     startLineBottom.y += TILE_SIZE * 2.5f;  // 2 blocks below + half tile
-    
-    //setup for corner system
-
-    // Corner 1 - Bottom Left
-    corners.push_back({
-        { {4,20}, {5,20}, {4,21}, {5,21} },
-        90.0f
-    });
-
-    // Corner 2 - Top Left
-    corners.push_back({
-        { {4,8}, {5,8}, {4,9}, {5,9} },
-        90.0f
-    });
-
-    // Corner 3 - Top Right
-    corners.push_back({
-        { {34,8}, {35,8}, {34,9}, {35,9} },
-        90.0f
-    });
-
-     // Corner 4 - Bottom Right
-    corners.push_back({
-        { {34,20}, {35,20}, {34,21}, {35,21} },
-        90.0f
-    });
+
+    //setup for corner system, in the order a lap takes them
+    int cornerCount, cornerTileCount;
+    const TrackFileCorner *cornerDefs = mTrackFile.getCorners(&cornerCount);
+    const TrackFileCell *cornerTiles = mTrackFile.getCornerTiles(&cornerTileCount);
+    for (int i = 0; i < cornerCount; i++) {
+        Corner corner;
+        for (uint32_t k = 0; k < cornerDefs[i].tileCount; k++) {
+            const TrackFileCell &tile = cornerTiles[cornerDefs[i].firstTile + k];
+            corner.tiles.push_back({ tile.col, tile.row });
+        }
+        corner.angle = cornerDefs[i].angle;
+        corners.push_back(corner);
+    }
 
     //create player car
 
-    Vector2 startPos = {
-        mOrigin.x - 1200.0f,
-        mOrigin.y + 2800.0f
-    };
+    Vector2 startPos = { mOrigin.x + grid[0].x, mOrigin.y + grid[0].y };
 
-    mCar = new Car(
+    mCar = new RaceCar(
         startPos,
         {150.0f, 60.0f},
         "assets/sportscars/sprites/sport_car_03_white/car.png",
         PORSCHE_911
     );
 
-    mCar->setAngle(180.0f); // facing left
+    mCar->setAngle(grid[0].angle);
 
     /*
         ----------- CAMERA -----------
@@ -136,56 +123,54 @@ void TrackOne::initialise() {
 
     mGameState.player = mCar;
 
+    mWorld.clear();
+    mWorld.add(mCar);
+
     /*
         ----------- AI Cars -----------
     */
 
     if (mGameMode == 1) {
         // AI Car 1
-        Vector2 AI1Pos = {
-            mOrigin.x - 600.0f,
-            mOrigin.y + 2600.0f
-        };
-        Car* AI1 = new Car(
+        Vector2 AI1Pos = { mOrigin.x + grid[1].x, mOrigin.y + grid[1].y };
+        RaceCar* AI1 = new RaceCar(
             AI1Pos,
             {150.0f, 60.0f},
             "assets/sportscars/sprites/sport_car_01_yellow/car.png",
             HONDA_NSX
         );
-        AI1->setAngle(180.0f);
+        AI1->setAngle(grid[1].angle);
         mAICars.push_back(AI1);
 
         // AI Car 2
-        Vector2 AI2Pos = {
-            mOrigin.x - 800.0f,
-            mOrigin.y + 2800.0f
-        };
-        Car* AI2 = new Car(
+        Vector2 AI2Pos = { mOrigin.x + grid[2].x, mOrigin.y + grid[2].y };
+        RaceCar* AI2 = new RaceCar(
             AI2Pos,
             {150.0f, 60.0f},
             "assets/sportscars/sprites/sport_car_04_red/car.png",
             LAMBORGHINI_GALLARDO
         );
-        AI2->setAngle(180.0f);
+        AI2->setAngle(grid[2].angle);
         mAICars.push_back(AI2);
 
         // AI Car 3
-        Vector2 AI3Pos = {
-            mOrigin.x - 1000.0f,
-            mOrigin.y + 2600.0f
-        };
-        Car* AI3 = new Car(
+        Vector2 AI3Pos = { mOrigin.x + grid[3].x, mOrigin.y + grid[3].y };
+        RaceCar* AI3 = new RaceCar(
             AI3Pos,
             {150.0f, 60.0f},
             "assets/sportscars/sprites/sport_car_05_black/car.png",
             FORD_GT
         );
-        AI3->setAngle(180.0f);
+        AI3->setAngle(grid[3].angle);
         mAICars.push_back(AI3);
 
         // Initialize AI waypoint tracking
         aiCurrentWaypoint.resize(mAICars.size(), 0);
 
+        for (RaceCar* aiCar : mAICars) {
+            mWorld.add(aiCar);
+        }
+
         // Initialize lap tracking
         mLapCount.resize(4, 0);
         mPrevCarPositions.resize(4, startPos);
@@ -200,6 +185,11 @@ void TrackOne::initialise() {
 
     // Setup AI waypoints
     setupAIWaypoints();
+
+    setupProps();
+
+    // the starting grid is the furthest back a rewind goes
+    saveRace();
 }
 
 Vector2 TrackOne::tileToWorld(int col, int row) {
@@ -210,41 +200,10 @@ Vector2 TrackOne::tileToWorld(int col, int row) {
 }
 
 void TrackOne::setupAIWaypoints() {
-    // First straight 
-    aiWaypoints.push_back(tileToWorld(17, 21));
-    aiWaypoints.push_back(tileToWorld(10, 21));
-
-    // Corner 1 
-    aiWaypoints.push_back(tileToWorld(6, 21));   // Entry
-    aiWaypoints.push_back(tileToWorld(5, 20));   // Apex
-    aiWaypoints.push_back(tileToWorld(4, 18));   // Exit
-
-    // Left straight 
-    aiWaypoints.push_back(tileToWorld(4, 14));
-
-    // Corner 2 
-    aiWaypoints.push_back(tileToWorld(4, 10));   // Entry
-    aiWaypoints.push_back(tileToWorld(5, 9));    // Apex
-    aiWaypoints.push_back(tileToWorld(7, 8));    // Exit
-
-    // Top straight 
-    aiWaypoints.push_back(tileToWorld(17, 8));
-
-    // Corner 3
-    aiWaypoints.push_back(tileToWorld(33, 8));   // Entry
-    aiWaypoints.push_back(tileToWorld(34, 9));   // Apex
-    aiWaypoints.push_back(tileToWorld(35, 11));  // Exit
-
-    // Right straight 
-    aiWaypoints.push_back(tileToWorld(35, 14));
-
-    // Corner 4 
-    aiWaypoints.push_back(tileToWorld(35, 19));  // Entry
-    aiWaypoints.push_back(tileToWorld(34, 20));  // Apex
-    aiWaypoints.push_back(tileToWorld(32, 21));  // Exit
-
-    // Final Straight
-    aiWaypoints.push_back(tileToWorld(24, 21));
+    int count;
+    const TrackFileCell *line = mTrackFile.getRacingLine(&count);
+    for (int i = 0; i < count; i++)
+        aiWaypoints.push_back(tileToWorld(line[i].col, line[i].row));
 }
 
 void TrackOne::updateAI(Car* aiCar, int aiIndex, float dt) {
@@ -257,7 +216,7 @@ void TrackOne::updateAI(Car* aiCar, int aiIndex, float dt) {
     // calculate distance to current waypoint
     float dx = targetWaypoint.x - carPos.x;
     float dy = targetWaypoint.y - carPos.y;
-    float distToWaypoint = std::sqrt(dx * dx + dy * dy);
+    float distToWaypoint = simSqrt(dx * dx + dy * dy);
 
     // move to next waypoint if close enough
     if (distToWaypoint < TILE_SIZE * 2.0f) {
@@ -265,22 +224,32 @@ void TrackOne::updateAI(Car* aiCar, int aiIndex, float dt) {
         targetWaypoint = aiWaypoints[aiCurrentWaypoint[aiIndex]];
         dx = targetWaypoint.x - carPos.x;
         dy = targetWaypoint.y - carPos.y;
-        distToWaypoint = std::sqrt(dx * dx + dy * dy);
+        distToWaypoint = simSqrt(dx * dx + dy * dy);
     }
 
     // calculate target angle
-    float targetAngle = std::atan2(dy, dx) * RAD2DEG;
+    float targetAngle = simAtan2(dy, dx) * RAD2DEG;
     float carAngle = aiCar->getAngle();
 
     // normalize angle difference
-    float angleDiff = targetAngle - carAngle;
-    while (angleDiff > 180.0f) angleDiff -= 360.0f;
-    while (angleDiff < -180.0f) angleDiff += 360.0f;
+    float angleDiff = wrapDegrees(targetAngle - carAngle);
 
     // steering
     float steerStrength = 0.6f;
     float desiredSteer = angleDiff * steerStrength;
 
+    // edge field: turn back towards the track before running off it
+    float sinHeading, cosHeading;
+    simSinCos(carAngle * DEG2RAD, &sinHeading, &cosHeading);
+    Vector2 ahead = { carPos.x + cosHeading * AI_EDGE_LOOKAHEAD,
+                      carPos.y + sinHeading * AI_EDGE_LOOKAHEAD };
+    float edge = mGameState.map->getEdgeDistance(ahead);
+    if (edge < AI_EDGE_MARGIN) {
+        Vector2 away = mGameState.map->getEdgeGradient(ahead);
+        float awayDiff = wrapDegrees(simAtan2(away.y, away.x) * RAD2DEG - carAngle);
+        desiredSteer += awayDiff * steerStrength * (AI_EDGE_MARGIN - edge) / AI_EDGE_MARGIN;
+    }
+
     // clamp to max steering 
     if (desiredSteer > 20.0f) desiredSteer = 20.0f;
     if (desiredSteer < -20.0f) desiredSteer = -20.0f;
@@ -305,6 +274,44 @@ void TrackOne::updateAI(Car* aiCar, int aiIndex, float dt) {
     }
 }
 
+// Cones every half tile along the inside of the oval, tyre stacks round
+// the outside of each corner. They sleep until a car gets to them.
+void TrackOne::setupProps() {
+    mGameState.map->registerPropTexture(PROP_CONE,   "assets/track/Objects/cone_straight.png");
+    mGameState.map->registerPropTexture(PROP_BARREL, "assets/track/Objects/barrel_red.png");
+    mGameState.map->registerPropTexture(PROP_TYRES,  "assets/track/Objects/tires_red.png");
+
+    // infield edge: inside of cols 6-33, rows 10-19
+    float left   = mGameState.map->getLeftBoundary() + 6 * TILE_SIZE + 30.0f;
+    float right  = mGameState.map->getLeftBoundary() + 34 * TILE_SIZE - 30.0f;
+    float top    = mGameState.map->getTopBoundary() + 10 * TILE_SIZE + 30.0f;
+    float bottom = mGameState.map->getTopBoundary() + 20 * TILE_SIZE - 30.0f;
+
+    for (float x = left; x <= right; x += TILE_SIZE / 2.0f) {
+        mProps.add(PROP_CONE, { x, top });
+        mProps.add(PROP_CONE, { x, bottom });
+    }
+    for (float y = top + TILE_SIZE / 2.0f; y < bottom; y += TILE_SIZE / 2.0f) {
+        mProps.add(PROP_CONE, { left, y });
+        mProps.add(PROP_CONE, { right, y });
+    }
+
+    // outer corners of the track, a row of tyres across each
+    const int corners[][2] = { {4, 21}, {4, 8}, {35, 8}, {35, 21} };
+    for (const auto &corner : corners) {
+        Vector2 centre = tileToWorld(corner[0], corner[1]);
+        float outX = corner[0] < 20 ? -1.0f : 1.0f;
+        float outY = corner[1] < 15 ? -1.0f : 1.0f;
+        for (int k = -2; k <= 2; k++) {
+            mProps.add(PROP_TYRES, {
+                centre.x + outX * TILE_SIZE * 0.35f + k * 60.0f * outY,
+                centre.y + outY * TILE_SIZE * 0.35f - k * 60.0f * outX
+            });
+        }
+    }
+    mWorld.setProps(&mProps);
+}
+
 bool TrackOne::isInsideCorner(int col, int row, int cornerIndex) {
     if (cornerIndex >= corners.size()) return false;
     Corner& c = corners[cornerIndex];
@@ -319,6 +326,63 @@ bool TrackOne::isInsideCorner(int col, int row, int cornerIndex) {
     return false;
 }
 
+// Every car, the tiers and the lap tracking into one RaceState, then
+// onto the history
+void TrackOne::saveRace() {
+    if (!mWorld.save(&mSnapshot)) return;
+    mSnapshot.tick = mGameState.tick;
+
+    TrackProgress &track = mSnapshot.track;
+    track.inLap = mInLap;
+    track.lapDisqualified = mLapDisqualified;
+    track.currentLapTime = mCurrentLapTime;
+    track.bestLapTime = mBestLapTime;
+    track.prevCarPos = mPrevCarPos;
+    track.currentCorner = currentCorner;
+
+    for (size_t i = 0; i < mLapCount.size() && i < RACE_MAX_CARS; i++) {
+        track.lapCount[i] = mLapCount[i];
+        track.prevCarPositions[i] = mPrevCarPositions[i];
+    }
+    for (size_t i = 0; i < aiCurrentWaypoint.size() && i < RACE_MAX_CARS; i++)
+        track.aiCurrentWaypoint[i] = aiCurrentWaypoint[i];
+    track.raceFinished = mRaceFinished;
+    track.incompleteLapWarning = mIncompleteLapWarning;
+    track.playerFinishPosition = mPlayerFinishPosition;
+    track.raceCurrentCorner = mRaceCurrentCorner;
+
+    mHistory.push(mSnapshot);
+}
+
+// Puts the race back as it was ticks ago; the next tick carries on from there
+void TrackOne::rewind(int ticks) {
+    if (!mHistory.rewind(ticks, &mSnapshot)) return;
+    mWorld.restore(mSnapshot);
+    mGameState.tick = mSnapshot.tick;
+
+    const TrackProgress &track = mSnapshot.track;
+    mInLap = track.inLap;
+    mLapDisqualified = track.lapDisqualified;
+    mCurrentLapTime = track.currentLapTime;
+    mBestLapTime = track.bestLapTime;
+    mPrevCarPos = track.prevCarPos;
+    currentCorner = track.currentCorner;
+
+    for (size_t i = 0; i < mLapCount.size() && i < RACE_MAX_CARS; i++) {
+        mLapCount[i] = track.lapCount[i];
+        mPrevCarPositions[i] = track.prevCarPositions[i];
+    }
+    for (size_t i = 0; i < aiCurrentWaypoint.size() && i < RACE_MAX_CARS; i++)
+        aiCurrentWaypoint[i] = track.aiCurrentWaypoint[i];
+    mRaceFinished = track.raceFinished;
+    mIncompleteLapWarning = track.incompleteLapWarning;
+    mPlayerFinishPosition = track.playerFinishPosition;
+    mRaceCurrentCorner = track.raceCurrentCorner;
+
+    mGameState.camera.target = mCar->getPosition();
+    mGameState.camera.rotation = -(mCar->getAngle() + 90);
+}
+
 void TrackOne::update(float dt) {
     //return to menu
     if (IsKeyPressed(KEY_BACKSPACE)) {
@@ -326,13 +390,11 @@ void TrackOne::update(float dt) {
         return;
     }
 
-    // collision tracking for all cars
-    std::vector<Car*> allCars;
-    if (mGameMode == 1) {
-        allCars.push_back(mCar);
-        for (size_t i = 0; i < mAICars.size(); i++) {
-            allCars.push_back(mAICars[i]);
-        }
+    // hold R to run the race backwards
+    if (IsKeyDown(KEY_R)) {
+        rewind(REWIND_SPEED);
+        UpdateMusicStream(mGameState.bgm1);
+        return;
     }
 
     if (mGameMode == 0) {
@@ -365,7 +427,7 @@ void TrackOne::update(float dt) {
             mCurrentLapTime += dt;
         }
 
-        if (mInLap && mGameState.map->getTileAtWorldPos(mCar->getPosition()) == 0) {
+        if (mInLap && mGameState.map->getEdgeDistance(mCar->getPosition()) < -TRACK_LIMIT) {
             mLapDisqualified = true;
         }
 
@@ -454,37 +516,35 @@ void TrackOne::update(float dt) {
             }
         }
 
-        // update AI cars 
+        // AI inputs; the cars all move together below
         if (!mRaceFinished) {
             for (size_t i = 0; i < mAICars.size(); i++) {
                 updateAI(mAICars[i], i, dt);
-
-                // Build list of AI cars
-                std::vector<Car*> otherCars;
-                for (size_t j = 0; j < allCars.size(); j++) {
-                    if (allCars[j] != mAICars[i]) {
-                        otherCars.push_back(allCars[j]);
-                    }
-                }
-                mAICars[i]->update(dt, mGameState.map, otherCars);
             }
         }
     }
 
-    // update player car
-    if (mGameMode == 1) {
-        if (!mRaceFinished) {
-            // Build list of AI cars
-            std::vector<Car*> otherCars;
-            for (size_t i = 0; i < mAICars.size(); i++) {
-                otherCars.push_back(mAICars[i]);
-            }
-            mCar->update(dt, mGameState.map, otherCars);
-        }
-    } else {
-        std::vector<Car*> otherCars;
-        mCar->update(dt, mGameState.map, otherCars);
+    // step every car at once: each one's physics, then the contacts
+    // between them. Cars the camera can't see and that are clear of
+    // everyone else step at a lower rate
+    mWorld.setFocus(mGameState.camera.target,
+                    Vector2Length(mGameState.camera.offset) / mGameState.camera.zoom);
+    if (mGameMode == 0 || !mRaceFinished) {
+        mWorld.step(dt, mGameState.map);
     }
+    for (int tier = 0; tier < SIM_TIER_COUNT; tier++)
+        mGameState.tierCounts[tier] = mWorld.getTierCount((SimTier) tier);
+
+    // fingerprint of this tick for replays and determinism checks
+    uint64_t hash = hashTick(mGameState.tick++);
+    hash = mCar->hashState(hash);
+    for (size_t i = 0; i < mAICars.size(); i++)
+        hash = mAICars[i]->hashState(hash);
+    hash = mProps.hashState(hash);
+    mGameState.stateHash = hash;
+
+    // this tick, for rewinding to
+    saveRace();
 
     UpdateMusicStream(mGameState.bgm1);
 
@@ -507,10 +567,11 @@ void TrackOne::render() {
         DrawRectangle(-10000, -10000, 20000, 20000, ColorFromHex(mBGColourHexCode));
     }
 
-    mGameState.map->render();
+    mGameState.map->render(mGameState.camera);
+    mGameState.map->renderProps(mProps);
 
     // render cars
-    for (Car* aiCar : mAICars) {
+    for (RaceCar* aiCar : mAICars) {
         aiCar->render();
     }
 
@@ -587,12 +648,16 @@ void TrackOne::renderUI() {
 void TrackOne::shutdown() {
     delete mCar;
     delete mGameState.map;
+    mTrackFile.close();
 
     // clean up AI cars
-    for (Car* aiCar : mAICars) {
+    for (RaceCar* aiCar : mAICars) {
         delete aiCar;
     }
     mAICars.clear();
+    mWorld.clear();
+    mHistory.clear();
+    mProps.clear();
 
     // Stop music (don't unload - it's shared)
     StopMusicStream(mGameState.bgm1);
@@ -3,42 +3,14 @@
 
 #include "Scene.h"
 #include "TrackCommon.h"
+#include "RaceWorld.h"
+#include "TrackFile.h"
 #include <vector>
 
 class TrackThree : public Scene {
 private:
-    unsigned int mTrackData[TRACK_WIDTH * TRACK_HEIGHT] = {
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,503,500,000,500,000,500,000,500,000,500,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,000,000,000,000,000,000,000,000,000,000,501,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,503,000,114, 96,186,186, 78, 60,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,000,000,113, 95,184,184, 77, 59,000,000,501,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,503,000,203,167,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,000,000,203,167,501,000,203,167,000,000,501,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,503,000,203,167,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,000,000,203,167,501,000,203,167,000,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,501,000,000,
-        000,503,000,203,167,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,000,000,203,167,501,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,501,000,000,
-        000,503,000,203,167,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,114, 96,186,186,186,186,186,186,186,186,186,186,186, 78, 60,000,000,000,000,
-        000,000,000,203,167,501,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,113, 95,184,184,184,184,184,184,184,184,184,184,184, 77, 59,000,501,000,000,
-        000,503,000,203,167,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,
-        000,000,000,203,167,501,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,203,167,000,501,000,000,
-        000,503,000,203,167,000,000,112, 94,186,186,186,186,186,186,186,186,186,186,186,186, 76, 58,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,
-        000,000,000,203,167,501,000,111, 93,184,184,184,184,184,184,184,184,184,184,184,184, 75, 57,000,000,501,502,000,502,000,502,000,000,000,203,167,000,501,000,000,
-        000,503,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,503,000,000,203,167,000,000,000,000,
-        000,000,000,203,167,501,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,000,000,000,000,000,000,000,000,203,167,000,501,000,000,
-        000,503,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,503,000,000,203,167,000,000,000,000,
-        000,000,000,203,167,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,000,000,000,203,167,000,501,000,000,
-        000,503,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,
-        000,000,000,112, 94,186,186,186,186,186,186,186,186,186,186,307,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186, 76, 58,000,501,000,000,
-        000,503,000,111, 93,184,184,184,184,184,184,184,184,184,184,271,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184, 75, 57,000,000,000,000,
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,501,000,000,
-        000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,000,000,000,
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000
-    };
+    // layout, tribunes, corners, racing line and grid, mapped from disk
+    TrackFile mTrackFile;
 
     // corner detection system
     std::vector<Corner> corners;
@@ -51,8 +23,15 @@ private:
     void updateAI(Car* aiCar, int aiIndex, float dt);
     Vector2 tileToWorld(int col, int row);
 
-    Car* mCar = nullptr;
-    std::vector<Car*> mAICars;
+    RaceCar* mCar = nullptr;
+    std::vector<RaceCar*> mAICars;
+    RaceWorld mWorld; // every car on track, stepped together
+
+    // the last few seconds, for rewinding after an off
+    RaceHistory mHistory;
+    RaceState mSnapshot;
+    void saveRace();
+    void rewind(int ticks);
 
     // game gode
     int mGameMode = 0; // 0 = hotlap, 1 = race
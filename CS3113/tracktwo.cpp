@@ -1,5 +1,6 @@
 #include "tracktwo.h"
 #include "car_profiles.h"
+#include "FastMath.h"
 
 TrackTwo::TrackTwo() : Scene{{0.0f, 0.0f}, nullptr} {
     mGameMode = 0;
@@ -19,6 +20,10 @@ TrackTwo::~TrackTwo() {
 
 void TrackTwo::initialise() {
     mGameState.nextSceneID = -1;
+    mGameState.tick = 0;
+    mGameState.stateHash = 0;
+    for (int tier = 0; tier < SIM_TIER_COUNT; tier++) mGameState.tierCounts[tier] = 0;
+    mHistory.reset(REWIND_TICKS);
 
     /*
         ----------- Audio -----------
@@ -35,131 +40,73 @@ void TrackTwo::initialise() {
 
     //map setup
 
-    mGameState.map = new Map(
-        TRACK_WIDTH,
-        TRACK_HEIGHT,
-        (unsigned int*)mTrackData,
+    if (!mTrackFile.open("assets/track/data/tracktwo.ugpt"))
+        TraceLog(LOG_FATAL, "can't load assets/track/data/tracktwo.ugpt, try make tracks");
+
+    int gridCount;
+    const TrackFileSpawn *grid = mTrackFile.getGrid(&gridCount);
+    if (gridCount < 4)
+        TraceLog(LOG_FATAL, "tracktwo.ugpt has %d spawns, the race needs 4", gridCount);
+
+    mGameState.map = new TrackMap(
+        mTrackFile.getColumns(),
+        mTrackFile.getRows(),
+        mTrackFile.getTiles(),
         "assets/track/tiles.png",
         TILE_SIZE,
         18, 18,
         mOrigin
     );
 
-    mGameState.map->registerMultiTileObject(
-        500,
-        "assets/track/Objects/tribune_full.png",
-        2, 1,
-        { 0.0f, -32.0f },
-        1.0f
-    );
-    mGameState.map->registerMultiTileObject(
-        501,
-        "assets/track/Objects/tribune_full.png",
-        2, 1,
-        { 0.0f, -32.0f },
-        1.0f,
-        90.0f
-    );
-    mGameState.map->registerMultiTileObject(
-        502,
-        "assets/track/Objects/tribune_full.png",
-        2, 1,
-        { 0.0f, -32.0f },
-        1.0f,
-        180.0f
-    );
-    mGameState.map->registerMultiTileObject(
-        503,
-        "assets/track/Objects/tribune_full.png",
-        2, 1,
-        { 0.0f, -32.0f },
-        1.0f,
-        270.0f
-    );
+    int objectCount;
+    const TrackFileObject *objects = mTrackFile.getObjects(&objectCount);
+    for (int i = 0; i < objectCount; i++) {
+        const TrackFileObject &obj = objects[i];
+        mGameState.map->registerMultiTileObject(
+            obj.tileID,
+            obj.texture,
+            obj.widthTiles, obj.heightTiles,
+            { obj.offsetX, obj.offsetY },
+            obj.scale,
+            obj.rotation
+        );
+    }
 
-    startLineTop    = mGameState.map->findTile(307);
-    startLineBottom = mGameState.map->findTile(271);
+    // the tiles and tribunes are fixed from here on
+    mGameState.map->bake();
+
+    startLineTop    = mGameState.map->findFirst(START_LINE_TOP_TILE);
+    startLineBottom = mGameState.map->findFirst(START_LINE_BOTTOM_TILE);
     // Expand finish line by 2 blocks above and below for more generous detection
     startLineTop.y    -= TILE_SIZE * 2.5f;
     startLineBottom.y += TILE_SIZE * 2.5f;
 
-    //setup for corner system
-
-    // Corner 1 
-    corners.push_back({
-        { {9,24}, {9,23}, {9,22}, {8,24}, {8, 23}, {8, 22}},
-        90.0f
-    });
-
-    // Corner 2 
-    corners.push_back({
-        { {2,21}, {2,20}, {3,21}, {3,20}, },
-        90.0f
-    });
-
-    // Corner 3 
-    corners.push_back({
-        { { 3,4}, {4,4}, {3,5}, {4,5} },
-        90.0f
-    });
-
-    // Corner 4 Hairpin part 1
-    corners.push_back({
-        { {28,4}, {29,4}, {28,5}, {29,5} },
-        90.0f
-    });
-
-    // Corner 5 Hairpin part 2
-    corners.push_back({
-        { {28,7}, {29,7}, {28,8}, {29,8} },
-        90.0f
-    });
-
-    // Corner 6 
-    corners.push_back({
-        { {22,7}, {23,7}, {22,8}, {23,8} },
-        90.0f
-    });
-
-    // Corner 7 
-    corners.push_back({
-        { {22,15}, {22,16}, {23,15}, {24,16}},
-        90.0f
-    });
-
-    // Corner 8 
-    corners.push_back({
-        { {27,16}, {28,17}, {27,17}, {28,18}, {27,18} },
-        90.0f
-    });
-
-    // Corner 9
-    corners.push_back({
-        { {34,17}, {34,18}, {35,17}, {35,18} },
-        90.0f
-    });
-
-    // Corner 10 -
-    corners.push_back({
-        { {34,23}, {34,24}, {35,23}, {35,24} },
-        90.0f
-    });
+    //setup for corner system, in the order a lap takes them
+    int cornerCount, cornerTileCount;
+    const TrackFileCorner *cornerDefs = mTrackFile.getCorners(&cornerCount);
+    const TrackFileCell *cornerTiles = mTrackFile.getCornerTiles(&cornerTileCount);
+    for (int i = 0; i < cornerCount; i++) {
+        Corner corner;
+        for (uint32_t k = 0; k < cornerDefs[i].tileCount; k++) {
+            const TrackFileCell &tile = cornerTiles[cornerDefs[i].firstTile + k];
+            corner.tiles.push_back({ tile.col, tile.row });
+        }
+        corner.angle = cornerDefs[i].angle;
+        corners.push_back(corner);
+    }
 
     //create player car
 
-    Vector2 startPos = {
-        mOrigin.x - 1200.0f,
-        mOrigin.y + 4200.0f
-    };
+    Vector2 startPos = { mOrigin.x + grid[0].x, mOrigin.y + grid[0].y };
 
-    mCar = new Car(
+    mCar = new RaceCar(
         startPos,
         {150.0f, 60.0f},
         "assets/sportscars/sprites/sport_car_03_white/car.png",
         PORSCHE_911
     );
 
-    mCar->setAngle(180.0f); // facing left
+    mCar->setAngle(grid[0].angle);
 
     /*
         ----------- CAMERA -----------
@@ -172,56 +119,54 @@ void TrackTwo::initialise() {
 
     mGameState.player = mCar;
 
+    mWorld.clear();
+    mWorld.add(mCar);
+
     /*
         ----------- AI Cars -----------
     */
 
     if (mGameMode == 1) {
         // AI Car 1
-        Vector2 AI1Pos = {
-            mOrigin.x - 600.0f,
-            mOrigin.y + 4000.0f
-        };
-        Car* AI1 = new Car(
+        Vector2 AI1Pos = { mOrigin.x + grid[1].x, mOrigin.y + grid[1].y };
+        RaceCar* AI1 = new RaceCar(
             AI1Pos,
             {150.0f, 60.0f},
             "assets/sportscars/sprites/sport_car_01_yellow/car.png",
             HONDA_NSX
         );
-        AI1->setAngle(180.0f);
+        AI1->setAngle(grid[1].angle);
         mAICars.push_back(AI1);
 
         // AI Car 2
-        Vector2 AI2Pos = {
-            mOrigin.x - 800.0f,
-            mOrigin.y + 4200.0f
-        };
-        Car* AI2 = new Car(
+        Vector2 AI2Pos = { mOrigin.x + grid[2].x, mOrigin.y + grid[2].y };
+        RaceCar* AI2 = new RaceCar(
             AI2Pos,
             {150.0f, 60.0f},
             "assets/sportscars/sprites/sport_car_04_red/car.png",
             LAMBORGHINI_GALLARDO
         );
-        AI2->setAngle(180.0f);
+        AI2->setAngle(grid[2].angle);
         mAICars.push_back(AI2);
 
         // AI Car 3
-        Vector2 AI3Pos = {
-            mOrigin.x - 1000.0f,
-            mOrigin.y + 4000.0f
-        };
-        Car* AI3 = new Car(
+        Vector2 AI3Pos = { mOrigin.x + grid[3].x, mOrigin.y + grid[3].y };
+        RaceCar* AI3 = new RaceCar(
             AI3Pos,
             {150.0f, 60.0f},
             "assets/sportscars/sprites/sport_car_05_black/car.png",
             FORD_GT
         );
-        AI3->setAngle(180.0f);
+        AI3->setAngle(grid[3].angle);
         mAICars.push_back(AI3);
 
         // Initialize AI waypoint tracking
         aiCurrentWaypoint.resize(mAICars.size(), 0);
 
+        for (RaceCar* aiCar : mAICars) {
+            mWorld.add(aiCar);
+        }
+
         // Initialize lap tracking
         mLapCount.resize(4, 0);
         mPrevCarPositions.resize(4, startPos);
@@ -236,6 +181,9 @@ void TrackTwo::initialise() {
 
     // Setup AI waypoints
     setupAIWaypoints();
+
+    // the starting grid is the furthest back a rewind goes
+    saveRace();
 }
 
 Vector2 TrackTwo::tileToWorld(int col, int row) {
@@ -246,82 +194,10 @@ Vector2 TrackTwo::tileToWorld(int col, int row) {
 }
 
 void TrackTwo::setupAIWaypoints() {
-    // Start straight (from finish line)
-    aiWaypoints.push_back(tileToWorld(15, 24));
-    aiWaypoints.push_back(tileToWorld(12, 24));
-
-    // Corner 1 - Bottom-left sweeping 
-    aiWaypoints.push_back(tileToWorld(10, 24));  // Entry
-    aiWaypoints.push_back(tileToWorld(9, 23));   // Apex
-    aiWaypoints.push_back(tileToWorld(7, 22));   // Exit
-
-    // Straight to Corner 2
-    aiWaypoints.push_back(tileToWorld(4, 22));
-
-    // Corner 2 - Left turn
-    aiWaypoints.push_back(tileToWorld(3, 21));   // Entry
-    aiWaypoints.push_back(tileToWorld(3, 20));   // Apex
-    aiWaypoints.push_back(tileToWorld(2, 18));   // Exit
-
-    // Left straight
-    aiWaypoints.push_back(tileToWorld(2, 12));
-
-    // Corner 3 - Top-left
-    aiWaypoints.push_back(tileToWorld(2, 6));    // Entry
-    aiWaypoints.push_back(tileToWorld(3, 5));    // Apex
-    aiWaypoints.push_back(tileToWorld(5, 4));    // Exit
-
-    // Top straight
-    aiWaypoints.push_back(tileToWorld(15, 4));
-
-    //slow down
-    aiWaypoints.push_back(tileToWorld(25, 4));
-    aiWaypoints.push_back(tileToWorld(26, 3));
-
-    // Corner 4 & 5 - Top-right hairpin (stay tight on inside)
-    aiWaypoints.push_back(tileToWorld(27, 4));   // Entry
-    aiWaypoints.push_back(tileToWorld(28, 5));   // Apex 1
-    aiWaypoints.push_back(tileToWorld(28, 6));   // Mid
-    aiWaypoints.push_back(tileToWorld(28, 7));   // Apex 2
-
-    //skip straight and exit  for clean transition
-
-    // Corner 6
-    aiWaypoints.push_back(tileToWorld(24, 7));   // Entry
-    aiWaypoints.push_back(tileToWorld(23, 8));   // Apex
-    aiWaypoints.push_back(tileToWorld(22, 10));  // Exit
-
-    // Straight to Corner 7
-    aiWaypoints.push_back(tileToWorld(22, 13));
-
-    // Corner 7
-    aiWaypoints.push_back(tileToWorld(22, 15));  // Entry
-    aiWaypoints.push_back(tileToWorld(23, 16));  // Apex
-    aiWaypoints.push_back(tileToWorld(25, 17));  // Exit
-
-    // Corner 8 - Chicane
-    aiWaypoints.push_back(tileToWorld(27, 17));  // Entry
-    aiWaypoints.push_back(tileToWorld(28, 17));  // Apex
-    aiWaypoints.push_back(tileToWorld(30, 18));  // Exit
-
-    // Straight to Corner 9
-    aiWaypoints.push_back(tileToWorld(32, 18));
-
-    // Corner 9 - second to last
-    aiWaypoints.push_back(tileToWorld(33, 17));  // Entry
-    aiWaypoints.push_back(tileToWorld(34, 18));  // Apex
-    aiWaypoints.push_back(tileToWorld(35, 20));  // Exit
-
-    // Right straight
-    aiWaypoints.push_back(tileToWorld(35, 22));
-
-    // Corner 10 - final corner
-    aiWaypoints.push_back(tileToWorld(35, 23));  // Entry
-    aiWaypoints.push_back(tileToWorld(34, 24));  // Apex
-    aiWaypoints.push_back(tileToWorld(30, 24));  // Exit
-
-    // Final straight to finish
-    aiWaypoints.push_back(tileToWorld(22, 24));
+    int count;
+    const TrackFileCell *line = mTrackFile.getRacingLine(&count);
+    for (int i = 0; i < count; i++)
+        aiWaypoints.push_back(tileToWorld(line[i].col, line[i].row));
 }
 
 void TrackTwo::updateAI(Car* aiCar, int aiIndex, float dt) {
@@ -334,7 +210,7 @@ void TrackTwo::updateAI(Car* aiCar, int aiIndex, float dt) {
     // calculate distance to current waypoint
     float dx = targetWaypoint.x - carPos.x;
     float dy = targetWaypoint.y - carPos.y;
-    float distToWaypoint = std::sqrt(dx * dx + dy * dy);
+    float distToWaypoint = simSqrt(dx * dx + dy * dy);
 
     // move to next waypoint if close enough
     if (distToWaypoint < TILE_SIZE * 2.0f) {
@@ -342,22 +218,32 @@ void TrackTwo::updateAI(Car* aiCar, int aiIndex, float dt) {
         targetWaypoint = aiWaypoints[aiCurrentWaypoint[aiIndex]];
         dx = targetWaypoint.x - carPos.x;
         dy = targetWaypoint.y - carPos.y;
-        distToWaypoint = std::sqrt(dx * dx + dy * dy);
+        distToWaypoint = simSqrt(dx * dx + dy * dy);
     }
 
     // calculate target angle
-    float targetAngle = std::atan2(dy, dx) * RAD2DEG;
+    float targetAngle = simAtan2(dy, dx) * RAD2DEG;
     float carAngle = aiCar->getAngle();
 
     // normalize angle difference
-    float angleDiff = targetAngle - carAngle;
-    while (angleDiff > 180.0f) angleDiff -= 360.0f;
-    while (angleDiff < -180.0f) angleDiff += 360.0f;
+    float angleDiff = wrapDegrees(targetAngle - carAngle);
 
     // steering
     float steerStrength = 0.6f;
     float desiredSteer = angleDiff * steerStrength;
 
+    // edge field: turn back towards the track before running off it
+    float sinHeading, cosHeading;
+    simSinCos(carAngle * DEG2RAD, &sinHeading, &cosHeading);
+    Vector2 ahead = { carPos.x + cosHeading * AI_EDGE_LOOKAHEAD,
+                      carPos.y + sinHeading * AI_EDGE_LOOKAHEAD };
+    float edge = mGameState.map->getEdgeDistance(ahead);
+    if (edge < AI_EDGE_MARGIN) {
+        Vector2 away = mGameState.map->getEdgeGradient(ahead);
+        float awayDiff = wrapDegrees(simAtan2(away.y, away.x) * RAD2DEG - carAngle);
+        desiredSteer += awayDiff * steerStrength * (AI_EDGE_MARGIN - edge) / AI_EDGE_MARGIN;
+    }
+
     // clamp to max steering
     if (desiredSteer > 20.0f) desiredSteer = 20.0f;
     if (desiredSteer < -20.0f) desiredSteer = -20.0f;
@@ -396,6 +282,63 @@ bool TrackTwo::isInsideCorner(int col, int row, int cornerIndex) {
     return false;
 }
 
+// Every car, the tiers and the lap tracking into one RaceState, then
+// onto the history
+void TrackTwo::saveRace() {
+    if (!mWorld.save(&mSnapshot)) return;
+    mSnapshot.tick = mGameState.tick;
+
+    TrackProgress &track = mSnapshot.track;
+    track.inLap = mInLap;
+    track.lapDisqualified = mLapDisqualified;
+    track.currentLapTime = mCurrentLapTime;
+    track.bestLapTime = mBestLapTime;
+    track.prevCarPos = mPrevCarPos;
+    track.currentCorner = currentCorner;
+
+    for (size_t i = 0; i < mLapCount.size() && i < RACE_MAX_CARS; i++) {
+        track.lapCount[i] = mLapCount[i];
+        track.prevCarPositions[i] = mPrevCarPositions[i];
+    }
+    for (size_t i = 0; i < aiCurrentWaypoint.size() && i < RACE_MAX_CARS; i++)
+        track.aiCurrentWaypoint[i] = aiCurrentWaypoint[i];
+    track.raceFinished = mRaceFinished;
+    track.incompleteLapWarning = mIncompleteLapWarning;
+    track.playerFinishPosition = mPlayerFinishPosition;
+    track.raceCurrentCorner = mRaceCurrentCorner;
+
+    mHistory.push(mSnapshot);
+}
+
+// Puts the race back as it was ticks ago; the next tick carries on from there
+void TrackTwo::rewind(int ticks) {
+    if (!mHistory.rewind(ticks, &mSnapshot)) return;
+    mWorld.restore(mSnapshot);
+    mGameState.tick = mSnapshot.tick;
+
+    const TrackProgress &track = mSnapshot.track;
+    mInLap = track.inLap;
+    mLapDisqualified = track.lapDisqualified;
+    mCurrentLapTime = track.currentLapTime;
+    mBestLapTime = track.bestLapTime;
+    mPrevCarPos = track.prevCarPos;
+    currentCorner = track.currentCorner;
+
+    for (size_t i = 0; i < mLapCount.size() && i < RACE_MAX_CARS; i++) {
+        mLapCount[i] = track.lapCount[i];
+        mPrevCarPositions[i] = track.prevCarPositions[i];
+    }
+    for (size_t i = 0; i < aiCurrentWaypoint.size() && i < RACE_MAX_CARS; i++)
+        aiCurrentWaypoint[i] = track.aiCurrentWaypoint[i];
+    mRaceFinished = track.raceFinished;
+    mIncompleteLapWarning = track.incompleteLapWarning;
+    mPlayerFinishPosition = track.playerFinishPosition;
+    mRaceCurrentCorner = track.raceCurrentCorner;
+
+    mGameState.camera.target = mCar->getPosition();
+    mGameState.camera.rotation = -(mCar->getAngle() + 90);
+}
+
 void TrackTwo::update(float dt) {
     //return to menu
     if (IsKeyPressed(KEY_BACKSPACE)) {
@@ -403,13 +346,11 @@ void TrackTwo::update(float dt) {
         return;
     }
 
-    // collision tracking for all cars
-    std::vector<Car*> allCars;
-    if (mGameMode == 1) {
-        allCars.push_back(mCar);
-        for (size_t i = 0; i < mAICars.size(); i++) {
-            allCars.push_back(mAICars[i]);
-        }
+    // hold R to run the race backwards
+    if (IsKeyDown(KEY_R)) {
+        rewind(REWIND_SPEED);
+        UpdateMusicStream(mGameState.bgm2);
+        return;
     }
 
     if (mGameMode == 0) {
@@ -442,7 +383,7 @@ void TrackTwo::update(float dt) {
             mCurrentLapTime += dt;
         }
 
-        if (mInLap && mGameState.map->getTileAtWorldPos(mCar->getPosition()) == 0) {
+        if (mInLap && mGameState.map->getEdgeDistance(mCar->getPosition()) < -TRACK_LIMIT) {
             mLapDisqualified = true;
         }
 
@@ -531,37 +472,34 @@ void TrackTwo::update(float dt) {
             }
         }
 
-        // update AI cars
+        // AI inputs; the cars all move together below
         if (!mRaceFinished) {
             for (size_t i = 0; i < mAICars.size(); i++) {
                 updateAI(mAICars[i], i, dt);
-
-                // Build list of AI cars
-                std::vector<Car*> otherCars;
-                for (size_t j = 0; j < allCars.size(); j++) {
-                    if (allCars[j] != mAICars[i]) {
-                        otherCars.push_back(allCars[j]);
-                    }
-                }
-                mAICars[i]->update(dt, mGameState.map, otherCars);
             }
         }
     }
 
-    // update player car
-    if (mGameMode == 1) {
-        if (!mRaceFinished) {
-            // Build list of AI cars
-            std::vector<Car*> otherCars;
-            for (size_t i = 0; i < mAICars.size(); i++) {
-                otherCars.push_back(mAICars[i]);
-            }
-            mCar->update(dt, mGameState.map, otherCars);
-        }
-    } else {
-        std::vector<Car*> otherCars;
-        mCar->update(dt, mGameState.map, otherCars);
+    // step every car at once: each one's physics, then the contacts
+    // between them. Cars the camera can't see and that are clear of
+    // everyone else step at a lower rate
+    mWorld.setFocus(mGameState.camera.target,
+                    Vector2Length(mGameState.camera.offset) / mGameState.camera.zoom);
+    if (mGameMode == 0 || !mRaceFinished) {
+        mWorld.step(dt, mGameState.map);
     }
+    for (int tier = 0; tier < SIM_TIER_COUNT; tier++)
+        mGameState.tierCounts[tier] = mWorld.getTierCount((SimTier) tier);
+
+    // fingerprint of this tick for replays and determinism checks
+    uint64_t hash = hashTick(mGameState.tick++);
+    hash = mCar->hashState(hash);
+    for (size_t i = 0; i < mAICars.size(); i++)
+        hash = mAICars[i]->hashState(hash);
+    mGameState.stateHash = hash;
+
+    // this tick, for rewinding to
+    saveRace();
 
     UpdateMusicStream(mGameState.bgm2);
 
@@ -584,10 +522,10 @@ void TrackTwo::render() {
         DrawRectangle(-10000, -10000, 20000, 20000, ColorFromHex(mBGColourHexCode));
     }
 
-    mGameState.map->render();
+    mGameState.map->render(mGameState.camera);
 
     // render cars
-    for (Car* aiCar : mAICars) {
+    for (RaceCar* aiCar : mAICars) {
         aiCar->render();
     }
 
@@ -664,12 +602,15 @@ void TrackTwo::renderUI() {
 void TrackTwo::shutdown() {
     delete mCar;
     delete mGameState.map;
+    mTrackFile.close();
 
     // clean up AI cars
-    for (Car* aiCar : mAICars) {
+    for (RaceCar* aiCar : mAICars) {
         delete aiCar;
     }
     mAICars.clear();
+    mWorld.clear();
+    mHistory.clear();
 
     // Stop music (don't unload - it's shared)
     StopMusicStream(mGameState.bgm2);
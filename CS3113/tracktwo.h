@@ -3,42 +3,14 @@
 
 #include "Scene.h"
 #include "TrackCommon.h"
+#include "RaceWorld.h"
+#include "TrackFile.h"
 #include <vector>
 
 class TrackTwo : public Scene {
 private:
-    unsigned int mTrackData[TRACK_WIDTH * TRACK_HEIGHT] = {
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        503,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,500,000,501,000,000,
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        503,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,501,000,000,
-        000,000,114, 96,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186, 78, 60,000,000,000,000,000,000,000,000,000,000,
-        503,000,113, 95,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184, 77, 59,000,000,000,000,000,000,000,501,000,000,
-        000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,000,000,000,000,000,000,
-        503,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,114, 96,186,186,186,186, 76, 58,000,000,000,000,000,000,000,501,000,000,
-        000,000,203,167,000,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,000,000,113, 95,184,184,184,184, 75, 57,000,000,000,000,000,000,000,000,000,000,
-        503,000,203,167,000,000,501,000,000,000,000,000,000,000,000,000,000,000,000,503,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,501,000,000,
-        000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        503,000,203,167,000,000,501,000,000,000,000,000,000,000,000,000,000,000,000,503,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,501,000,000,
-        000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        503,000,203,167,000,000,501,000,000,000,000,000,000,000,000,000,000,000,000,503,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,501,000,000,
-        000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        503,000,203,167,000,000,501,000,000,000,000,000,000,000,000,000,000,000,000,503,000,000,112, 94,275,257,000,000,000,000,000,000,000,000,000,000,000,501,000,000,
-        000,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,111, 93,274,256,275,257,000,000,000,000,000,000,000,000,000,000,000,000,
-        503,000,203,167,000,000,501,000,000,000,000,000,000,000,000,000,000,000,000,503,000,000,000,000,273,255,274,256,186,186,186,186,186,186, 78, 60,000,501,000,000,
-        000,000,203,167,000,000,000,500,000,500,000,500,000,500,000,500,000,500,000,000,000,000,000,000,000,000,273,255,184,184,184,184,184,184, 77, 59,000,000,000,000,
-        503,000,203,167,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,501,000,000,
-        000,000,112, 94,275,257,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,
-        503,000,111, 93,274,256,275,257,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,501,000,000,
-        000,000,000,000,273,255,274,256,275,257,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,203,167,000,000,000,000,
-        503,000,000,000,000,000,273,255,274,256,186,186,186,186,186,307,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186,186, 76, 58,000,501,000,000,
-        000,000,000,000,000,000,000,000,273,255,184,184,184,184,184,271,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184,184, 75, 57,000,000,000,000,
-        503,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,501,000,000,
-        000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,502,000,000,000,000,
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,
-        000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000,000
-    };
+    // layout, tribunes, corners, racing line and grid, mapped from disk
+    TrackFile mTrackFile;
 
     // corner detection system
     std::vector<Corner> corners;
@@ -51,8 +23,15 @@ private:
     void updateAI(Car* aiCar, int aiIndex, float dt);
     Vector2 tileToWorld(int col, int row);
 
-    Car* mCar = nullptr; // player car
-    std::vector<Car*> mAICars; // AI opponent cars
+    RaceCar* mCar = nullptr; // player car
+    std::vector<RaceCar*> mAICars; // AI opponent cars
+    RaceWorld mWorld; // every car on track, stepped together
+
+    // the last few seconds, for rewinding after an off
+    RaceHistory mHistory;
+    RaceState mSnapshot;
+    void saveRace();
+    void rewind(int ticks);
 
     // game mode
     int mGameMode = 0; // 0 = hotlap, 1 = race
@@ -0,0 +1,1383 @@
+/*
+    Headless benchmarks for the sim core. Links only libugp_sim, so it runs
+    without a window or GL context.
+
+    race  Builds an oval the shape of Track One, drops a field of AI cars on
+          it and steps them at the game's fixed timestep as fast as the CPU
+          allows.
+    pool  Times one physics step of a CarPool against the same field of Car
+          objects at 4, 64 and 1024 cars. Fails if any car ends more than
+          POOL_GAP_TOLERANCE from its Car after 600 ticks.
+    broadphase  A grid of Car objects updated with every other car as a
+          contact candidate, against a RaceWorld step, at 64 to 512 cars.
+    update  Per-car cost of Car::update for cars driving laps of the oval,
+          with and without the map.
+    tracks  Times opening each of the game's .ugpt track files and
+          building a Map on its tiles.
+    surfaces  One car accelerating then coasting down a straight of each
+          surface material, with EULER and RK4.
+    math  Worst error and cost of the FastMath approximations against libm.
+    tires  Worst error of the tyre tables against the Pacejka formula, and
+          applyFriction's grip clamp on the axles of cars lapping the oval:
+          the old linear clamp, the curve as it runs now, skipping the
+          lookup when belowCurve() rules it out, and the formula.
+    contacts  Oriented box tests on random car-sized pairs: one pair at a
+          time, through findContacts' lanes, and the lane kernel alone on
+          pre-packed boxes. Checks the scalar and lane results agree.
+    hash  The race without timings, printing the state hash once a simulated
+          second. Diff the output of two builds (e.g. DETERMINISTIC=1 at
+          OPT=-O0 and OPT=-O3) to check they stay in lockstep.
+    integrators  The race with each integrator at 60 and 30 Hz, against
+          the game's EULER step at 60 Hz, then the same for one car alone.
+          Fails if the lone RK2 or RK4 car drifts further than the
+          INTEGRATOR_*_TOLERANCE constants allow.
+    order  The race with RaceWorld's integrate phase run forwards,
+          backwards and over threads, checking all three end identical.
+    lod   A strung-out field with and without a level of detail focus on
+          car 0, at the game's view radius. Reports the time spent in
+          RaceWorld::step, best of three, how many cars ran each tier and
+          how far the best laps moved.
+    props  The race with no props, then with a dozen on the racing line
+          and hundreds asleep round the infield.
+    rewind  The race through placeProps' cones, saving a RaceState every
+          tick into a RaceHistory, rewound a few seconds and run again,
+          checking cars and props end where they did the first time. The
+          default 12 s rewinds over the field ploughing through the props
+          on the back straight. Times the save and the rewind.
+
+    usage: ugp_bench [race] [cars] [simulated seconds] [euler|rk2|rk4] [Hz]
+           ugp_bench hash [cars] [simulated seconds] [euler|rk2|rk4] [Hz]
+           ugp_bench integrators [cars] [simulated seconds]
+           ugp_bench order [cars] [simulated seconds]
+           ugp_bench rewind [cars] [simulated seconds]
+           ugp_bench lod [cars] [simulated seconds]
+           ugp_bench props [cars] [props] [simulated seconds]
+           ugp_bench pool
+           ugp_bench broadphase
+           ugp_bench update
+           ugp_bench surfaces
+           ugp_bench tracks
+           ugp_bench math
+           ugp_bench tires
+           ugp_bench contacts
+*/
+
+#include "car.h"
+#include "car_profiles.h"
+#include "CarPool.h"
+#include "RaceWorld.h"
+#include "PropPool.h"
+#include "FastMath.h"
+#include "TrackCommon.h"
+#include "TrackFile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+constexpr int   MAP_COLUMNS    = 40;
+constexpr int   MAP_ROWS       = 30;
+constexpr float TILE_SIZE      = 450.0f;
+constexpr float FIXED_TIMESTEP = 1.0f / 60.0f;
+
+const Vector2 ORIGIN = { 640.0f, 360.0f };
+
+const CarProfile PROFILES[] = { PORSCHE_911, HONDA_NSX, LAMBORGHINI_GALLARDO, FORD_GT };
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct BenchTrack {
+    unsigned int levelData[MAP_COLUMNS * MAP_ROWS];
+    std::vector<Vector2> waypoints;
+    Vector2 startLineTop;
+    Vector2 startLineBottom;
+};
+
+struct BenchDriver {
+    Car* car;
+    int waypoint;
+    int laps;
+    float lapTime;
+    float bestLap;
+    Vector2 prevPos;
+    float draftTime;    // seconds spent in someone's slipstream
+};
+
+static Vector2 tileToWorld(const Map &map, int col, int row)
+{
+    return {
+        map.getLeftBoundary() + (col + 0.5f) * TILE_SIZE,
+        map.getTopBoundary()  + (row + 0.5f) * TILE_SIZE
+    };
+}
+
+// Two-tile wide oval between rows 8-21 and cols 4-35, tribunes outside it
+static void buildOval(BenchTrack &track)
+{
+    for (int i = 0; i < MAP_COLUMNS * MAP_ROWS; i++) track.levelData[i] = 0;
+
+    for (int row = 8; row <= 21; row++) {
+        for (int col = 4; col <= 35; col++) {
+            bool onStraight = row <= 9 || row >= 20;
+            bool onSide     = col <= 5 || col >= 34;
+            if (onStraight || onSide)
+                track.levelData[row * MAP_COLUMNS + col] = 184;
+        }
+    }
+    track.levelData[20 * MAP_COLUMNS + 16] = START_LINE_TOP_TILE;
+    track.levelData[21 * MAP_COLUMNS + 16] = START_LINE_BOTTOM_TILE;
+
+    for (int col = 3; col <= 35; col += 2) {
+        track.levelData[5  * MAP_COLUMNS + col] = 500;
+        track.levelData[24 * MAP_COLUMNS + col] = 502;
+    }
+}
+
+static void setupWaypoints(BenchTrack &track, const Map &map)
+{
+    const int points[][2] = {
+        {17, 21}, {10, 21}, {6, 21}, {5, 20}, {4, 18}, {4, 14},
+        {4, 10},  {5, 9},   {7, 8},  {17, 8}, {33, 8}, {34, 9},
+        {35, 11}, {35, 14}, {35, 19}, {34, 20}, {32, 21}, {24, 21}
+    };
+    for (const auto &p : points)
+        track.waypoints.push_back(tileToWorld(map, p[0], p[1]));
+}
+
+// Same racing logic as TrackOne::updateAI
+static void driveAI(BenchDriver &driver, const BenchTrack &track, Map *map, float dt)
+{
+    Car *car = driver.car;
+    Vector2 target = track.waypoints[driver.waypoint];
+    Vector2 pos = car->getPosition();
+
+    float dx = target.x - pos.x;
+    float dy = target.y - pos.y;
+
+    if (simSqrt(dx * dx + dy * dy) < TILE_SIZE * 2.0f) {
+        driver.waypoint = (driver.waypoint + 1) % track.waypoints.size();
+        target = track.waypoints[driver.waypoint];
+        dx = target.x - pos.x;
+        dy = target.y - pos.y;
+    }
+
+    float angleDiff = wrapDegrees(simAtan2(dy, dx) * RAD2DEG - car->getAngle());
+
+    float desiredSteer = angleDiff * 0.6f;
+
+    // edge field: turn back towards the track before running off it
+    float sinHeading, cosHeading;
+    simSinCos(car->getAngle() * DEG2RAD, &sinHeading, &cosHeading);
+    Vector2 ahead = { pos.x + cosHeading * AI_EDGE_LOOKAHEAD,
+                      pos.y + sinHeading * AI_EDGE_LOOKAHEAD };
+    float edge = map->getEdgeDistance(ahead);
+    if (edge < AI_EDGE_MARGIN) {
+        Vector2 away = map->getEdgeGradient(ahead);
+        float awayDiff = wrapDegrees(simAtan2(away.y, away.x) * RAD2DEG - car->getAngle());
+        desiredSteer += awayDiff * 0.6f * (AI_EDGE_MARGIN - edge) / AI_EDGE_MARGIN;
+    }
+
+    if (desiredSteer > 20.0f) desiredSteer = 20.0f;
+    if (desiredSteer < -20.0f) desiredSteer = -20.0f;
+    car->setSteerAngle(desiredSteer);
+
+    float gripPerKg = car->getFrontGrip() / car->getWeight();
+    float targetSpeed = std::fmax(1500.0f, 6.0f * gripPerKg);
+    if (std::fabs(angleDiff) > 45.0f)      targetSpeed = std::fmax(1500.0f, 5.0f * gripPerKg);
+    else if (std::fabs(angleDiff) > 20.0f) targetSpeed = std::fmax(1500.0f, 5.5f * gripPerKg);
+
+    if (car->getSpeed() < targetSpeed - 50.0f)      car->accelerate(dt, map);
+    else if (car->getSpeed() > targetSpeed + 50.0f) car->brake(dt);
+}
+
+static void countLap(BenchDriver &driver, const BenchTrack &track, float dt)
+{
+    Vector2 pos = driver.car->getPosition();
+    driver.lapTime += dt;
+    if (driver.car->getDraft() > 0.0f) driver.draftTime += dt;
+
+    if (driver.prevPos.x > track.startLineTop.x && pos.x < track.startLineTop.x &&
+        pos.y >= track.startLineTop.y && pos.y <= track.startLineBottom.y)
+    {
+        if (driver.laps > 0 && (driver.bestLap == 0.0f || driver.lapTime < driver.bestLap))
+            driver.bestLap = driver.lapTime;
+        driver.laps++;
+        driver.lapTime = 0.0f;
+    }
+    driver.prevPos = pos;
+}
+
+static std::unique_ptr<Map> buildBenchMap(BenchTrack &track)
+{
+    buildOval(track);
+
+    std::unique_ptr<Map> map(new Map(MAP_COLUMNS, MAP_ROWS, track.levelData, TILE_SIZE, ORIGIN));
+    for (int id = 500; id <= 503; id++)
+        map->registerMultiTileObject(id, 2, 1, { 0.0f, -32.0f }, 1.0f, (id - 500) * 90.0f);
+
+    setupWaypoints(track, *map);
+    track.startLineTop    = map->findFirst(START_LINE_TOP_TILE);
+    track.startLineBottom = map->findFirst(START_LINE_BOTTOM_TILE);
+    track.startLineTop.y    -= TILE_SIZE * 2.5f;
+    track.startLineBottom.y += TILE_SIZE * 2.5f;
+    return map;
+}
+
+static const char* integratorName(Integrator integrator)
+{
+    switch (integrator) {
+        case RK2: return "rk2";
+        case RK4: return "rk4";
+        default:  return "euler";
+    }
+}
+
+struct RaceResult {
+    std::vector<BenchDriver> drivers;
+    std::vector<Vector2> trace;     // every car, every TRACE_INTERVAL
+    uint64_t hash;
+    long ticks;
+    double wall;
+    double stepWall;                  // of that, in RaceWorld's step
+    long tierTicks[SIM_TIER_COUNT];   // car-ticks spent in each tier
+    long awakeTicks;                  // prop-ticks spent awake
+    int peakAwake;
+    int propsMoved;                   // props no longer where they started
+};
+
+const float TRACE_INTERVAL = 0.1f;
+
+// How the race runs RaceWorld's integrate phase: in one call, car by car
+// from the back, or split over STEP_THREADS threads
+enum StepOrder { STEP_FORWARD, STEP_REVERSED, STEP_THREADED };
+
+const int STEP_THREADS = 4;
+
+static void stepWorld(RaceWorld &world, float dt, Map *map, StepOrder order)
+{
+    if (order == STEP_FORWARD) {
+        world.step(dt, map);
+        return;
+    }
+
+    world.beginStep(dt);
+    int count = world.getCount();
+
+    if (order == STEP_REVERSED) {
+        for (int i = count - 1; i >= 0; i--) world.stepCars(i, i + 1, map);
+    } else {
+        std::thread workers[STEP_THREADS];
+        for (int t = 0; t < STEP_THREADS; t++)
+            workers[t] = std::thread(&RaceWorld::stepCars, &world,
+                                     count * t / STEP_THREADS,
+                                     count * (t + 1) / STEP_THREADS, map);
+        for (std::thread &worker : workers) worker.join();
+    }
+
+    world.resolveContacts(map);
+}
+
+// Where fraction (0..1) of the way round the waypoint loop is, and the
+// waypoint that leg heads for
+static Vector2 pointAroundLap(const BenchTrack &track, float fraction, int *waypoint)
+{
+    size_t count = track.waypoints.size();
+    std::vector<float> legs(count);
+    float lap = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        Vector2 a = track.waypoints[i];
+        Vector2 b = track.waypoints[(i + 1) % count];
+        legs[i] = std::sqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
+        lap += legs[i];
+    }
+
+    float along = fraction * lap;
+    size_t leg = 0;
+    while (leg + 1 < count && along > legs[leg]) along -= legs[leg++];
+
+    Vector2 a = track.waypoints[leg];
+    Vector2 b = track.waypoints[(leg + 1) % count];
+    float t = along / legs[leg];
+    *waypoint = (int) ((leg + 1) % count);
+    return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t };
+}
+
+// propCount cones lining the infield in rows a cone apart, where the field
+// never goes, then a dozen cones, barrels and tyre stacks on the racing
+// line down the back straight for it to plough through
+static void placeProps(PropPool &props, const BenchTrack &track, const Map &map,
+                       int propCount)
+{
+    const float SPACING = 60.0f;
+
+    float inset = 30.0f;
+    for (int placed = 0; placed < propCount; inset += SPACING) {
+        float left   = map.getLeftBoundary() + 6 * TILE_SIZE + inset;
+        float right  = map.getLeftBoundary() + 34 * TILE_SIZE - inset;
+        float top    = map.getTopBoundary() + 10 * TILE_SIZE + inset;
+        float bottom = map.getTopBoundary() + 20 * TILE_SIZE - inset;
+        float width  = right - left;
+        float height = bottom - top;
+        if (width <= 0.0f || height <= 0.0f) break;
+
+        for (float along = 0.0f; along < 2.0f * (width + height) && placed < propCount;
+             along += SPACING, placed++) {
+            float d = along;
+            Vector2 pos;
+            if (d < width)                   pos = { left + d, top };
+            else if ((d -= width) < height)  pos = { right, top + d };
+            else if ((d -= height) < width)  pos = { right - d, bottom };
+            else                             pos = { left, bottom - (d - width) };
+            props.add(PROP_CONE, pos);
+        }
+    }
+
+    const PropKind kinds[] = { PROP_CONE, PROP_BARREL, PROP_TYRES };
+    for (int i = 0; i < 12; i++) {
+        int waypoint;
+        Vector2 pos = pointAroundLap(track, 0.40f + 0.01f * i, &waypoint);
+        pos.y += (i % 3 - 1) * 60.0f;
+        props.add(kinds[i % 3], pos);
+    }
+}
+
+// Runs the AI field for simSeconds at tickRate steps per second. The field
+// starts on the grid, or strung out evenly round the lap as a long race
+// leaves it. A focusRadius puts RaceWorld's focus on car 0, as the game's
+// camera does. propCount > 0 adds trackside props, see placeProps.
+static RaceResult simulateRace(int carCount, float simSeconds, Integrator integrator,
+                               int tickRate, bool traceHashes,
+                               StepOrder order = STEP_FORWARD, bool strungOut = false,
+                               float focusRadius = 0.0f, int propCount = 0)
+{
+    BenchTrack track;
+    std::unique_ptr<Map> map = buildBenchMap(track);
+
+    PropPool props;
+    if (propCount > 0) placeProps(props, track, *map, propCount);
+    std::vector<Vector2> propStarts;
+    for (int i = 0; i < props.size(); i++) propStarts.push_back(props.getPosition(i));
+
+    // grid up behind the line, two abreast
+    std::vector<Car*> cars;
+    RaceResult result;
+    for (int i = 0; i < carCount; i++) {
+        Vector2 pos = {
+            ORIGIN.x - 1200.0f + (i / 2) * 200.0f,
+            ORIGIN.y + 2600.0f + (i % 2) * 200.0f
+        };
+        float angle = 180.0f;
+        int waypoint = 0;
+
+        if (strungOut) {
+            pos = pointAroundLap(track, (float) i / carCount, &waypoint);
+            Vector2 next = track.waypoints[waypoint];
+            angle = simAtan2(next.y - pos.y, next.x - pos.x) * RAD2DEG;
+        }
+
+        Car *car = new Car(pos, {150.0f, 60.0f}, PROFILES[i % 4]);
+        car->setAngle(angle);
+        car->setIntegrator(integrator);
+        cars.push_back(car);
+        result.drivers.push_back({ car, waypoint, 0, 0.0f, 0.0f, pos, 0.0f });
+    }
+
+    float dt = 1.0f / tickRate;
+    long ticks = std::lround(simSeconds * tickRate);
+    long traceEvery = std::lround(TRACE_INTERVAL * tickRate);
+    RaceWorld world;
+    for (Car *car : cars) world.add(car);
+    uint64_t hash = 0;
+    for (long &tierTicks : result.tierTicks) tierTicks = 0;
+    result.awakeTicks = 0;
+    result.peakAwake = 0;
+    if (props.size() > 0) world.setProps(&props);
+
+    result.stepWall = 0.0;
+    Clock::time_point start = Clock::now();
+    for (long tick = 0; tick < ticks; tick++) {
+        for (size_t i = 0; i < cars.size(); i++)
+            driveAI(result.drivers[i], track, map.get(), dt);
+
+        if (focusRadius > 0.0f) world.setFocus(cars[0]->getPosition(), focusRadius);
+        Clock::time_point stepStart = Clock::now();
+        stepWorld(world, dt, map.get(), order);
+        result.stepWall += secondsSince(stepStart);
+        for (int tier = 0; tier < SIM_TIER_COUNT; tier++)
+            result.tierTicks[tier] += world.getTierCount((SimTier) tier);
+        result.awakeTicks += props.getAwakeCount();
+        result.peakAwake = std::max(result.peakAwake, props.getAwakeCount());
+
+        for (size_t i = 0; i < cars.size(); i++)
+            countLap(result.drivers[i], track, dt);
+
+        hash = hashTick(tick);
+        for (Car *car : cars) hash = car->hashState(hash);
+        hash = props.hashState(hash);
+
+        if (traceHashes && (tick + 1) % tickRate == 0)
+            std::printf("tick %6ld  %016llx\n", tick + 1, (unsigned long long) hash);
+
+        if ((tick + 1) % traceEvery == 0)
+            for (Car *car : cars) result.trace.push_back(car->getPosition());
+    }
+    result.wall  = secondsSince(start);
+    result.hash  = hash;
+    result.ticks = ticks;
+
+    result.propsMoved = 0;
+    for (int i = 0; i < props.size(); i++) {
+        Vector2 pos = props.getPosition(i);
+        if (pos.x != propStarts[i].x || pos.y != propStarts[i].y) result.propsMoved++;
+    }
+
+    for (Car *car : cars) delete car;
+    for (BenchDriver &driver : result.drivers) driver.car = nullptr;
+    return result;
+}
+
+static void runRace(int carCount, float simSeconds, Integrator integrator,
+                    int tickRate, bool traceHashes)
+{
+    RaceResult race = simulateRace(carCount, simSeconds, integrator, tickRate, traceHashes);
+
+    if (!traceHashes) {
+        std::printf("cars %d, simulated %.0f s (%ld ticks) in %.3f s wall\n",
+                    carCount, simSeconds, race.ticks, race.wall);
+        std::printf("integrator %s at %d Hz\n", integratorName(integrator), tickRate);
+        std::printf("%.0f ticks/s, %.1fx realtime, %.3f us per car-tick\n",
+                    race.ticks / race.wall, simSeconds / race.wall,
+                    race.wall * 1e6 / ((double) race.ticks * carCount));
+    }
+    std::printf("state hash %016llx\n", (unsigned long long) race.hash);
+
+    for (size_t i = 0; i < race.drivers.size() && i < 8; i++)
+        std::printf("  car %zu: %d laps, best %.3f s, in draft %.0f%%\n",
+                    i, race.drivers[i].laps, race.drivers[i].bestLap,
+                    100.0f * race.drivers[i].draftTime / simSeconds);
+}
+
+// The same race with RaceWorld's integrate phase run forwards, backwards
+// and on worker threads. The tick is order independent, so all three must
+// end on the same state hash.
+static void runOrder(int carCount, float simSeconds)
+{
+    const StepOrder orders[] = { STEP_FORWARD, STEP_REVERSED, STEP_THREADED };
+    const char *names[] = { "forward", "reversed", "threaded" };
+
+    std::printf("%d cars, %.0f s, integrate phase in three orders\n", carCount, simSeconds);
+
+    uint64_t reference = 0;
+    bool same = true;
+    for (int i = 0; i < 3; i++) {
+        RaceResult race = simulateRace(carCount, simSeconds, EULER, 60, false, orders[i]);
+        if (i == 0) reference = race.hash;
+        same = same && race.hash == reference;
+
+        std::printf("  %-9s %016llx  %.3f s wall\n", names[i],
+                    (unsigned long long) race.hash, race.wall);
+    }
+    std::printf("  %s\n", same ? "identical" : "DIFFERENT");
+}
+
+// Saves every tick as the game does, then at the end rewinds and runs the
+// last stretch again. The second run must end on the first run's hash
+static bool runRewind(int carCount, float simSeconds)
+{
+    const int HISTORY_TICKS = 600;
+    const int REWIND_BY     = 300;
+    const int INFIELD_PROPS = 150;     // about track one's
+    const float VIEW_RADIUS = 3672.0f;
+
+    if (carCount > RACE_MAX_CARS) carCount = RACE_MAX_CARS;
+
+    BenchTrack track;
+    std::unique_ptr<Map> map = buildBenchMap(track);
+
+    PropPool props;
+    placeProps(props, track, *map, INFIELD_PROPS);
+
+    std::vector<Car*> cars;
+    std::vector<BenchDriver> drivers;
+    RaceWorld world;
+    world.setProps(&props);
+    for (int i = 0; i < carCount; i++) {
+        Vector2 pos = {
+            ORIGIN.x - 1200.0f + (i / 2) * 200.0f,
+            ORIGIN.y + 2600.0f + (i % 2) * 200.0f
+        };
+        Car *car = new Car(pos, {150.0f, 60.0f}, PROFILES[i % 4]);
+        car->setAngle(180.0f);
+        cars.push_back(car);
+        drivers.push_back({ car, 0, 0, 0.0f, 0.0f, pos, 0.0f });
+        world.add(car);
+    }
+
+    RaceHistory history(HISTORY_TICKS);
+    RaceState state;
+    long ticks = std::lround(simSeconds / FIXED_TIMESTEP);
+    if (ticks < REWIND_BY) ticks = REWIND_BY;
+    double saveSeconds = 0.0;
+
+    // the tick, then its state onto the history, as TrackOne does
+    auto runTick = [&](long tick) {
+        for (BenchDriver &driver : drivers) driveAI(driver, track, map.get(), FIXED_TIMESTEP);
+        world.setFocus(cars[0]->getPosition(), VIEW_RADIUS);
+        world.step(FIXED_TIMESTEP, map.get());
+
+        Clock::time_point start = Clock::now();
+        world.save(&state);
+        state.tick = tick + 1;
+        for (int i = 0; i < carCount; i++) state.track.aiCurrentWaypoint[i] = drivers[i].waypoint;
+        history.push(state);
+        saveSeconds += secondsSince(start);
+
+        uint64_t hash = hashTick(tick);
+        for (Car *car : cars) hash = car->hashState(hash);
+        return props.hashState(hash);
+    };
+
+    uint64_t first = 0;
+    for (long tick = 0; tick < ticks; tick++) first = runTick(tick);
+
+    Clock::time_point start = Clock::now();
+    history.rewind(REWIND_BY, &state);
+    world.restore(state);
+    for (int i = 0; i < carCount; i++) drivers[i].waypoint = state.track.aiCurrentWaypoint[i];
+    double rewindSeconds = secondsSince(start);
+
+    uint64_t second = 0;
+    for (long tick = (long) state.tick; tick < ticks; tick++) second = runTick(tick);
+
+    std::printf("%d cars, %d props, %.0f s, %zu bytes per RaceState, %d ticks of history\n",
+                carCount, props.size(), simSeconds, sizeof(RaceState), history.capacity());
+    std::printf("  save %.1f ns per tick, rewind %d ticks in %.1f ns\n",
+                saveSeconds * 1e9 / (ticks + REWIND_BY), REWIND_BY, rewindSeconds * 1e9);
+    std::printf("  first run  %016llx\n", (unsigned long long) first);
+    std::printf("  rewound    %016llx  %s\n", (unsigned long long) second,
+                first == second ? "identical" : "DIFFERENT");
+
+    for (Car *car : cars) delete car;
+    return first == second;
+}
+
+// Each integrator at 60 and 30 Hz against the game's own step (EULER at
+// 60 Hz): worst position gap over the first lap, best lap gaps over the
+// whole race, and cost per simulated second.
+// How far a lone RK2/RK4 car may drift from the lone 60 Hz EULER car:
+// the lap 1 position gap, and the best lap gap at each rate. At 60 Hz the
+// two models differ by about a tick a lap, at 30 Hz by five. EULER is
+// tuned for 60 Hz and isn't held to anything at 30. A field isn't
+// checked: with traffic, which car gets held up behind which decides the
+// best laps more than the integrator does.
+const float INTEGRATOR_GAP_TOLERANCE    = 100.0f;
+const float INTEGRATOR_LAP_TOLERANCE_60 = 0.05f;
+const float INTEGRATOR_LAP_TOLERANCE_30 = 0.15f;
+
+struct IntegratorGap {
+    float lapOne;       // worst position gap over the first lap
+    float bestLap;      // worst best-lap gap, seconds
+    double wall;
+};
+
+static IntegratorGap integratorGap(const RaceResult &reference, int carCount, float simSeconds,
+                                   Integrator integrator, int rate)
+{
+    const float FIRST_LAP = 15.0f;
+    RaceResult race = simulateRace(carCount, simSeconds, integrator, rate, false);
+
+    IntegratorGap gap = { 0.0f, 0.0f, race.wall };
+    size_t samples = (size_t) (FIRST_LAP / TRACE_INTERVAL) * carCount;
+    for (size_t i = 0; i < samples && i < race.trace.size(); i++) {
+        float dx = race.trace[i].x - reference.trace[i].x;
+        float dy = race.trace[i].y - reference.trace[i].y;
+        gap.lapOne = std::fmax(gap.lapOne, std::sqrt(dx * dx + dy * dy));
+    }
+    for (int i = 0; i < carCount; i++)
+        gap.bestLap = std::fmax(gap.bestLap, std::fabs(race.drivers[i].bestLap -
+                                                       reference.drivers[i].bestLap));
+    return gap;
+}
+
+static bool runIntegrators(int carCount, float simSeconds)
+{
+    const Integrator integrators[] = { EULER, RK2, RK4 };
+    const int rates[] = { 60, 30 };
+    bool ok = true;
+
+    RaceResult reference = simulateRace(carCount, simSeconds, EULER, 60, false);
+
+    std::printf("%d cars, %.0f s, against euler at 60 Hz\n", carCount, simSeconds);
+    std::printf("  integrator  Hz   gap lap 1   worst best-lap gap   wall ms per sim s\n");
+    for (Integrator integrator : integrators) {
+        for (int rate : rates) {
+            IntegratorGap gap = integratorGap(reference, carCount, simSeconds, integrator, rate);
+            std::printf("  %-10s  %2d   %8.1f    %10.3f s        %8.3f\n",
+                        integratorName(integrator), rate, gap.lapOne, gap.bestLap,
+                        gap.wall * 1e3 / simSeconds);
+        }
+    }
+
+    RaceResult lone = simulateRace(1, simSeconds, EULER, 60, false);
+
+    std::printf("One car alone, against euler at 60 Hz\n");
+    std::printf("  integrator  Hz   gap lap 1   best-lap gap   allowed\n");
+    for (Integrator integrator : integrators) {
+        for (int rate : rates) {
+            IntegratorGap gap = integratorGap(lone, 1, simSeconds, integrator, rate);
+            if (integrator == EULER) {
+                std::printf("  %-10s  %2d   %8.1f    %8.3f s          -\n",
+                            integratorName(integrator), rate, gap.lapOne, gap.bestLap);
+                continue;
+            }
+            float allowed = rate >= 60 ? INTEGRATOR_LAP_TOLERANCE_60 : INTEGRATOR_LAP_TOLERANCE_30;
+            bool failed = !(gap.lapOne <= INTEGRATOR_GAP_TOLERANCE && gap.bestLap <= allowed);
+            ok = ok && !failed;
+            std::printf("  %-10s  %2d   %8.1f    %8.3f s   %3.0f, %.2f s%s\n",
+                        integratorName(integrator), rate, gap.lapOne, gap.bestLap,
+                        INTEGRATOR_GAP_TOLERANCE, allowed, failed ? "  FAIL" : "");
+        }
+    }
+    return ok;
+}
+
+// The field with and without a level of detail focus on car 0. The view
+// radius is the game's: a 1280x720 screen at zoom 0.2.
+static void runLod(int carCount, float simSeconds)
+{
+    const float VIEW_RADIUS = 3672.0f;
+    const int reps = 3;
+
+    // best of a few runs; the races themselves come out the same each time
+    RaceResult full, lod;
+    double fullStep = 1e9, lodStep = 1e9;
+    for (int rep = 0; rep < reps; rep++) {
+        full = simulateRace(carCount, simSeconds, EULER, 60, false, STEP_FORWARD, true);
+        lod  = simulateRace(carCount, simSeconds, EULER, 60, false, STEP_FORWARD, true,
+                            VIEW_RADIUS);
+        fullStep = std::fmin(fullStep, full.stepWall);
+        lodStep  = std::fmin(lodStep, lod.stepWall);
+    }
+
+    std::printf("%d cars strung out, %.0f s, focus on car 0 with a %.0f view radius\n",
+                carCount, simSeconds, VIEW_RADIUS);
+    std::printf("  RaceWorld::step, best of %d\n", reps);
+    std::printf("  full field  %.3f s\n", fullStep);
+    std::printf("  with lod    %.3f s, %.2fx\n", lodStep, fullStep / lodStep);
+    std::printf("  cars per tick: %.1f full, %.1f coarse\n",
+                (double) lod.tierTicks[TIER_FULL] / lod.ticks,
+                (double) lod.tierTicks[TIER_COARSE] / lod.ticks);
+
+    float lapGap = 0.0f;
+    int lapsOff = 0;
+    for (int i = 0; i < carCount; i++) {
+        lapGap = std::fmax(lapGap, std::fabs(lod.drivers[i].bestLap - full.drivers[i].bestLap));
+        lapsOff = std::max(lapsOff, std::abs(lod.drivers[i].laps - full.drivers[i].laps));
+    }
+    std::printf("  worst best-lap gap %.3f s, laps differ by at most %d\n", lapGap, lapsOff);
+}
+
+// The race with no props, then with propCount sleeping cones round the
+// infield and a dozen props on the racing line. The cones nobody reaches
+// should cost nothing; the time that's left is the knocked props.
+static void runProps(int carCount, int propCount, float simSeconds)
+{
+    RaceResult bare  = simulateRace(carCount, simSeconds, EULER, 60, false);
+    RaceResult props = simulateRace(carCount, simSeconds, EULER, 60, false,
+                                    STEP_FORWARD, false, 0.0f, propCount);
+
+    std::printf("%d cars, %d props, %.0f s\n", carCount, propCount + 12, simSeconds);
+    std::printf("  no props    %.3f s wall\n", bare.wall);
+    std::printf("  with props  %.3f s wall, %.2f us per tick more\n", props.wall,
+                (props.wall - bare.wall) * 1e6 / props.ticks);
+    std::printf("  awake per tick %.2f, peak %d; %d props knocked out of place\n",
+                (double) props.awakeTicks / props.ticks, props.peakAwake, props.propsMoved);
+}
+
+// AI drives one car round the oval; only the update call is timed.
+// A single car keeps car-to-car contact out of the measurement.
+static double timeUpdate(bool withMap, int ticks)
+{
+    BenchTrack track;
+    std::unique_ptr<Map> map = buildBenchMap(track);
+
+    Vector2 pos = { ORIGIN.x - 1200.0f, ORIGIN.y + 2800.0f };
+    Car car(pos, {150.0f, 60.0f}, PORSCHE_911);
+    car.setAngle(180.0f);
+
+    BenchDriver driver = { &car, 0, 0, 0.0f, 0.0f, pos, 0.0f };
+    std::vector<Car*> noContacts;
+    Map *updateMap = withMap ? map.get() : nullptr;
+
+    double seconds = 0.0;
+    for (int tick = 0; tick < ticks; tick++) {
+        driveAI(driver, track, map.get(), FIXED_TIMESTEP);
+
+        Clock::time_point start = Clock::now();
+        for (int rep = 0; rep < 16; rep++)
+            car.update(FIXED_TIMESTEP / 16.0f, updateMap, noContacts);
+        seconds += secondsSince(start);
+    }
+
+    return seconds * 1e9 / (ticks * 16.0);
+}
+
+static void runUpdate()
+{
+    const int ticks = 60 * 120;
+
+    std::printf("Car::update, %d ticks of one car lapping the oval\n", ticks);
+    std::printf("  physics only:   %.1f ns per car\n", timeUpdate(false, ticks));
+    std::printf("  with map:       %.1f ns per car\n", timeUpdate(true, ticks));
+}
+
+static const char* surfaceName(int surface)
+{
+    static const char *names[SURFACE_COUNT] = { "asphalt", "kerb", "grass", "gravel", "oil" };
+    return names[surface];
+}
+
+// One car from a standstill down the back straight with the whole of it
+// patched to each surface: full throttle for two seconds, then a second
+// coasting. Asphalt is the track as it always was.
+static void runSurfaces()
+{
+    const int throttleTicks = 120;
+    const int coastTicks    = 60;
+    const Integrator integrators[] = { EULER, RK4 };
+
+    std::printf("Full throttle %d ticks then coasting %d, on the back straight\n",
+                throttleTicks, coastTicks);
+    std::printf("  surface   integrator  speed after throttle   after coast   distance\n");
+
+    for (int surface = 0; surface < SURFACE_COUNT; surface++) {
+        for (Integrator integrator : integrators) {
+            BenchTrack track;
+            std::unique_ptr<Map> map = buildBenchMap(track);
+            for (int row = 8; row <= 9; row++)
+                for (int col = 6; col <= 33; col++)
+                    map->setCellSurface(col, row, (SurfaceKind) surface);
+
+            Vector2 start = tileToWorld(*map, 6, 8);
+            Car car(start, {150.0f, 60.0f}, PORSCHE_911);
+            car.setIntegrator(integrator);
+            car.setAngle(0.0f);
+            std::vector<Car*> noContacts;
+
+            for (int tick = 0; tick < throttleTicks; tick++) {
+                car.accelerate(FIXED_TIMESTEP, map.get());
+                car.update(FIXED_TIMESTEP, map.get(), noContacts);
+            }
+            float throttleSpeed = car.getSpeed();
+
+            for (int tick = 0; tick < coastTicks; tick++)
+                car.update(FIXED_TIMESTEP, map.get(), noContacts);
+
+            std::printf("  %-8s  %-10s  %10.1f           %8.1f    %8.1f\n",
+                        surfaceName(surface), integratorName(integrator), throttleSpeed,
+                        car.getSpeed(), car.getPosition().x - start.x);
+        }
+    }
+}
+
+// Each of the game's track files: open() (map it and check the header and
+// section table) and a Map built on its tiles in place
+static void runTracks()
+{
+    const char *names[] = { "trackone", "tracktwo", "trackthree" };
+    const int reps = 1000;
+
+    std::printf("Track files, best of %d\n", reps);
+    std::printf("  track        bytes   open us   Map us\n");
+
+    for (const char *name : names) {
+        char path[128];
+        std::snprintf(path, sizeof(path), "assets/track/data/%s.ugpt", name);
+
+        double open = 1e9, build = 1e9;
+        for (int rep = 0; rep < reps; rep++) {
+            TrackFile file;
+            Clock::time_point start = Clock::now();
+            if (!file.open(path)) {
+                std::printf("  %s: can't open %s (run from the repo root, after make tracks)\n", name, path);
+                return;
+            }
+            open = std::fmin(open, secondsSince(start));
+
+            start = Clock::now();
+            Map map(file.getColumns(), file.getRows(), file.getTiles(), TILE_SIZE, ORIGIN);
+            build = std::fmin(build, secondsSince(start));
+        }
+
+        FILE *f = std::fopen(path, "rb");
+        std::fseek(f, 0, SEEK_END);
+        long bytes = std::ftell(f);
+        std::fclose(f);
+
+        std::printf("  %-10s  %6ld   %7.1f   %6.1f\n", name, bytes, open * 1e6, build * 1e6);
+    }
+}
+
+static void runMath()
+{
+    const int count = 1 << 20;
+    std::vector<float> angles(count), xs(count), ys(count), out(count), out2(count);
+    for (int i = 0; i < count; i++) {
+        angles[i] = -40.0f + 80.0f * i / count;
+        xs[i] = std::cos(i * 0.37f) * (1.0f + i % 1000);
+        ys[i] = std::sin(i * 0.53f) * (1.0f + i % 777);
+    }
+
+    double sinErr = 0, atanErr = 0, rsqrtErr = 0, lanesErr = 0;
+    for (int i = 0; i < count; i++) {
+        float s, c;
+        fastSinCos(angles[i], &s, &c);
+        sinErr = std::fmax(sinErr, std::fmax(std::fabs(s - std::sin((double) angles[i])),
+                                             std::fabs(c - std::cos((double) angles[i]))));
+        atanErr = std::fmax(atanErr, std::fabs(fastAtan2(ys[i], xs[i]) - std::atan2((double) ys[i], (double) xs[i])));
+
+        double x = std::fabs(xs[i]) + 1e-3;
+        rsqrtErr = std::fmax(rsqrtErr, std::fabs(fastRsqrt((float) x) * std::sqrt(x) - 1.0));
+    }
+    for (int i = 0; i < count; i += UGP_SIMD_WIDTH) {
+        FloatLanes s, c;
+        lanesSinCos(lanesLoad(&angles[i]), &s, &c);
+        lanesStore(&out[i], s);
+        lanesStore(&out2[i], lanesAtan2(lanesLoad(&ys[i]), lanesLoad(&xs[i])));
+    }
+    for (int i = 0; i < count; i++) {
+        lanesErr = std::fmax(lanesErr, std::fabs(out[i] - std::sin((double) angles[i])));
+        lanesErr = std::fmax(lanesErr, std::fabs(out2[i] - std::atan2((double) ys[i], (double) xs[i])));
+    }
+
+    std::printf("FastMath worst error over %d samples\n", count);
+    std::printf("  sincos %.2e, atan2 %.2e, rsqrt %.2e (relative), lanes %.2e\n",
+                sinErr, atanErr, rsqrtErr, lanesErr);
+
+    // cost per call; the sums keep the loops from being optimised away
+    float sink = 0.0f;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < count; i++) sink += std::sin(angles[i]) + std::cos(angles[i]);
+    double libmSin = secondsSince(start);
+
+    start = Clock::now();
+    for (int i = 0; i < count; i++) { float s, c; fastSinCos(angles[i], &s, &c); sink += s + c; }
+    double fastSin = secondsSince(start);
+
+    start = Clock::now();
+    for (int i = 0; i < count; i += UGP_SIMD_WIDTH) {
+        FloatLanes s, c;
+        lanesSinCos(lanesLoad(&angles[i]), &s, &c);
+        lanesStore(&out[i], s + c);
+    }
+    double lanesSin = secondsSince(start);
+
+    start = Clock::now();
+    for (int i = 0; i < count; i++) sink += std::atan2(ys[i], xs[i]);
+    double libmAtan = secondsSince(start);
+
+    start = Clock::now();
+    for (int i = 0; i < count; i++) sink += fastAtan2(ys[i], xs[i]);
+    double fastAtan = secondsSince(start);
+
+    start = Clock::now();
+    for (int i = 0; i < count; i += UGP_SIMD_WIDTH)
+        lanesStore(&out2[i], lanesAtan2(lanesLoad(&ys[i]), lanesLoad(&xs[i])));
+    double lanesAtan = secondsSince(start);
+
+    std::printf("  ns per call      libm    scalar   %d lanes\n", UGP_SIMD_WIDTH);
+    std::printf("  sincos     %9.2f %9.2f %9.2f\n", libmSin * 1e9 / count,
+                fastSin * 1e9 / count, lanesSin * 1e9 / count);
+    std::printf("  atan2      %9.2f %9.2f %9.2f\n", libmAtan * 1e9 / count,
+                fastAtan * 1e9 / count, lanesAtan * 1e9 / count);
+    std::printf("  (checksum %g)\n", sink + out[count / 2] + out2[count / 3]);
+}
+
+// One car's inputs to the grip clamp, as applyFriction has them
+struct AxleSample {
+    float slipVel;          // signed lateral slip
+    float grip;             // effective grip, before the grip window
+    float load, staticLoad;
+};
+
+struct FrictionSample {
+    const TireTable *tires;
+    float speed, mass, invMass;
+    AxleSample front, rear;
+};
+
+// Four cars lapping the oval for two minutes, every tick, worked out from
+// the state each car ends the tick in
+static void collectFriction(std::vector<FrictionSample> *samples)
+{
+    BenchTrack track;
+    std::unique_ptr<Map> map = buildBenchMap(track);
+    std::vector<Car*> noContacts;
+
+    std::vector<Car*> cars;
+    std::vector<BenchDriver> drivers;
+    for (int i = 0; i < 4; i++) {
+        Vector2 pos = { ORIGIN.x - 1200.0f + i * 300.0f, ORIGIN.y + 2800.0f };
+        cars.push_back(new Car(pos, {150.0f, 60.0f}, PROFILES[i]));
+        cars.back()->setAngle(180.0f);
+        drivers.push_back({ cars.back(), 0, 0, 0.0f, 0.0f, pos, 0.0f });
+    }
+
+    for (int tick = 0; tick < 60 * 120; tick++) {
+        for (int i = 0; i < 4; i++) {
+            Car *car = cars[i];
+            driveAI(drivers[i], track, map.get(), FIXED_TIMESTEP);
+            car->update(FIXED_TIMESTEP, map.get(), noContacts);
+
+            Vector2 vel = car->getVelocity();
+            float speed = car->getSpeed();
+            if (speed < 0.1f) continue;
+
+            DerivedProfile d = deriveProfile(PROFILES[i]);
+            float heading = car->getAngle() * DEG2RAD;
+            float wheel = heading + car->getSteerAngle() * DEG2RAD;
+            float speedSq = speed * speed;
+
+            FrictionSample f;
+            f.tires = TireTable::forProfile(PROFILES[i]);
+            f.speed = speed;
+            f.mass = PROFILES[i].mass;
+            f.invMass = d.invMass;
+            f.front.slipVel = -vel.x * std::sin(wheel) + vel.y * std::cos(wheel);
+            f.rear.slipVel  = -vel.x * std::sin(heading) + vel.y * std::cos(heading);
+            f.front.load = d.staticLoadFront + d.frontAero * speedSq;
+            f.rear.load  = d.staticLoadRear + d.rearAero * speedSq;
+            f.front.staticLoad = d.staticLoadFront;
+            f.rear.staticLoad  = d.staticLoadRear;
+            f.front.grip = d.tireMu * f.front.load;
+            f.rear.grip  = d.tireMu * f.rear.load;
+            samples->push_back(f);
+        }
+    }
+    for (Car *car : cars) delete car;
+}
+
+static void runTires()
+{
+    // worst table error on a grid 16x finer than the table
+    std::printf("Tyre table worst error against pacejkaLateral\n");
+    for (const CarProfile &profile : PROFILES) {
+        TireTable table;
+        table.build(profile);
+        double worst = 0.0;
+        for (int j = 0; j <= TIRE_LOAD_BINS * 16; j++) {
+            float u = (float) j / (TIRE_LOAD_BINS * 16);
+            for (int i = 0; i <= TIRE_SLIP_BINS * 16; i++) {
+                float s = (float) i / (TIRE_SLIP_BINS * 16);
+                double err = std::fabs(table.lookup(s, u) -
+                                       pacejkaLateral(profile, std::asin(s), u));
+                worst = std::fmax(worst, err);
+            }
+        }
+        std::printf("  mass %6.0f: %.2e\n", profile.mass, worst);
+    }
+
+    // every car of a lapping field, as applyFriction sees it
+    std::vector<FrictionSample> samples;
+    collectFriction(&samples);
+    int count = (int) samples.size();
+    std::vector<float> out(2 * count);
+
+    // best of several passes, each loop a fraction of a millisecond
+    const float stiffness = 0.15f;
+    const float dt = FIXED_TIMESTEP;
+    const int reps = 50;
+    double clampSeconds = 1e9, curveSeconds = 1e9, formulaSeconds = 1e9;
+    double sink = 0.0;
+    int lookups = 0;
+    for (int rep = 0; rep < reps; rep++) {
+        // the clamp applyFriction had before the curve
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < count; i++) {
+            const FrictionSample &f = samples[i];
+            float frontForce = -f.front.slipVel * stiffness;
+            float rearForce = -f.rear.slipVel * stiffness;
+            float frontMaxGrip = (f.front.grip / f.mass) * dt * 5.0f;
+            float rearMaxGrip = (f.rear.grip / f.mass) * dt * 5.0f;
+            if (std::abs(frontForce) > frontMaxGrip)
+                frontForce = std::copysign(frontMaxGrip, frontForce);
+            if (std::abs(rearForce) > rearMaxGrip)
+                rearForce = std::copysign(rearMaxGrip, rearForce);
+            out[2 * i] = frontForce;
+            out[2 * i + 1] = rearForce;
+        }
+        clampSeconds = std::fmin(clampSeconds, secondsSince(start));
+        sink += out[count];
+
+        // applyFriction now: the curve only where the bound can't rule it out
+        lookups = 0;
+        start = Clock::now();
+        for (int i = 0; i < count; i++) {
+            const FrictionSample &f = samples[i];
+            const TireTable *tires = f.tires;
+            float frontForce = -f.front.slipVel * stiffness;
+            float rearForce = -f.rear.slipVel * stiffness;
+            float gripWindow = f.invMass * dt * 5.0f;
+            float stiffSpeed = f.speed * stiffness;
+            float frontMaxGrip = f.front.grip * gripWindow;
+            if (!tires->belowCurve(std::fabs(frontForce), frontMaxGrip, stiffSpeed)) {
+                frontMaxGrip *= tires->lookup(std::fabs(f.front.slipVel) / f.speed,
+                                              f.front.load / (f.front.load + f.front.staticLoad));
+                if (std::abs(frontForce) > frontMaxGrip)
+                    frontForce = std::copysign(frontMaxGrip, frontForce);
+                lookups++;
+            }
+            float rearMaxGrip = f.rear.grip * gripWindow;
+            if (!tires->belowCurve(std::fabs(rearForce), rearMaxGrip, stiffSpeed)) {
+                rearMaxGrip *= tires->lookup(std::fabs(f.rear.slipVel) / f.speed,
+                                             f.rear.load / (f.rear.load + f.rear.staticLoad));
+                if (std::abs(rearForce) > rearMaxGrip)
+                    rearForce = std::copysign(rearMaxGrip, rearForce);
+                lookups++;
+            }
+            out[2 * i] = frontForce;
+            out[2 * i + 1] = rearForce;
+        }
+        curveSeconds = std::fmin(curveSeconds, secondsSince(start));
+        sink += out[count];
+
+        // the formula the table stands in for
+        start = Clock::now();
+        for (int i = 0; i < count; i++) {
+            const FrictionSample &f = samples[i];
+            float gripWindow = f.invMass * dt * 5.0f;
+            for (int axle = 0; axle < 2; axle++) {
+                const AxleSample &a = axle ? f.rear : f.front;
+                float force = -a.slipVel * stiffness;
+                float maxGrip = a.grip * gripWindow *
+                                pacejkaLateral(PROFILES[0], std::asin(std::fabs(a.slipVel) / f.speed),
+                                               a.load / (a.load + a.staticLoad));
+                if (std::abs(force) > maxGrip)
+                    force = std::copysign(maxGrip, force);
+                out[2 * i + axle] = force;
+            }
+        }
+        formulaSeconds = std::fmin(formulaSeconds, secondsSince(start));
+        sink += out[count];
+    }
+
+    std::printf("  %d car ticks from a lapping field, %.1f%% of axles near the limit\n",
+                count, 50.0 * lookups / count);
+    std::printf("  ns per car tick, best of %d\n", reps);
+    std::printf("                   clamp     curve   formula\n");
+    std::printf("             %10.2f %9.2f %9.2f\n", clampSeconds * 1e9 / count,
+                curveSeconds * 1e9 / count, formulaSeconds * 1e9 / count);
+    std::printf("  (checksum %g)\n", sink);
+}
+
+static void runContacts()
+{
+    const int count = 4096;
+    const int repeats = 256;
+    std::vector<OrientedBox> a(count), b(count);
+    std::vector<Contact> scalar(count), batched(count);
+
+    // car-sized boxes at any heading, near enough that about half touch
+    for (int i = 0; i < count; i++) {
+        float ha = i * 0.618f, hb = i * 0.377f;
+        a[i] = { { 0.0f, 0.0f }, { std::cos(ha), std::sin(ha) }, { 60.0f, 30.0f } };
+        b[i] = { { 150.0f * std::sin(i * 0.011f), 90.0f * std::cos(i * 0.017f) },
+                 { std::cos(hb), std::sin(hb) }, { 55.0f, 28.0f } };
+    }
+
+    Clock::time_point start = Clock::now();
+    int scalarHits = 0;
+    for (int r = 0; r < repeats; r++) {
+        scalarHits = 0;
+        for (int i = 0; i < count; i++) {
+            scalar[i].depth = 0.0f;
+            scalarHits += boxesOverlap(a[i], b[i], &scalar[i]);
+        }
+    }
+    double scalarSeconds = secondsSince(start);
+
+    start = Clock::now();
+    int batchedHits = 0;
+    for (int r = 0; r < repeats; r++)
+        batchedHits = findContacts(a.data(), b.data(), count, batched.data());
+    double batchedSeconds = secondsSince(start);
+
+    // the kernel alone, on boxes already laid out one field per array as
+    // CarPool keeps its cars
+    std::vector<float> soa(12 * count);
+    for (int i = 0; i < count; i++) {
+        const OrientedBox *boxes[2] = { &a[i], &b[i] };
+        for (int j = 0; j < 2; j++) {
+            const float *f = &boxes[j]->centre.x;
+            for (int field = 0; field < 6; field++)
+                soa[(j * 6 + field) * count + i] = f[field];
+        }
+    }
+
+    FloatLanes sink = lanesSet(0.0f);
+    start = Clock::now();
+    for (int r = 0; r < repeats; r++) {
+        for (int i = 0; i < count; i += UGP_SIMD_WIDTH) {
+            const float *f = &soa[i];
+            BoxLanes la = { lanesLoad(f),             lanesLoad(f + count),
+                            lanesLoad(f + 2 * count), lanesLoad(f + 3 * count),
+                            lanesLoad(f + 4 * count), lanesLoad(f + 5 * count) };
+            BoxLanes lb = { lanesLoad(f + 6 * count), lanesLoad(f + 7 * count),
+                            lanesLoad(f + 8 * count), lanesLoad(f + 9 * count),
+                            lanesLoad(f + 10 * count), lanesLoad(f + 11 * count) };
+            FloatLanes nx, ny, depth;
+            lanesBoxesOverlap(la, lb, &nx, &ny, &depth);
+            sink = sink + nx + ny + depth;
+        }
+    }
+    double packedSeconds = secondsSince(start);
+    float sinkOut[UGP_SIMD_WIDTH];
+    lanesStore(sinkOut, sink);
+
+    int mismatches = 0;
+    float worstDepth = 0.0f;
+    for (int i = 0; i < count; i++) {
+        if ((scalar[i].depth > 0.0f) != (batched[i].depth > 0.0f)) { mismatches++; continue; }
+        if (scalar[i].depth <= 0.0f) continue;
+        worstDepth = std::fmax(worstDepth, std::fabs(scalar[i].depth - batched[i].depth));
+        if (scalar[i].normal.x != batched[i].normal.x ||
+            scalar[i].normal.y != batched[i].normal.y) mismatches++;
+    }
+
+    std::printf("Oriented box contacts, %d pairs, %d touching\n", count, scalarHits);
+    double pairs = (double) count * repeats;
+    std::printf("  ns per pair      scalar   %d lanes   packed\n", UGP_SIMD_WIDTH);
+    std::printf("             %10.2f %9.2f %9.2f\n", scalarSeconds * 1e9 / pairs,
+                batchedSeconds * 1e9 / pairs, packedSeconds * 1e9 / pairs);
+    std::printf("  lanes vs scalar: %d hits, %d mismatches, worst depth gap %.2e\n",
+                batchedHits, mismatches, worstDepth);
+    std::printf("  (checksum %g)\n", sinkOut[0]);
+}
+
+// Open field, no map: throttle on and a slow weave so every car is turning
+// and sliding. Returns the worst position gap between the two models.
+static float runPool(int carCount, int ticks, double *carSeconds, double *poolSeconds)
+{
+    std::vector<Car*> cars;
+    std::vector<Car*> noContacts;
+    CarPool pool;
+    pool.reserve(carCount);
+
+    for (int i = 0; i < carCount; i++) {
+        Vector2 pos = { (i % 32) * 400.0f, (i / 32) * 400.0f };
+        float angle = (i * 37) % 360;
+        cars.push_back(new Car(pos, {150.0f, 60.0f}, PROFILES[i % 4]));
+        cars.back()->setAngle(angle);
+        pool.add(pos, angle, PROFILES[i % 4]);
+    }
+
+    *carSeconds = 0.0;
+    *poolSeconds = 0.0;
+
+    for (int tick = 0; tick < ticks; tick++) {
+        for (int i = 0; i < carCount; i++) {
+            float steer = 15.0f * std::sin(tick * 0.02f + i);
+            cars[i]->setSteerAngle(steer);
+            pool.setSteerAngle(i, steer);
+            if ((tick + i) % 120 < 90) {
+                cars[i]->accelerate(FIXED_TIMESTEP, nullptr);
+                pool.accelerate(i, FIXED_TIMESTEP);
+            }
+        }
+
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < carCount; i++)
+            cars[i]->update(FIXED_TIMESTEP, nullptr, noContacts);
+        *carSeconds += secondsSince(start);
+
+        start = Clock::now();
+        pool.step(FIXED_TIMESTEP);
+        *poolSeconds += secondsSince(start);
+    }
+
+    float worstGap = 0.0f;
+    for (int i = 0; i < carCount; i++) {
+        Vector2 a = cars[i]->getPosition();
+        Vector2 b = pool.getPosition(i);
+        worstGap = std::fmax(worstGap, std::hypot(a.x - b.x, a.y - b.y));
+        delete cars[i];
+    }
+    return worstGap;
+}
+
+// Pool and Car do the same sums in a different order, so their rounding
+// drifts apart: a few float ulps of a position ~10000 units out per tick
+const float POOL_GAP_TOLERANCE = 0.05f;
+
+static bool runPoolSizes()
+{
+    const int sizes[] = { 4, 64, 1024 };
+    const int ticks = 600;
+    bool ok = true;
+
+    std::printf("CarPool step, %d lanes, %d ticks per size\n", UGP_SIMD_WIDTH, ticks);
+    std::printf("%6s %14s %14s %8s %10s\n", "cars", "Car us/step", "pool us/step", "speedup", "max gap");
+
+    for (int cars : sizes) {
+        double carSeconds, poolSeconds;
+        float gap = runPool(cars, ticks, &carSeconds, &poolSeconds);
+
+        std::printf("%6d %14.3f %14.3f %7.2fx %10.4f%s\n", cars,
+                    carSeconds * 1e6 / ticks, poolSeconds * 1e6 / ticks,
+                    carSeconds / poolSeconds, gap, gap > POOL_GAP_TOLERANCE ? "  FAIL" : "");
+        ok = ok && gap <= POOL_GAP_TOLERANCE;
+    }
+    std::printf("max gap allowed %.2f\n", POOL_GAP_TOLERANCE);
+    return ok;
+}
+
+// Cars on a 32-wide grid, close enough that neighbours touch now and then.
+// Each car is updated against all the others, or the field goes through a
+// RaceWorld step; gives seconds per tick for each.
+static void runBroadphase(int carCount, int ticks, double *allSeconds, double *gridSeconds,
+                          double *pairsPerTick)
+{
+    std::vector<Car*> allCars, gridCars;
+    std::vector<std::vector<Car*>> others(carCount);
+    RaceWorld world;
+
+    for (int i = 0; i < carCount; i++) {
+        Vector2 pos = { (i % 32) * 220.0f, (i / 32) * 220.0f };
+        float angle = (i * 37) % 360;
+        allCars.push_back(new Car(pos, {150.0f, 60.0f}, PROFILES[i % 4]));
+        gridCars.push_back(new Car(pos, {150.0f, 60.0f}, PROFILES[i % 4]));
+        allCars.back()->setAngle(angle);
+        gridCars.back()->setAngle(angle);
+        world.add(gridCars.back());
+    }
+
+    // the all-pairs lists are built once, so only the tests are timed
+    for (int i = 0; i < carCount; i++)
+        for (int j = 0; j < carCount; j++)
+            if (j != i) others[i].push_back(allCars[j]);
+
+    *allSeconds = 0.0;
+    *gridSeconds = 0.0;
+    long pairs = 0;
+
+    for (int tick = 0; tick < ticks; tick++) {
+        for (int i = 0; i < carCount; i++) {
+            float steer = 15.0f * std::sin(tick * 0.02f + i);
+            allCars[i]->setSteerAngle(steer);
+            gridCars[i]->setSteerAngle(steer);
+            if ((tick + i) % 120 < 30) {
+                allCars[i]->accelerate(FIXED_TIMESTEP, nullptr);
+                gridCars[i]->accelerate(FIXED_TIMESTEP, nullptr);
+            }
+        }
+
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < carCount; i++)
+            allCars[i]->update(FIXED_TIMESTEP, nullptr, others[i]);
+        *allSeconds += secondsSince(start);
+
+        start = Clock::now();
+        world.step(FIXED_TIMESTEP, nullptr);
+        *gridSeconds += secondsSince(start);
+
+        pairs += world.getBroadphase().getPairs().size();
+    }
+
+    *allSeconds /= ticks;
+    *gridSeconds /= ticks;
+    *pairsPerTick = (double) pairs / ticks;
+
+    for (int i = 0; i < carCount; i++) {
+        delete allCars[i];
+        delete gridCars[i];
+    }
+}
+
+static void runBroadphaseSizes()
+{
+    const int sizes[] = { 64, 128, 256, 512 };
+    const int ticks = 300;
+
+    std::printf("Car::update for a grid of cars, %d ticks per size\n", ticks);
+    std::printf("%6s %14s %14s %8s %12s\n", "cars", "all us/tick", "grid us/tick",
+                "speedup", "pairs/tick");
+
+    for (int cars : sizes) {
+        double allSeconds, gridSeconds, pairs;
+        runBroadphase(cars, ticks, &allSeconds, &gridSeconds, &pairs);
+
+        std::printf("%6d %14.1f %14.1f %7.2fx %12.1f\n", cars, allSeconds * 1e6,
+                    gridSeconds * 1e6, allSeconds / gridSeconds, pairs);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *mode = "race";
+    if (argc > 1 && (argv[1][0] < '0' || argv[1][0] > '9')) {
+        mode = argv[1];
+        argv++;
+        argc--;
+    }
+
+    // modes that check something return false when it fails
+    bool ok = true;
+    if (std::strcmp(mode, "pool") == 0) {
+        ok = runPoolSizes();
+    } else if (std::strcmp(mode, "broadphase") == 0) {
+        runBroadphaseSizes();
+    } else if (std::strcmp(mode, "update") == 0) {
+        runUpdate();
+    } else if (std::strcmp(mode, "tracks") == 0) {
+        runTracks();
+    } else if (std::strcmp(mode, "surfaces") == 0) {
+        runSurfaces();
+    } else if (std::strcmp(mode, "math") == 0) {
+        runMath();
+    } else if (std::strcmp(mode, "tires") == 0) {
+        runTires();
+    } else if (std::strcmp(mode, "contacts") == 0) {
+        runContacts();
+    } else if (std::strcmp(mode, "integrators") == 0) {
+        int carCount     = argc > 1 ? std::atoi(argv[1]) : 4;
+        float simSeconds = argc > 2 ? (float) std::atof(argv[2]) : 300.0f;
+        ok = runIntegrators(carCount, simSeconds);
+    } else if (std::strcmp(mode, "props") == 0) {
+        int carCount     = argc > 1 ? std::atoi(argv[1]) : 8;
+        int propCount    = argc > 2 ? std::atoi(argv[2]) : 500;
+        float simSeconds = argc > 3 ? (float) std::atof(argv[3]) : 120.0f;
+        runProps(carCount, propCount, simSeconds);
+    } else if (std::strcmp(mode, "lod") == 0) {
+        int carCount     = argc > 1 ? std::atoi(argv[1]) : 32;
+        float simSeconds = argc > 2 ? (float) std::atof(argv[2]) : 120.0f;
+        runLod(carCount, simSeconds);
+    } else if (std::strcmp(mode, "rewind") == 0) {
+        int carCount     = argc > 1 ? std::atoi(argv[1]) : 4;
+        float simSeconds = argc > 2 ? (float) std::atof(argv[2]) : 12.0f;
+        ok = runRewind(carCount, simSeconds);
+    } else if (std::strcmp(mode, "order") == 0) {
+        int carCount     = argc > 1 ? std::atoi(argv[1]) : 8;
+        float simSeconds = argc > 2 ? (float) std::atof(argv[2]) : 120.0f;
+        runOrder(carCount, simSeconds);
+    } else if (std::strcmp(mode, "race") == 0 || std::strcmp(mode, "hash") == 0) {
+        int carCount     = argc > 1 ? std::atoi(argv[1]) : 4;
+        float simSeconds = argc > 2 ? (float) std::atof(argv[2]) : 300.0f;
+        Integrator integrator = EULER;
+        if (argc > 3 && std::strcmp(argv[3], "rk2") == 0) integrator = RK2;
+        if (argc > 3 && std::strcmp(argv[3], "rk4") == 0) integrator = RK4;
+        int tickRate = argc > 4 ? std::atoi(argv[4]) : 60;
+        runRace(carCount, simSeconds, integrator, tickRate, std::strcmp(mode, "hash") == 0);
+    } else {
+        std::printf("unknown mode '%s'\n", mode);
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
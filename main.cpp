@@ -10,12 +10,12 @@ constexpr int SCREEN_HEIGHT = 720;
 constexpr int FPS           = 120;
 
 constexpr Vector2 ORIGIN = { SCREEN_WIDTH / 2.0f, SCREEN_HEIGHT / 2.0f };
-constexpr float FIXED_TIMESTEP = 1.0f / 60.0f;
+constexpr int   TICK_RATE      = 60;
+constexpr float FIXED_TIMESTEP = 1.0f / TICK_RATE;
 
 // Global Variables
 AppStatus gAppStatus   = RUNNING;
-float gPreviousTicks = 0.0f;
-float gTimeAccumulator   = 0.0f;
+long long gTicksRun = 0; // fixed steps simulated since start
 
 Scene* gCurrentScene = nullptr;
 std::vector<Scene*> gScenes = {};
@@ -130,29 +130,20 @@ void switchToScene(Scene* scene)
 
 void update()
 {
-    // Delta time
-    float ticks = (float) GetTime();
-    float deltaTime = ticks - gPreviousTicks;
-    gPreviousTicks  = ticks;
+    // Fixed timestep, counted in whole ticks. Working out how many ticks
+    // the clock owes from the double GetTime() keeps the step count exact,
+    // where a float accumulator drifts and can run an extra or missing tick.
+    long long ticksDue = (long long) (GetTime() * TICK_RATE);
 
-    // Fixed timestep
-    deltaTime += gTimeAccumulator;
+    if (gTicksRun >= ticksDue) return;
 
-    if (deltaTime < FIXED_TIMESTEP)
-    {
-        gTimeAccumulator = deltaTime;
-        return;
-    }
-
-    while (deltaTime >= FIXED_TIMESTEP)
+    while (gTicksRun < ticksDue)
     {
         processInput(FIXED_TIMESTEP);
         gCurrentScene->update(FIXED_TIMESTEP);
-        deltaTime -= FIXED_TIMESTEP;
+        gTicksRun++;
     }
 
-    gTimeAccumulator = deltaTime;
-
     // Check for scene transitions
     int nextSceneID = gCurrentScene->getState().nextSceneID;
     if (nextSceneID >= 0 && nextSceneID != gCurrentSceneID)
@@ -0,0 +1,48 @@
+#!/bin/sh
+# Races the default ugp_bench field with the exact and the FAST_MATH=1
+# build and fails if any car's best lap differs by more than one tick
+# (1/60 s), the tolerance CS3113/FastMath.h documents. The flag stamp in
+# the makefile makes each build recompile everything it needs.
+#
+# usage: sh tools/check_fast_math.sh [cars] [simulated seconds]
+
+set -e
+
+MAKE=${MAKE:-make}
+ARGS="race ${1:-4} ${2:-300}"
+EXACT=$(mktemp)
+FAST=$(mktemp)
+trap 'rm -f "$EXACT" "$FAST"' EXIT
+
+$MAKE -s ugp_bench FAST_MATH=0
+./ugp_bench $ARGS > "$EXACT"
+$MAKE -s ugp_bench FAST_MATH=1
+./ugp_bench $ARGS > "$FAST"
+$MAKE -s ugp_bench FAST_MATH=0
+
+# "  car 0: 19 laps, best 15.983 s, ..." -> car and best lap. Best laps are
+# printed to the millisecond, so allow for that rounding on top of the tick
+awk '
+    FNR == 1    { file++ }
+    $1 == "car" { car = $2; sub(":", "", car)
+                  for (i = 3; i < NF; i++) if ($i == "best") best[file, car] = $(i + 1)
+                  cars[car] = 1 }
+    END {
+        tolerance = 1 / 60 + 0.001
+        failed = 0
+        for (car in cars) {
+            if (!((1, car) in best) || !((2, car) in best)) {
+                printf "car %s: no best lap in both runs\n", car
+                failed = 1
+                continue
+            }
+            d = best[2, car] - best[1, car]
+            if (d < 0) d = -d
+            verdict = ""
+            if (d > tolerance) { verdict = "  FAIL"; failed = 1 }
+            printf "car %s: exact %.3f s, fast %.3f s, diff %.3f s%s\n",
+                   car, best[1, car], best[2, car], d, verdict
+        }
+        if (length(cars) == 0) { print "no laps to compare"; failed = 1 }
+        exit failed
+    }' "$EXACT" "$FAST"
@@ -0,0 +1,245 @@
+/*
+    Builds a .ugpt track file (see CS3113/TrackFile.h) from a tile layout
+    and a short description of everything else on the track.
+
+    The layout is either a CSV of tile IDs, one map row per line, or a
+    Tiled map (.tmx) saved with CSV layer data, whose layers become the
+    file's layers in order. Tiled's IDs are taken relative to the first
+    tileset, so tile n of the atlas is n as it is in the CSV, and the
+    flip bits are dropped.
+
+    The description is one entry per line, # for comments:
+
+        object   <tile ID> <texture> <width> <height> [<x> <y> [<scale> [<rotation>]]]
+        corner   <angle> <col>,<row> [<col>,<row> ...]
+        waypoint <col> <row>
+        spawn    <x> <y> <angle>
+
+    Objects are as Map::registerMultiTileObject takes them. Corners are
+    checked in the order they come, waypoints are the AI's racing line in
+    lap order, and spawns are the grid from the map's centre, the
+    player's first.
+
+    usage: ugp_track <layout.csv|layout.tmx> <description.track> <out.ugpt>
+*/
+
+#include "TrackFile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static bool readFile(const char *path, std::string *text)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    *text = buffer.str();
+    return true;
+}
+
+// Every number in text, in order, as the rows of a columns-wide grid.
+// columns is taken from the first non-empty line if it's 0
+static bool readCsv(const std::string &text, int *columns, int *rows,
+                    std::vector<uint32_t> *tiles)
+{
+    std::istringstream lines(text);
+    std::string line;
+    size_t start = tiles->size();
+    int count = 0;
+
+    while (std::getline(lines, line)) {
+        int inLine = 0;
+        const char *p = line.c_str();
+        while (*p) {
+            if ((*p >= '0' && *p <= '9') || *p == '-') {
+                char *end;
+                long long value = std::strtoll(p, &end, 10);
+                tiles->push_back((uint32_t) value);
+                inLine++;
+                p = end;
+            } else {
+                p++;
+            }
+        }
+        if (inLine > 0 && *columns == 0) *columns = inLine;
+        count += inLine;
+    }
+
+    if (*columns == 0 || count % *columns != 0) return false;
+    int layerRows = count / *columns;
+    if (*rows != 0 && layerRows != *rows) return false;
+    *rows = layerRows;
+    return tiles->size() - start == (size_t) *columns * *rows;
+}
+
+static int readAttribute(const std::string &tag, const char *name)
+{
+    std::string key = std::string(" ") + name + "=\"";
+    size_t at = tag.find(key);
+    if (at == std::string::npos) return 0;
+    return std::atoi(tag.c_str() + at + key.size());
+}
+
+// Enough of Tiled's format for its CSV layers: the map size, the first
+// tileset's firstgid, and each <data encoding="csv"> in turn
+static bool readTmx(const std::string &text, int *columns, int *rows,
+                    std::vector<uint32_t> *tiles)
+{
+    size_t mapTag = text.find("<map ");
+    if (mapTag == std::string::npos) return false;
+    std::string map = text.substr(mapTag, text.find('>', mapTag) - mapTag);
+    *columns = readAttribute(map, "width");
+    *rows    = readAttribute(map, "height");
+
+    int firstGid = 1;
+    size_t tilesetTag = text.find("<tileset ");
+    if (tilesetTag != std::string::npos)
+        firstGid = readAttribute(text.substr(tilesetTag, text.find('>', tilesetTag) - tilesetTag), "firstgid");
+
+    size_t at = 0;
+    while ((at = text.find("<data", at)) != std::string::npos) {
+        size_t close = text.find('>', at);
+        std::string tag = text.substr(at, close - at);
+        if (tag.find("encoding=\"csv\"") == std::string::npos) {
+            std::fprintf(stderr, "only CSV layer data is supported\n");
+            return false;
+        }
+        size_t end = text.find("</data>", close);
+        if (end == std::string::npos) return false;
+
+        size_t first = tiles->size();
+        if (!readCsv(text.substr(close + 1, end - close - 1), columns, rows, tiles)) return false;
+
+        for (size_t i = first; i < tiles->size(); i++) {
+            uint32_t gid = (*tiles)[i] & 0x1FFFFFFF;        // drop the flip bits
+            (*tiles)[i] = gid == 0 ? 0 : gid - firstGid + 1;
+        }
+        at = end;
+    }
+    return !tiles->empty();
+}
+
+static bool readDescription(const std::string &text, TrackDescription *track)
+{
+    std::istringstream lines(text);
+    std::string line;
+    int number = 0;
+
+    while (std::getline(lines, line)) {
+        number++;
+        size_t hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+
+        std::istringstream in(line);
+        std::string kind;
+        if (!(in >> kind)) continue;
+
+        bool ok = true;
+        if (kind == "object") {
+            TrackFileObject obj = {};
+            std::string texture;
+            obj.scale = 1.0f;
+            ok = (bool) (in >> obj.tileID >> texture >> obj.widthTiles >> obj.heightTiles);
+
+            // a failed read zeroes its target, so the optional ones go
+            // through a spare
+            float value;
+            if (in >> value) {
+                obj.offsetX = value;
+                ok = ok && (bool) (in >> obj.offsetY);
+            }
+            if (in >> value) {
+                obj.scale = value;
+                if (in >> value) obj.rotation = value;
+            }
+            ok = ok && texture.size() < sizeof(obj.texture);
+            std::strncpy(obj.texture, texture.c_str(), sizeof(obj.texture) - 1);
+            if (ok) track->objects.push_back(obj);
+        } else if (kind == "corner") {
+            TrackFileCorner corner = {};
+            corner.firstTile = (uint32_t) track->cornerTiles.size();
+            ok = (bool) (in >> corner.angle);
+
+            std::string cell;
+            while (ok && in >> cell) {
+                TrackFileCell tile;
+                ok = std::sscanf(cell.c_str(), "%d,%d", &tile.col, &tile.row) == 2;
+                track->cornerTiles.push_back(tile);
+                corner.tileCount++;
+            }
+            if (ok) track->corners.push_back(corner);
+        } else if (kind == "waypoint") {
+            TrackFileCell cell;
+            ok = (bool) (in >> cell.col >> cell.row);
+            if (ok) track->racingLine.push_back(cell);
+        } else if (kind == "spawn") {
+            TrackFileSpawn spawn = {};
+            ok = (bool) (in >> spawn.x >> spawn.y >> spawn.angle);
+            if (ok) track->grid.push_back(spawn);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::fprintf(stderr, "line %d: can't read '%s'\n", number, line.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool endsWith(const char *text, const char *suffix)
+{
+    size_t n = std::strlen(text), m = std::strlen(suffix);
+    return n >= m && std::strcmp(text + n - m, suffix) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 4) {
+        std::printf("usage: ugp_track <layout.csv|layout.tmx> <description.track> <out.ugpt>\n");
+        return 1;
+    }
+
+    TrackDescription track;
+    std::string layout, description;
+
+    if (!readFile(argv[1], &layout)) {
+        std::fprintf(stderr, "can't read %s\n", argv[1]);
+        return 1;
+    }
+    bool tmx = endsWith(argv[1], ".tmx");
+    if (!(tmx ? readTmx(layout, &track.columns, &track.rows, &track.tiles)
+              : readCsv(layout, &track.columns, &track.rows, &track.tiles))) {
+        std::fprintf(stderr, "%s: not a rectangular tile layout\n", argv[1]);
+        return 1;
+    }
+
+    if (!readFile(argv[2], &description)) {
+        std::fprintf(stderr, "can't read %s\n", argv[2]);
+        return 1;
+    }
+    if (!readDescription(description, &track)) return 1;
+
+    if (!writeTrackFile(argv[3], track)) {
+        std::fprintf(stderr, "can't write %s\n", argv[3]);
+        return 1;
+    }
+
+    // read it back as the game will
+    TrackFile check;
+    if (!check.open(argv[3])) {
+        std::fprintf(stderr, "%s doesn't read back\n", argv[3]);
+        return 1;
+    }
+    std::printf("%s: %dx%d, %d layer(s), %d objects, %d corners, %d waypoints, %d spawns\n",
+                argv[3], track.columns, track.rows, check.getLayerCount(),
+                (int) track.objects.size(), (int) track.corners.size(),
+                (int) track.racingLine.size(), (int) track.grid.size());
+    return 0;
+}